@@ -16,6 +16,7 @@ Page {
                         horizontalAlignment: HorizontalAlignment.Center
                         verticalAlignment: VerticalAlignment.Center
                         adUnitId:"agltb3B1Yi1pbmNyDAsSBFNpdGUYsckMDA"
+                        interstitial: true
                     }
                     Button {
                         id: sheetbutton
@@ -83,7 +84,7 @@ Page {
                 editable: false
                 textStyle.color: Color.White
                 backgroundVisible: false
-                text: bannerAdId.adHtml
+                text: bannerAdId.inspector ? bannerAdId.inspector.preview : ""
                 textStyle.fontSizeValue: 5.0
             }
         }
@@ -0,0 +1,119 @@
+#include "MoPubAdEnvelope.hpp"
+
+#include <string.h>
+
+const char* const MoPubAdEnvelope::CONTENT_TYPE = "application/x-mopub-envelope";
+
+namespace {
+    const char MAGIC[] = { 'M', 'P', 'E' };
+    const quint8 VERSION = 1;
+
+    // Index + 1 is the tag, never reorder, only append.
+    const char* const TAGGED_HEADERS[] = {
+        "X-Adtype", "X-Networktype", "X-Launchpage", "X-Clickthrough", "X-Failurl",
+        "X-Imptracker", "X-Scrollable", "X-Width", "X-Height", "X-Refreshtime",
+        "X-Orientation", "X-Interceptlinks", "X-Customselector", "X-Nativeparams", "X-Fulladtype"
+    };
+    const int TAGGED_HEADER_COUNT = sizeof(TAGGED_HEADERS) / sizeof(TAGGED_HEADERS[0]);
+
+    quint8 tagFor(const QByteArray& name) {
+        for (int i = 0; i < TAGGED_HEADER_COUNT; ++i) {
+            if (qstricmp(name.constData(), TAGGED_HEADERS[i]) == 0) return quint8(i + 1);
+        }
+        return 0;
+    }
+
+    void appendUInt(QByteArray* out, quint32 value, int bytes) {
+        for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) out->append(char((value >> shift) & 0xff));
+    }
+
+    class Reader {
+    public:
+        explicit Reader(const QByteArray& data) : mData(data), mPos(0), mOk(true) {}
+        bool ok() const { return mOk; }
+        bool atEnd() const { return mPos == mData.size(); }
+
+        quint32 readUInt(int bytes) {
+            if (!ensure(bytes)) return 0;
+            quint32 value = 0;
+            for (int i = 0; i < bytes; ++i) value = (value << 8) | quint8(mData.at(mPos++));
+            return value;
+        }
+        QByteArray readView(int length) {
+            if (!ensure(length)) return QByteArray();
+            QByteArray view = QByteArray::fromRawData(mData.constData() + mPos, length);
+            mPos += length;
+            return view;
+        }
+
+    private:
+        bool ensure(int length) {
+            if (mOk && length >= 0 && mData.size() - mPos >= length) return true;
+            mOk = false;
+            return false;
+        }
+        const QByteArray& mData;
+        int mPos;
+        bool mOk;
+    };
+}
+
+bool MoPubAdEnvelope::isEnvelope(const QList<QNetworkReply::RawHeaderPair>& httpHeaders){
+    for (int i = 0; i < httpHeaders.size(); ++i) {
+        if (qstricmp(httpHeaders.at(i).first.constData(), "Content-Type") == 0) {
+            return httpHeaders.at(i).second.trimmed().toLower().startsWith(CONTENT_TYPE);
+        }
+    }
+    return false;
+}
+
+QByteArray MoPubAdEnvelope::encode(const QList<QNetworkReply::RawHeaderPair>& headers, const QByteArray& body){
+    QList<QNetworkReply::RawHeaderPair> fields;
+    for (int i = 0; i < headers.size(); ++i) {
+        const QByteArray& name = headers.at(i).first;
+        if (name.size() > 2 && qstrnicmp(name.constData(), "X-", 2) == 0 && headers.at(i).second.size() <= 0xffff) {
+            fields.append(headers.at(i));
+        }
+    }
+    QByteArray out;
+    out.reserve(body.size() + 256);
+    out.append(MAGIC, sizeof(MAGIC));
+    appendUInt(&out, VERSION, 1);
+    appendUInt(&out, qMin(fields.size(), 0xff), 1);
+    for (int i = 0; i < fields.size() && i < 0xff; ++i) {
+        const quint8 tag = tagFor(fields.at(i).first);
+        appendUInt(&out, tag, 1);
+        if (tag == 0) {
+            const QByteArray name = fields.at(i).first.left(0xff);
+            appendUInt(&out, name.size(), 1);
+            out.append(name);
+        }
+        appendUInt(&out, fields.at(i).second.size(), 2);
+        out.append(fields.at(i).second);
+    }
+    appendUInt(&out, body.size(), 4);
+    out.append(body);
+    return out;
+}
+
+bool MoPubAdEnvelope::decode(const QByteArray& data){
+    mData = data;
+    headers.clear();
+    body.clear();
+
+    Reader in(mData);
+    const QByteArray magic = in.readView(sizeof(MAGIC));
+    if (!in.ok() || memcmp(magic.constData(), MAGIC, sizeof(MAGIC)) != 0 || in.readUInt(1) != VERSION) return false;
+    const int count = in.readUInt(1);
+    for (int i = 0; i < count && in.ok(); ++i) {
+        const quint8 tag = in.readUInt(1);
+        QByteArray name;
+        if (tag == 0) name = in.readView(in.readUInt(1));
+        else if (tag <= TAGGED_HEADER_COUNT) name = QByteArray::fromRawData(TAGGED_HEADERS[tag - 1], qstrlen(TAGGED_HEADERS[tag - 1]));
+        else return false;
+        const QByteArray value = in.readView(in.readUInt(2));
+        headers.append(qMakePair(name, value));
+    }
+    body = in.readView(in.readUInt(4));
+    return in.ok() && in.atEnd();
+}
@@ -0,0 +1,38 @@
+#ifndef MOPUBADENVELOPE_HPP_
+#define MOPUBADENVELOPE_HPP_
+
+#include <QByteArray>
+#include <QList>
+#include <QNetworkReply>
+
+/*!
+ * @brief Compact binary ad response: the X- metadata and the creative in one length-prefixed buffer.
+ *
+ * Asked for with an Accept header and recognized by its Content-Type, a server that doesn't
+ * know it answers with the usual X- headers and html body. The layout, big endian:
+ *
+ *   "MPE" version:u8  count:u8  count * field  length:u32 body
+ *   field: tag:u8 [nameLength:u8 name when tag is 0]  length:u16 value
+ *
+ * Tags stand for the X- headers the SDK reads, any other header travels with tag 0 and
+ * its name. decode() does not copy, its headers and body point into the decoded buffer.
+ */
+class MoPubAdEnvelope {
+public:
+    static const char* const CONTENT_TYPE;
+
+    static bool isEnvelope(const QList<QNetworkReply::RawHeaderPair>& httpHeaders);
+    // Only the X- headers go in, the HTTP ones stay HTTP headers.
+    static QByteArray encode(const QList<QNetworkReply::RawHeaderPair>& headers, const QByteArray& body);
+
+    bool decode(const QByteArray& data);
+
+    // Views into the decoded data, valid as long as this envelope.
+    QList<QNetworkReply::RawHeaderPair> headers;
+    QByteArray body;
+
+private:
+    QByteArray mData;
+};
+
+#endif /* MOPUBADENVELOPE_HPP_ */
@@ -0,0 +1,176 @@
+#include "MoPubAdFetcher.hpp"
+
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QTimer>
+
+#include "MoPubAdEnvelope.hpp"
+#include "MoPubDataUsage.hpp"
+#include "MoPubInFlightRequests.hpp"
+#include "MoPubLogging.hpp"
+#include "MoPubNetworkThread.hpp"
+#include "MoPubReplyOwnership.hpp"
+#include "MoPubTrace.hpp"
+
+MoPubAdFetcher::MoPubAdFetcher()
+: QObject(0)
+, mFetchTimeoutMilliseconds(FETCH_TIMEOUT_MILLISECONDS)
+{
+    moveToThread(MoPubNetworkThread::instance());
+}
+
+const int MoPubAdFetcher::MAXIMUM_REDIRECT_HOPS = 5;
+const int MoPubAdFetcher::FETCH_TIMEOUT_MILLISECONDS = 15000;
+
+namespace {
+    const char* REQUEST_ID_PROPERTY = "mopubRequestId";
+    const char* CLICK_URL_PROPERTY = "mopubClickUrl";
+    const char* HOPS_PROPERTY = "mopubHops";
+    const char* TIMED_OUT_PROPERTY = "mopubTimedOut";
+}
+
+QNetworkReply* MoPubAdFetcher::get(const QUrl& url, const QByteArray& userAgent, QNetworkRequest::Priority priority,
+        const QList<QNetworkReply::RawHeaderPair>& headers){
+    QNetworkRequest request = QNetworkRequest();
+    request.setUrl(url);
+    request.setRawHeader("User-Agent", userAgent);
+    for (int i = 0; i < headers.size(); ++i) request.setRawHeader(headers.at(i).first, headers.at(i).second);
+    request.setPriority(priority);
+    return MoPubReplyOwnership::adopt(MoPubNetworkThread::instance()->networkAccessManager()->get(request), this);
+}
+
+void MoPubAdFetcher::fetch(int requestId, const QUrl& url, const QByteArray& userAgent, int priority, bool saveData){
+    if (MoPubInFlightRequests::instance()->join(MoPubInFlightRequests::AdFetch, url, this, requestId)) return;
+    QList<QNetworkReply::RawHeaderPair> headers;
+    // Servers that know the envelope send metadata and creative in one buffer, the others ignore it.
+    headers.append(qMakePair(QByteArray("Accept"), QByteArray(MoPubAdEnvelope::CONTENT_TYPE) + ", */*;q=0.8"));
+    // The Save-Data client hint, servers that know it answer with lighter content.
+    if (saveData) headers.append(qMakePair(QByteArray("Save-Data"), QByteArray("on")));
+    QNetworkReply* reply = get(url, userAgent, static_cast<QNetworkRequest::Priority>(priority), headers);
+    reply->setProperty(REQUEST_ID_PROPERTY, requestId);
+    MoPubInFlightRequests::instance()->add(MoPubInFlightRequests::AdFetch, url, reply);
+    // error() is always followed by finished(), which reports either outcome exactly once.
+    bool res = connect(reply, SIGNAL(finished()), this, SLOT(onFetchReply()));
+    Q_ASSERT(res);
+    // Until the reply arrives the placement keeps its fetch slot, a stalled one must not hold it forever.
+    QTimer* deadline = new QTimer(reply);
+    deadline->setSingleShot(true);
+    res = connect(deadline, SIGNAL(timeout()), this, SLOT(onFetchDeadline()));
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+    deadline->start(mFetchTimeoutMilliseconds);
+}
+
+void MoPubAdFetcher::onFetchDeadline(){
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender()->parent());
+    Q_CHECK_PTR(reply);
+    if (reply->isFinished()) return;
+    MPLogWarn("No reply for %1 after %2 ms, aborted", reply->url(), mFetchTimeoutMilliseconds);
+    reply->setProperty(TIMED_OUT_PROPERTY, true);
+    // Reports through onFetchReply() like any other network failure.
+    reply->abort();
+}
+
+void MoPubAdFetcher::onFetchReply(){
+    MoPubScopedReply reply(qobject_cast<QNetworkReply*>(sender()));
+    Q_CHECK_PTR(reply);
+    const QList<MoPubInFlightRequests::Waiter> waiters = MoPubInFlightRequests::instance()->take(reply.data());
+    MoPubDataUsage::instance()->recordReply(mAdUnitId, MoPubDataUsage::AdFetch, reply.data());
+    // HTTP errors still carry a response worth parsing, only a missing one is a network failure.
+    if (QNetworkReply::NoError != reply->error() && reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).isNull()) {
+        const int code = reply->property(TIMED_OUT_PROPERTY).toBool() ? QNetworkReply::TimeoutError : reply->error();
+        emit fetchFailed(reply->property(REQUEST_ID_PROPERTY).toInt(), code);
+        foreach (const MoPubInFlightRequests::Waiter& waiter, waiters) {
+            if (!waiter.fetcher.isNull()) emit waiter.fetcher->fetchFailed(waiter.requestId, code);
+        }
+        return;
+    }
+    // Parsed once, every fetch that joined it gets a copy under its own id.
+    const qint64 traceStart = MoPubTrace::isEnabled() ? MoPubTrace::instance()->now() : -1;
+    MoPubAdResponse response = MoPubAdResponse::fromReply(reply.data());
+    response.requestId = reply->property(REQUEST_ID_PROPERTY).toInt();
+    if (traceStart >= 0) MoPubTrace::instance()->complete("parse", traceStart, mAdUnitId);
+    emit adResponse(response);
+    foreach (const MoPubInFlightRequests::Waiter& waiter, waiters) {
+        if (waiter.fetcher.isNull()) continue;
+        response.requestId = waiter.requestId;
+        emit waiter.fetcher->adResponse(response);
+    }
+    MPLogTrace("Live replies: %1 of %2 issued", MoPubReplyOwnership::liveCount(), MoPubReplyOwnership::totalCount());
+}
+
+void MoPubAdFetcher::onSharedFetchAbandoned(int requestId){
+    emit fetchFailed(requestId, QNetworkReply::OperationCanceledError);
+}
+
+void MoPubAdFetcher::track(const QUrl& url, const QByteArray& userAgent){
+    // The same beacon already on its way would be counted twice.
+    if (MoPubInFlightRequests::instance()->join(MoPubInFlightRequests::Tracking, url)) return;
+    QNetworkReply* reply = get(url, userAgent);
+    MoPubInFlightRequests::instance()->add(MoPubInFlightRequests::Tracking, url, reply);
+    bool res = connect(reply, SIGNAL(finished()), this, SLOT(onTrackReply()));
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+}
+
+void MoPubAdFetcher::onTrackReply(){
+    MoPubScopedReply reply(qobject_cast<QNetworkReply*>(sender()));
+    Q_CHECK_PTR(reply);
+    MoPubInFlightRequests::instance()->take(reply.data());
+    MoPubDataUsage::instance()->recordReply(mAdUnitId, MoPubDataUsage::Tracking, reply.data());
+    if ( QNetworkReply::NoError != reply->error()){
+        MPLogWarn("Tracking request %1 error: %2", reply->url(), reply->errorString());
+    }
+}
+
+void MoPubAdFetcher::resolve(const QUrl& clickUrl, const QUrl& startUrl, const QByteArray& userAgent){
+    head(clickUrl, startUrl, userAgent, 0);
+}
+
+void MoPubAdFetcher::loadStoredAd(const QString& adUnitId){
+    emit storedAdLoaded(adUnitId, MoPubAdStore::instance()->latest(adUnitId));
+}
+
+void MoPubAdFetcher::storeAd(const QString& adUnitId, const MoPubStoredAd& ad){
+    MoPubAdStore::instance()->save(adUnitId, ad);
+}
+
+void MoPubAdFetcher::head(const QUrl& clickUrl, const QUrl& url, const QByteArray& userAgent, int hops){
+    QNetworkRequest request = QNetworkRequest();
+    request.setUrl(url);
+    request.setRawHeader("User-Agent", userAgent);
+    request.setPriority(QNetworkRequest::LowPriority);
+    QNetworkReply* reply = MoPubReplyOwnership::adopt(
+            MoPubNetworkThread::instance()->networkAccessManager()->head(request), this);
+    reply->setProperty(CLICK_URL_PROPERTY, clickUrl);
+    reply->setProperty(HOPS_PROPERTY, hops);
+    bool res = connect(reply, SIGNAL(finished()), this, SLOT(onResolveReply()));
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+}
+
+void MoPubAdFetcher::onResolveReply(){
+    MoPubScopedReply reply(qobject_cast<QNetworkReply*>(sender()));
+    Q_CHECK_PTR(reply);
+    MoPubDataUsage::instance()->recordReply(mAdUnitId, MoPubDataUsage::ClickResolve, reply.data());
+
+    const QUrl clickUrl = reply->property(CLICK_URL_PROPERTY).toUrl();
+    const int hops = reply->property(HOPS_PROPERTY).toInt();
+    QUrl target = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+    if (!target.isValid()) {
+        // No further hop, this is where the browser would land.
+        if (reply->error() == QNetworkReply::NoError || reply->error() == QNetworkReply::ContentOperationNotPermittedError) {
+            emit clickResolved(clickUrl, reply->url(), hops);
+        }
+        return;
+    }
+
+    target = reply->url().resolved(target);
+    const QString scheme = target.scheme().toLower();
+    if ((scheme == "http" || scheme == "https") && hops + 1 < MAXIMUM_REDIRECT_HOPS) {
+        head(clickUrl, target, reply->request().rawHeader("User-Agent"), hops + 1);
+    } else {
+        // Store links and the like end the chain, the browser hands them over itself.
+        emit clickResolved(clickUrl, target, hops + 1);
+    }
+}
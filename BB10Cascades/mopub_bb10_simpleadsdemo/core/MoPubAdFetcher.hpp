@@ -0,0 +1,71 @@
+#ifndef MOPUBADFETCHER_HPP_
+#define MOPUBADFETCHER_HPP_
+
+#include <QByteArray>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QObject>
+#include <QUrl>
+
+#include "MoPubAdResponse.hpp"
+#include "MoPubAdStore.hpp"
+
+/*!
+ * @brief Issues the requests of one MoPubView on the MoPub network thread.
+ *
+ * Construct it on the UI thread, it moves itself to MoPubNetworkThread. Its slots
+ * are to be invoked through queued calls and its signals reach the view queued,
+ * carrying fully parsed responses. Delete it with deleteLater(), pending replies
+ * are children of the fetcher and get aborted with it. A fetch that gets no reply
+ * within fetchTimeoutMilliseconds is aborted and fails with TimeoutError, QNetworkAccessManager
+ * has no deadline of its own.
+ */
+class MoPubAdFetcher: public QObject {
+    Q_OBJECT
+public:
+    static const int FETCH_TIMEOUT_MILLISECONDS;
+
+    MoPubAdFetcher();
+
+public Q_SLOTS:
+    void setFetchTimeoutMilliseconds(int value) { mFetchTimeoutMilliseconds = value; }
+    // Whose traffic the data usage counters book the requests under.
+    void setAdUnitId(const QString& adUnitId) { mAdUnitId = adUnitId; }
+    // With saveData the server is asked for a lightweight creative.
+    void fetch(int requestId, const QUrl& url, const QByteArray& userAgent, int priority, bool saveData);
+    // Fire and forget beacons: clicks, impressions and conversions.
+    void track(const QUrl& url, const QByteArray& userAgent);
+    // Follows the redirect chain starting at startUrl with HEAD requests, without opening anything.
+    void resolve(const QUrl& clickUrl, const QUrl& startUrl, const QByteArray& userAgent);
+    // MoPubAdStore access, kept off the UI thread. The load answers with storedAdLoaded().
+    void loadStoredAd(const QString& adUnitId);
+    void storeAd(const QString& adUnitId, const MoPubStoredAd& ad);
+
+Q_SIGNALS:
+    void adResponse(const MoPubAdResponse& response);
+    void fetchFailed(int requestId, int code);
+    void clickResolved(const QUrl& clickUrl, const QUrl& landingUrl, int hops);
+    // Invalid when the ad unit has nothing stored.
+    void storedAdLoaded(const QString& adUnitId, const MoPubStoredAd& ad);
+
+private Q_SLOTS:
+    void onFetchReply();
+    void onFetchDeadline();
+    // The reply this fetch joined was aborted along with the fetcher that owned it.
+    void onSharedFetchAbandoned(int requestId);
+    void onTrackReply();
+    void onResolveReply();
+
+private:
+    static const int MAXIMUM_REDIRECT_HOPS;
+
+    void head(const QUrl& clickUrl, const QUrl& url, const QByteArray& userAgent, int hops);
+    QNetworkReply* get(const QUrl& url, const QByteArray& userAgent,
+            QNetworkRequest::Priority priority = QNetworkRequest::NormalPriority,
+            const QList<QNetworkReply::RawHeaderPair>& headers = QList<QNetworkReply::RawHeaderPair>());
+
+    QString mAdUnitId;
+    int mFetchTimeoutMilliseconds;
+};
+
+#endif /* MOPUBADFETCHER_HPP_ */
@@ -0,0 +1,55 @@
+#include "MoPubAdInspector.hpp"
+
+#ifndef QT_NO_DEBUG
+
+#include <QCryptographicHash>
+
+const int MoPubAdInspector::PREVIEW_LENGTH = 512;
+
+MoPubAdInspector::MoPubAdInspector(QObject* parent)
+: QObject(parent)
+, mByteSize(-1)
+{
+}
+
+void MoPubAdInspector::setHtml(const QString& html){
+    mHtml = html;
+    mPreview = QString();
+    mHash = QString();
+    mByteSize = -1;
+    emit changed();
+}
+
+QString MoPubAdInspector::preview() const {
+    if (mPreview.isNull() && !mHtml.isEmpty()) {
+        mPreview = mHtml.size() > PREVIEW_LENGTH ? mHtml.left(PREVIEW_LENGTH) + QLatin1String("...") : mHtml;
+    }
+    return mPreview;
+}
+
+int MoPubAdInspector::byteSize() const {
+    // Count the UTF-8 length in place instead of encoding the whole creative.
+    if (mByteSize < 0) {
+        int size = 0;
+        const QChar* data = mHtml.constData();
+        const int length = mHtml.size();
+        for (int i = 0; i < length; ++i) {
+            ushort unicode = data[i].unicode();
+            if (unicode < 0x80) size += 1;
+            else if (unicode < 0x800) size += 2;
+            else if (data[i].isHighSurrogate() && i + 1 < length && data[i + 1].isLowSurrogate()) { size += 4; ++i; }
+            else size += 3;
+        }
+        mByteSize = size;
+    }
+    return mByteSize;
+}
+
+QString MoPubAdInspector::hash() const {
+    if (mHash.isNull() && !mHtml.isEmpty()) {
+        mHash = QCryptographicHash::hash(mHtml.toUtf8(), QCryptographicHash::Sha1).toHex();
+    }
+    return mHash;
+}
+
+#endif /* QT_NO_DEBUG */
@@ -0,0 +1,47 @@
+#ifndef MOPUBADINSPECTOR_HPP_
+#define MOPUBADINSPECTOR_HPP_
+
+#ifndef QT_NO_DEBUG
+
+#include <QObject>
+#include <QString>
+
+/*!
+ * @brief Debug-only view of the creative shown by a MoPubView.
+ *
+ * Holds an implicitly shared reference to the html handed to the WebView and derives the
+ * preview, byte size and hash lazily, so QML bindings never copy the whole creative.
+ * The full body is only handed out when fullHtml() is called.
+ */
+class MoPubAdInspector: public QObject {
+    Q_OBJECT
+    Q_PROPERTY(QString preview READ preview NOTIFY changed)
+    Q_PROPERTY(int byteSize READ byteSize NOTIFY changed)
+    Q_PROPERTY(QString hash READ hash NOTIFY changed)
+
+public:
+    static const int PREVIEW_LENGTH;
+
+    explicit MoPubAdInspector(QObject* parent = 0);
+
+    void setHtml(const QString& html);
+
+    QString preview() const;
+    int byteSize() const;
+    QString hash() const;
+
+    Q_INVOKABLE QString fullHtml() const { return mHtml; }
+
+Q_SIGNALS:
+    void changed();
+
+private:
+    QString mHtml;
+    mutable QString mPreview;
+    mutable QString mHash;
+    mutable int mByteSize;
+};
+
+#endif /* QT_NO_DEBUG */
+
+#endif /* MOPUBADINSPECTOR_HPP_ */
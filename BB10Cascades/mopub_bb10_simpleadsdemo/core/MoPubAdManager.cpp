@@ -0,0 +1,851 @@
+#include "MoPubAdManager.hpp"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QNetworkConfiguration>
+#include <QNetworkConfigurationManager>
+#include <QTimer>
+#include <QUuid>
+
+#include <stdlib.h>
+
+#include "MoPubAdFetcher.hpp"
+#include "MoPubAdPlacementManager.hpp"
+#include "MoPubCircuitBreaker.hpp"
+#include "MoPubConversionTracker.hpp"
+#include "MoPubDataUsage.hpp"
+#include "MoPubEarlyStart.hpp"
+#include "MoPubJsonReader.hpp"
+#include "MoPubLogging.hpp"
+#include "MoPubNetworkThread.hpp"
+#include "MoPubStallWatchdog.hpp"
+#include "MoPubTrace.hpp"
+
+const QString MoPubAdManager::SDK_VERSION = QString("1.9.0.8");
+const QString MoPubAdManager::API_VERSION = QString("8");
+#ifdef TESTING
+const QString MoPubAdManager::MOPUB_URL = QString("http://testing.ads.mopub.com");
+#else
+const QString MoPubAdManager::MOPUB_URL = QString("http://ads.mopub.com");
+#endif
+const QString MoPubAdManager::AD_HANDLER = QString("/m/ad");
+const QString MoPubAdManager::IMPRESSION_HANDLER = QString ("/m/imp");
+const QString MoPubAdManager::CONVERSION_HANDLER = QString("/m/open");
+const int MoPubAdManager::MINIMUM_REFRESH_TIME_MILLISECONDS = 10000;
+const int MoPubAdManager::MAXIMUM_REFRESH_TIME_MILLISECONDS = 60000;
+const double MoPubAdManager::EXPONENTIAL_BACKOFF_FACTOR = 1.5;
+const int MoPubAdManager::DATA_SAVER_REFRESH_FACTOR = 3;
+const int MoPubAdManager::RENDER_TIMEOUT_MILLISECONDS = 10000;
+const qint64 MoPubAdManager::CLICK_RESOLUTION_TTL_MILLISECONDS = 2 * 60 * 1000;
+
+namespace {
+    bool findHeader(const QList<QNetworkReply::RawHeaderPair>& headers, const char* name, QByteArray* value) {
+        for (int i = 0; i < headers.size(); ++i) {
+            if (qstricmp(headers.at(i).first.constData(), name) == 0) {
+                *value = headers.at(i).second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const char* const FETCH_STATE_NAMES[] = { "idle", "requesting", "rendering", "backoff", "cancelled" };
+}
+
+MoPubAdManager::MoPubAdManager(MoPubAdEnvironment* environment, QObject* parent)
+: QObject(parent)
+, mEnvironment(environment)
+, mNetworkConfigurationManager(new QNetworkConfigurationManager(this))
+, mAdFetcher(new MoPubAdFetcher())
+, mAutoAdRefreshTimer(new QTimer(this))
+, mRenderTimer(new QTimer(this))
+, mFetchState(Idle)
+, mInterstitial(false)
+, mFetchTicket(0)
+, mOpenFetchSpan(0)
+, mUiThreadNanoseconds(0)
+, mCreativeKind(MoPubCreativeClassifier::Dynamic)
+, mSkippedRenderCount(0)
+, mSuppressedLoadCount(0)
+, mDiscardedReplyCount(0)
+, mShortCircuitedLoadCount(0)
+, mBreakerProbe(0)
+, mConversionPending(false)
+, mImpressionPending(false)
+, mViewable(false)
+, mRefreshTimeMilliseconds(60000)
+, mAutoRefreshEnabled(true)
+, mRefreshSuspended(false)
+, mFetchTimeoutMilliseconds(MoPubAdFetcher::FETCH_TIMEOUT_MILLISECONDS)
+, mInterceptslinks(false)
+{
+    Q_CHECK_PTR(mEnvironment);
+    bool res = connect(mAutoAdRefreshTimer, SIGNAL(timeout()), this, SLOT(onRefreshTimer()));
+    Q_ASSERT(res);
+    mRenderTimer->setSingleShot(true);
+    mRenderTimer->setInterval(RENDER_TIMEOUT_MILLISECONDS);
+    res = connect(mRenderTimer, SIGNAL(timeout()), this, SLOT(onRenderTimeout()));
+    Q_ASSERT(res);
+
+    // Replies are parsed on the network thread, only the results come back here.
+    res = connect(mAdFetcher, SIGNAL(adResponse(MoPubAdResponse)), this, SLOT(onAdResponse(MoPubAdResponse)));
+    Q_ASSERT(res);
+    res = connect(mAdFetcher, SIGNAL(fetchFailed(int, int)), this, SLOT(onFetchAdError(int, int)));
+    Q_ASSERT(res);
+    res = connect(mAdFetcher, SIGNAL(clickResolved(QUrl, QUrl, int)), this, SLOT(onClickResolved(QUrl, QUrl, int)));
+    Q_ASSERT(res);
+    res = connect(mAdFetcher, SIGNAL(storedAdLoaded(QString, MoPubStoredAd)),
+            this, SLOT(onStoredAdLoaded(QString, MoPubStoredAd)));
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+    MoPubAdPlacementManager::instance()->registerPlacement(this);
+    // Created here so it lives on the UI thread, MOPUB_TRACE starts recording with it.
+    MoPubTrace::instance();
+#ifndef QT_NO_DEBUG
+    // Release builds leave it to the app, the heartbeat keeps the CPU awake.
+    MoPubStallWatchdog::instance()->start();
+#endif
+}
+
+MoPubAdManager::~MoPubAdManager()
+{
+    MoPubAdPlacementManager::instance()->unregisterPlacement(this);
+    MoPubDataUsage::instance()->flush();
+    // The fetcher lives on the network thread, let it go away there.
+    mAdFetcher->deleteLater();
+}
+
+void MoPubAdManager::setAdUnitId(const QString& value) {
+    // Whatever is on its way belongs to the previous unit, the load starts over for the new one.
+    const bool restart = value != mAdUnitId && isLoading();
+    if (value != mAdUnitId) cancel();
+    mAdUnitId = value;
+    QMetaObject::invokeMethod(mAdFetcher, "setAdUnitId", Qt::QueuedConnection, Q_ARG(QString, mAdUnitId));
+    // Size the slot the way the last response for this unit did, before anything is fetched.
+    MoPubAdUnitMetadata metadata;
+    if (MoPubAdUnitMetadataCache::instance()->lookup(mAdUnitId, &metadata)) {
+        applyAdUnitMetadata(metadata);
+    }
+    // Show the last good creative right away, a fresh ad replaces it once one arrives.
+    showStoredAd();
+    if (restart) loadAd();
+}
+
+void MoPubAdManager::setClickThroughUrl(const QUrl& value) {
+    mClickThroughUrl = value;
+    mUrlRouter.setClickThroughPrefix(mClickThroughUrl);
+}
+
+void MoPubAdManager::setAutoRefreshEnabled(bool value) {
+    mAutoRefreshEnabled = value;
+    if (!mAutoRefreshEnabled) cancelRefreshTimer();
+    else scheduleRefreshTimerIfEnabled();
+}
+
+void MoPubAdManager::setRefreshSuspended(bool value) {
+    if (value == mRefreshSuspended) return;
+    mRefreshSuspended = value;
+    if (mRefreshSuspended) cancelRefreshTimer();
+    // A load under way arms the next refresh itself.
+    else if (!isLoading()) scheduleRefreshTimerIfEnabled();
+}
+
+int MoPubAdManager::queueWaitMilliseconds() const {
+    return MoPubAdPlacementManager::instance()->lastQueueWaitMilliseconds(const_cast<MoPubAdManager*>(this));
+}
+
+bool MoPubAdManager::setAdHtml(const QString& html, const QUrl& baseUrl, const QByteArray& contentHash,
+        MoPubCreativeClassifier::Kind kind){
+    // Reloading the creative already on screen would only rebuild its DOM, rerun its scripts and flash.
+    if (contentHash == mContentHash) {
+        ++mSkippedRenderCount;
+        MPLogInfo("Same creative for %1, render skipped (%2 so far)", mAdUnitId, mSkippedRenderCount);
+        return false;
+    }
+    mContentHash = contentHash;
+    mCreativeKind = kind;
+    emit htmlReady(html, baseUrl);
+    return true;
+}
+
+void MoPubAdManager::showStoredAd(){
+    if (!mContentHash.isEmpty() || mAdUnitId.isEmpty()) return;
+    QMetaObject::invokeMethod(mAdFetcher, "loadStoredAd", Qt::QueuedConnection, Q_ARG(QString, mAdUnitId));
+}
+
+void MoPubAdManager::onStoredAdLoaded(const QString& adUnitId, const MoPubStoredAd& ad){
+    // The unit changed or a fresh creative got there first.
+    if (adUnitId != mAdUnitId || !mContentHash.isEmpty() || !ad.isValid()) return;
+    MoPubStallScope stallScope("showStoredAd", mAdUnitId);
+
+    MPLogDebug("Showing stored ad for %1", mAdUnitId);
+    configureUsingHeaders(ad.headers);
+    // The failover chain of a past response is meaningless now.
+    mFailUrl = QUrl();
+    const QString html = QString::fromUtf8(ad.html.constData(), ad.html.size());
+    setAdHtml(html, ad.baseUrl, MoPubAdResponse::hashContent(ad.html, ad.headers),
+            MoPubCreativeClassifier::classify(html));
+}
+
+void MoPubAdManager::setFetchState(FetchState state){
+    bool expected;
+    switch (mFetchState) {
+    // Every outcome of a fetch, a failover starts the next one.
+    case Requesting:    expected = true; break;
+    case Rendering:     expected = state != Rendering; break;
+    // Waiting for the next load, which can only start or be put off.
+    default:            expected = state == Requesting || state == Backoff || state == mFetchState; break;
+    }
+    if (!expected) {
+        MPLogWarn("Unexpected fetch state change for %1: %2 -> %3", mAdUnitId,
+                FETCH_STATE_NAMES[mFetchState], FETCH_STATE_NAMES[state]);
+    } else {
+        MPLogTrace("Fetch state of %1: %2 -> %3", mAdUnitId, FETCH_STATE_NAMES[mFetchState], FETCH_STATE_NAMES[state]);
+    }
+    if (MoPubTrace::isEnabled()) {
+        // A load spans from the first request to its outcome, failovers included; each busy state nests in it.
+        MoPubTrace* trace = MoPubTrace::instance();
+        const bool wasLoading = isLoading();
+        const bool loading = state == Requesting || state == Rendering;
+        if (wasLoading) trace->end(FETCH_STATE_NAMES[mFetchState], this);
+        if (!wasLoading && loading) trace->begin("load", this, mAdUnitId);
+        if (wasLoading && !loading) trace->end("load", this);
+        if (loading) trace->begin(FETCH_STATE_NAMES[state], this, mAdUnitId);
+        else trace->instant(FETCH_STATE_NAMES[state], this, mAdUnitId);
+    }
+    mFetchState = state;
+    // A creative that never reports back must not keep the placement loading.
+    if (state == Rendering) mRenderTimer->start();
+    else mRenderTimer->stop();
+}
+
+int MoPubAdManager::renderTimeoutMilliseconds() const {
+    return mRenderTimer->interval();
+}
+
+void MoPubAdManager::setRenderTimeoutMilliseconds(int value) {
+    mRenderTimer->setInterval(value);
+}
+
+void MoPubAdManager::setFetchTimeoutMilliseconds(int value) {
+    mFetchTimeoutMilliseconds = value;
+    QMetaObject::invokeMethod(mAdFetcher, "setFetchTimeoutMilliseconds", Qt::QueuedConnection, Q_ARG(int, value));
+}
+
+void MoPubAdManager::onRenderTimeout(){
+    if (mFetchState != Rendering) return;
+    // The creative is on screen, it just never said so.
+    MPLogWarn("Creative of %1 reported neither finishload nor failload within %2 ms, load completed.",
+            mAdUnitId, mRenderTimer->interval());
+    emitAdDidLoad();
+}
+
+void MoPubAdManager::loadAd(){
+    MoPubStallScope stallScope("loadAd", mAdUnitId);
+
+    if (isLoading()) {
+        ++mSuppressedLoadCount;
+        MPLogDebug("Already loading an ad for %1, wait to finish (%2 loads suppressed).", mAdUnitId, mSuppressedLoadCount);
+        return;
+    }
+
+    if (mAdUnitId.isEmpty()){
+        MPLogWarn("Can't load an ad in this ad view because the ad unit ID is null. Did you forget to call setAdUnitId()?");
+        return;
+    }
+
+    if (!MoPubNetworkThread::instance()->isReplaying() && !mNetworkConfigurationManager->isOnline()){
+        MPLogInfo("Can't load an ad because there is no network connectivity.");
+        showStoredAd();
+        setFetchState(Backoff);
+        scheduleRefreshTimerIfEnabled();
+        return;
+    }
+
+    // Nobody is looking at it, the stored creative will do until somebody is.
+    if (!mInterstitial && !mEnvironment->isOnScreen() && dataSaverActive()) {
+        MPLogInfo("Data saver on, skipping the prefetch of %1.", mAdUnitId);
+        showStoredAd();
+        setFetchState(Backoff);
+        scheduleRefreshTimerIfEnabled();
+        return;
+    }
+
+    // The unit keeps failing for every placement, don't add to it until the breaker lets a probe through.
+    if (!MoPubCircuitBreaker::instance()->allowRequest(mAdUnitId, &mBreakerProbe)) {
+        ++mShortCircuitedLoadCount;
+        MPLogInfo("Circuit breaker of %1 open, load short-circuited (retry in %2 ms).", mAdUnitId,
+                MoPubCircuitBreaker::instance()->retryAfterMilliseconds(mAdUnitId));
+        showStoredAd();
+        emitAdFailed();
+        return;
+    }
+
+    mFailUrl = QUrl();
+    // Requested while the scene was still being built.
+    if (adoptEarlyFetch()) return;
+    startFetch(generateAdUrl());
+}
+
+bool MoPubAdManager::adoptEarlyFetch(){
+    QUrl url;
+    const int ticket = MoPubEarlyStart::instance()->adopt(mAdUnitId, this, &url);
+    if (ticket == 0) return false;
+    cancelRefreshTimer();
+    setFetchState(Requesting);
+    mUiThreadNanoseconds = 0;
+    mUrl = url;
+    mFetchTicket = ticket;
+    emit adWillLoad(mUrl);
+    beginFetchSpan("request", mUrl.toString());
+    return true;
+}
+
+void MoPubAdManager::startFetch(const QUrl& url){
+    QElapsedTimer uiThreadTimer;
+    uiThreadTimer.start();
+    mUiThreadNanoseconds = 0;
+
+    // A refresh falling due now would only be suppressed, the outcome of this load schedules the next.
+    cancelRefreshTimer();
+    setFetchState(Requesting);
+
+    mUrl = url;
+    MPLogDebug("Fetch Ad for %1", mUrl);
+    emit adWillLoad(mUrl);
+
+    // Visible banners go first, off-screen prefetches and interstitial preloads wait their turn.
+    MoPubAdPlacementManager::Priority priority = MoPubAdPlacementManager::VisibleBanner;
+    if (mInterstitial) priority = MoPubAdPlacementManager::InterstitialPreload;
+    else if (!mEnvironment->isOnScreen()) priority = MoPubAdPlacementManager::OffscreenPrefetch;
+    mFetchTicket = MoPubAdPlacementManager::instance()->requestFetch(this, priority);
+    beginFetchSpan("queued");
+    mUiThreadNanoseconds += uiThreadTimer.nsecsElapsed();
+}
+
+QString MoPubAdManager::createMoPubAPIUrl(const QString& handlerPart, const QString& adUnitId){
+    QString urlString;
+    urlString.append(MOPUB_URL + handlerPart);
+    urlString.append("?v=" + API_VERSION);
+    urlString.append("&id=" + adUnitId );
+    return urlString;
+}
+
+QUrl MoPubAdManager::generateAdUrl(){
+    return adRequestUrl(mAdUnitId, mEnvironment);
+}
+
+QUrl MoPubAdManager::adRequestUrl(const QString& adUnitId, MoPubAdEnvironment* environment){
+    QString urlString = createMoPubAPIUrl(AD_HANDLER, adUnitId);
+    urlString.append("&nv=" + SDK_VERSION);
+    urlString.append("&udid=" + environment->udid());
+
+    QString location = environment->location();
+    if (!location.isEmpty()) {
+        urlString.append("&ll=" + location);
+    }
+
+    QString timeZone = getTimeZone();
+    if (!timeZone.isEmpty()){
+        urlString.append("&z=" + timeZone);
+    }
+
+    urlString.append("&o=" + environment->orientation());
+
+    bool mraid = false;
+    if (mraid) urlString.append("&mr=1");
+    return urlString;
+}
+
+QString MoPubAdManager::getTimeZone(){
+    return QString().setNum(QDateTime::currentDateTime().utcOffset());
+}
+
+MoPubUrlRouter::Route MoPubAdManager::navigate(const QUrl& url){
+    MoPubStallScope stallScope("navigate", mAdUnitId);
+    MoPubUrlRouter::Route route = mUrlRouter.route(url, mUrl);
+    switch (route) {
+    case MoPubUrlRouter::LaunchPage:
+        addClickTrackingRedirect(url);
+        // The creative left for its landing page, it won't report finishload anymore.
+        if (mFetchState == Rendering) {
+            setFetchState(Idle);
+            scheduleRefreshTimerIfEnabled();
+        }
+        break;
+    case MoPubUrlRouter::FinishLoad:
+        MPLogTrace("emit finishload");
+        if (MoPubTrace::isEnabled()) MoPubTrace::instance()->instant("finishload", this, mAdUnitId);
+        // Only the creative of the current fetch completes it, a stored or abandoned one just reports in.
+        if (mFetchState == Rendering) emitAdDidLoad();
+        else emit adDidLoad();
+        break;
+    case MoPubUrlRouter::FailLoad:
+        MPLogTrace("failload loadFailUrl");
+        if (MoPubTrace::isEnabled()) MoPubTrace::instance()->instant("failload", this, mAdUnitId);
+        // Whatever is on screen now is broken, the next response must render even if it is the same.
+        mContentHash.clear();
+        if (mFetchState == Rendering) failover();
+        // The fetch under way replaces it anyway.
+        else if (mFetchState != Requesting) emitAdFailed();
+        break;
+    case MoPubUrlRouter::Browser:
+        addClickTrackingRedirect(url);
+        break;
+    default:
+        break;
+    }
+    return route;
+}
+
+void MoPubAdManager::registerClick(){
+    if (!mClickThroughUrl.isEmpty()) {
+        track(mClickThroughUrl, "click");
+    }
+}
+
+void MoPubAdManager::track(const QUrl& url, const char* beacon){
+    if (MoPubTrace::isEnabled()) MoPubTrace::instance()->instant(beacon, this, mAdUnitId, url.toString());
+    //Latin1 encoding chosen with suggestion from RFC 5987 might not be the perfect choice.
+    QMetaObject::invokeMethod(mAdFetcher, "track", Qt::QueuedConnection,
+            Q_ARG(QUrl, url), Q_ARG(QByteArray, mEnvironment->userAgent().toLatin1()));
+}
+
+void MoPubAdManager::addClickTrackingRedirect(QUrl url){
+    if (!mClickThroughUrl.isEmpty()) {
+       url.setUrl(mClickThroughUrl.toString() + "&r=" + url.toString());
+    }
+}
+
+QUrl MoPubAdManager::landingUrlForClick(const QUrl& clickUrl, bool trackClickUrl, int* hops){
+    QUrl landingUrl = clickUrl;
+    if (hops) *hops = 0;
+    QHash<QByteArray, ResolvedClick>::const_iterator resolved = mResolvedClicks.constFind(clickUrl.toEncoded());
+    if (resolved != mResolvedClicks.constEnd() && resolved->expiresAt > QDateTime::currentMSecsSinceEpoch()) {
+        landingUrl = resolved->landingUrl;
+        if (hops) *hops = resolved->hops;
+    }
+    // The browser skips the click tracker hop, so it goes out as a beacon instead.
+    if (trackClickUrl && landingUrl != clickUrl) {
+        track(clickUrl, "click");
+    }
+    return landingUrl;
+}
+
+void MoPubAdManager::resolveClickUrls()
+{
+    const QByteArray userAgent = mEnvironment->userAgent().toLatin1();
+    foreach (const QUrl& clickUrl, mClickUrls) {
+        // Only MoPub's click-through, whose tracker goes out as a beacon on the tap. Any other
+        // link may be a third party click tracker, requesting it ahead of a tap would count a click.
+        if (mUrlRouter.route(clickUrl, mUrl) != MoPubUrlRouter::ClickThrough) continue;
+        // Never hit the click tracker ahead of a tap, only the destination behind it.
+        const QUrl startUrl(clickUrl.queryItemValue("r"));
+        if (startUrl.isEmpty()) continue;
+        // Still fresh from an earlier showing of the same creative.
+        QHash<QByteArray, ResolvedClick>::const_iterator resolved = mResolvedClicks.constFind(clickUrl.toEncoded());
+        if (resolved != mResolvedClicks.constEnd() && resolved->expiresAt > QDateTime::currentMSecsSinceEpoch()) continue;
+        QMetaObject::invokeMethod(mAdFetcher, "resolve", Qt::QueuedConnection,
+                Q_ARG(QUrl, clickUrl), Q_ARG(QUrl, startUrl), Q_ARG(QByteArray, userAgent));
+    }
+    mClickUrls.clear();
+}
+
+void MoPubAdManager::onClickResolved(const QUrl& clickUrl, const QUrl& landingUrl, int hops)
+{
+    MPLogDebug("Click %1 resolved to %2 in %3 hops", clickUrl, landingUrl, hops);
+    ResolvedClick resolved;
+    resolved.landingUrl = landingUrl;
+    resolved.hops = hops;
+    resolved.expiresAt = QDateTime::currentMSecsSinceEpoch() + CLICK_RESOLUTION_TTL_MILLISECONDS;
+    mResolvedClicks.insert(clickUrl.toEncoded(), resolved);
+}
+
+void MoPubAdManager::onFetchGranted(int ticket, int networkPriority){
+    if (ticket != mFetchTicket) {
+        // Superseded while queued, give the slot back.
+        MoPubAdPlacementManager::instance()->fetchFinished(ticket);
+        return;
+    }
+    MPLogDebug("Fetch slot for %1 granted after %2 ms", mAdUnitId, queueWaitMilliseconds());
+    beginFetchSpan("request", mUrl.toString());
+    fetchAd(networkPriority);
+}
+
+void MoPubAdManager::fetchAd(int networkPriority){
+    QMetaObject::invokeMethod(mAdFetcher, "fetch", Qt::QueuedConnection,
+            Q_ARG(int, mFetchTicket), Q_ARG(QUrl, mUrl), Q_ARG(QByteArray, mEnvironment->userAgent().toLatin1()),
+            Q_ARG(int, networkPriority), Q_ARG(bool, dataSaverActive()));
+}
+
+bool MoPubAdManager::finishFetch(int requestId){
+    // Adopted early fetches never held a slot.
+    if (requestId > 0) MoPubAdPlacementManager::instance()->fetchFinished(requestId);
+    // Superseded, cancelled or already answered.
+    if (requestId != mFetchTicket || mFetchState != Requesting) {
+        ++mDiscardedReplyCount;
+        MPLogDebug("Ignoring stale reply %1 for %2 (%3 discarded)", requestId, mAdUnitId, mDiscardedReplyCount);
+        return false;
+    }
+    endFetchSpan();
+    return true;
+}
+
+void MoPubAdManager::beginFetchSpan(const char* name, const QString& detail){
+    endFetchSpan();
+    if (!MoPubTrace::isEnabled()) return;
+    MoPubTrace::instance()->begin(name, this, mAdUnitId, detail);
+    mOpenFetchSpan = name;
+}
+
+void MoPubAdManager::endFetchSpan(){
+    // Only what was begun while tracing, so begin and end events always pair up.
+    if (mOpenFetchSpan && MoPubTrace::isEnabled()) MoPubTrace::instance()->end(mOpenFetchSpan, this);
+    mOpenFetchSpan = 0;
+}
+
+void MoPubAdManager::onFetchAdError(int requestId, int code){
+    if (!finishFetch(requestId)) return;
+    MPLogWarn("Network Error fetching ad code: %1", code);
+    // The probe went unanswered, the breaker replaces it once it times out.
+    mBreakerProbe = 0;
+    failover();
+}
+
+void MoPubAdManager::onAdResponse(const MoPubAdResponse& response){
+    if (!finishFetch(response.requestId)) return;
+    MoPubStallScope stallScope("handleAdResponse", mAdUnitId);
+    QElapsedTimer uiThreadTimer;
+    uiThreadTimer.start();
+    handleAdResponse(response);
+    mUiThreadNanoseconds += uiThreadTimer.nsecsElapsed();
+    MPLogDebug("UI thread time for ad load of %1: %2 us", mAdUnitId, mUiThreadNanoseconds / 1000);
+}
+
+void MoPubAdManager::handleAdResponse(const MoPubAdResponse& response){
+    // Failovers included, they all ask the server for this unit.
+    MoPubCircuitBreaker::Outcome outcome = MoPubCircuitBreaker::Served;
+    if (response.status != MoPubAdResponse::Success) outcome = MoPubCircuitBreaker::ServerError;
+    else if (response.adType == MoPubAdResponse::ClearAd) outcome = MoPubCircuitBreaker::NoFill;
+    MoPubCircuitBreaker::instance()->record(mAdUnitId, outcome, mBreakerProbe);
+    // Failover hops are not the probe.
+    mBreakerProbe = 0;
+
+    if (response.status == MoPubAdResponse::ServerErrorBackoff){
+        MPLogWarn("MoPub server returned invalid response. %1", response.reasonPhrase);
+        exponentialBackoff();
+        emitAdFailed();
+        return;
+    }else if (response.status == MoPubAdResponse::ServerErrorNoBackoff){
+        MPLogWarn("MoPub server returned invalid response. %1", response.reasonPhrase);
+        emitAdFailed();
+        return;
+    }
+
+    configureUsingHeaders(response.headers);
+
+    switch (response.adType) {
+    // Ensure that the ad type header is valid and not "clear".
+    case MoPubAdResponse::ClearAd:
+        MPLogInfo("MoPub server returned no ad.");
+        exponentialBackoff();
+        failover();
+        return;
+    // Handle custom native ad type.
+    case MoPubAdResponse::CustomAd:
+        if (response.hasCustomSelector) {
+            MPLogDebug("Trying to call method named %1", response.customSelector);
+            //TODO Handle custom native ad type.
+            MPLogWarn("Couldn't call custom method not implemented.");
+        }
+        emitAdFailed();
+        return;
+    // Handle mraid ad type
+    case MoPubAdResponse::MraidAd:
+        MPLogDebug("Loading mraid ad");
+        loadNativeSDK(response);
+        emitAdFailed();
+        return;
+    // Handle native SDK ad type.
+    case MoPubAdResponse::NativeAd:
+        MPLogDebug("Loading native ad");
+        loadNativeSDK(response);
+        emitAdFailed();
+        return;
+    case MoPubAdResponse::HtmlAd:
+        break;
+    }
+
+    // Handle HTML ad.
+    setFetchState(Rendering);
+    const bool rendered = setAdHtml(response.html, mUrl, response.contentHash, response.creativeKind);
+    MPLogDebug("Creative for %1 is %2", mAdUnitId, MoPubCreativeClassifier::kindName(response.creativeKind));
+    // Every response carries its own impression, counted once the creative is viewable.
+    mImpressionPending = true;
+    setViewable(mViewable);
+    // Resolved once the creative reports finishload.
+    if (rendered) mResolvedClicks.clear();
+    mClickUrls = response.clickUrls;
+    // Remember the creative, it goes to the ad store once it reports finishload. A skipped
+    // render left the stored one on screen, saving it again would only rewrite the file.
+    mPendingStoredAd = MoPubStoredAd();
+    if (rendered) {
+        mPendingStoredAd.baseUrl = mUrl;
+        mPendingStoredAd.html = response.html.toUtf8();
+        mPendingStoredAd.headers = response.headers;
+        mPendingStoredAd.savedAt = QDateTime::currentMSecsSinceEpoch();
+        mPendingStoredAd.expiresAt = MoPubAdStore::expiryFromHeaders(mPendingStoredAd.headers, mPendingStoredAd.savedAt);
+    }
+    // A skipped render never reports finishload, and neither does a creative rendered without
+    // scripts, complete the load the way it would have.
+    if (!rendered || !MoPubCreativeClassifier::needsScript(response.creativeKind)) emitAdDidLoad();
+}
+
+//TODO add any native SDK support currently there are none for BB10
+void MoPubAdManager::loadNativeSDK(const MoPubAdResponse& response){
+    if (response.adType == MoPubAdResponse::NativeAd) {
+        // Pull the fields a renderer needs straight off the header bytes and pass over the rest.
+        QElapsedTimer parseTimer;
+        parseTimer.start();
+        MoPubJsonReader json(response.nativeParamsJson);
+        QString networkAdUnitId;
+        QString title;
+        QString clickUrl;
+        int width = 0;
+        int height = 0;
+        int impressionTrackers = 0;
+        if (json.next() == MoPubJsonReader::BeginObject) {
+            while (json.next() == MoPubJsonReader::Name) {
+                const QByteArray name = json.view();
+                json.next();
+                if (name == "adUnitID") networkAdUnitId = json.toString();
+                else if (name == "adWidth") width = json.toInt();
+                else if (name == "adHeight") height = json.toInt();
+                else if (name == "title") title = json.toString();
+                else if (name == "clk") clickUrl = json.toString();
+                else if (name == "imptracker" && json.token() == MoPubJsonReader::BeginArray) {
+                    while (json.next() != MoPubJsonReader::EndArray && json.token() != MoPubJsonReader::Invalid) {
+                        if (json.token() == MoPubJsonReader::String) ++impressionTrackers;
+                        json.skipValue();
+                    }
+                }
+                else json.skipValue();
+            }
+        }
+        if (json.token() != MoPubJsonReader::EndObject) {
+            MPLogWarn("Malformed native params for %1 at offset %2: %3", mAdUnitId, json.errorOffset(), json.errorString());
+        } else {
+            // Release builds log at warning level, say what was dropped there.
+            MPLogWarn("Loading native SDK is not implemented, dropped the native ad of %1 (params read in %2 ns): network unit %3, %4",
+                    mAdUnitId, parseTimer.nsecsElapsed(), networkAdUnitId,
+                    QString("%1x%2, title '%3', click %4, %5 impression trackers").arg(width).arg(height).arg(title, clickUrl).arg(impressionTrackers));
+            return;
+        }
+    }
+    MPLogWarn("Loading native SDK is not implemented.");
+}
+
+void MoPubAdManager::configureUsingHeaders(const QList<QNetworkReply::RawHeaderPair>& headers){
+    QByteArray value;
+
+    // Print the ad network type to the console.
+    if (findHeader(headers, "X-Networktype", &value)) {
+        MPLogInfo("Fetching ad network type: %1", value);
+    }
+
+    // Set the redirect URL prefix: navigating to any matching URLs will send us to the browser.
+    if (findHeader(headers, "X-Launchpage", &value)) {
+        mRedirectUrl = QUrl(QString(value));
+    }else {mRedirectUrl = QUrl();}
+    mUrlRouter.setLaunchPagePrefix(mRedirectUrl);
+
+    // Set the URL that is prepended to links for click-tracking purposes.
+    if (findHeader(headers, "X-Clickthrough", &value)) {
+        mClickThroughUrl = QString(value);
+    }else {mClickThroughUrl = QString();}
+    mUrlRouter.setClickThroughPrefix(mClickThroughUrl);
+
+    // Set the fall-back URL to be used if the current request fails.
+    if (findHeader(headers, "X-Failurl", &value)) {
+        mFailUrl = QUrl(QString(value));
+    }else {mFailUrl = QUrl();}
+
+    // Set the URL to be used for impression tracking.
+    if (findHeader(headers, "X-Imptracker", &value)) {
+        mImpressionUrl = QUrl(QString(value));
+    }else {mImpressionUrl = QUrl();}
+
+    // Scrollability, size, auto-refresh time and orientations, remembered for the next launch.
+    MoPubAdUnitMetadata metadata = MoPubAdUnitMetadata::fromHeaders(headers);
+    applyAdUnitMetadata(metadata);
+    MoPubAdUnitMetadataCache::instance()->save(mAdUnitId, metadata);
+
+    if (findHeader(headers, "X-Interceptlinks", &value)){
+        if (QString(value) == "1"){
+            mInterceptslinks = true;
+        } else {mInterceptslinks = false;}
+
+    }
+}
+
+void MoPubAdManager::applyAdUnitMetadata(const MoPubAdUnitMetadata& metadata){
+    // Only ask for a relayout when something changed, the same values would still relayout.
+    if (metadata.scrollable != mMetadata.scrollable || metadata.width != mMetadata.width
+            || metadata.height != mMetadata.height) {
+        emit layoutChanged(metadata.width, metadata.height, metadata.scrollable);
+    }
+    mMetadata = metadata;
+
+    // A timer will be scheduled upon ad success or failure.
+    mRefreshTimeMilliseconds = metadata.refreshTimeMilliseconds;
+    if (mRefreshTimeMilliseconds > 0 && mRefreshTimeMilliseconds < MINIMUM_REFRESH_TIME_MILLISECONDS) {
+        mRefreshTimeMilliseconds = MINIMUM_REFRESH_TIME_MILLISECONDS;
+    }
+    mAdOrientation = metadata.orientation;
+}
+
+void MoPubAdManager::scheduleRefreshTimerIfEnabled(){
+    if (!mAutoRefreshEnabled || mRefreshSuspended || mRefreshTimeMilliseconds <= 0) return;
+    int refreshMills = mRefreshTimeMilliseconds;
+    if (dataSaverActive()) refreshMills *= DATA_SAVER_REFRESH_FACTOR;
+    mAutoAdRefreshTimer->setSingleShot(true);
+    mAutoAdRefreshTimer->start(refreshMills);
+    if (MoPubTrace::isEnabled()) MoPubTrace::instance()->instant("refreshArmed", this, mAdUnitId, QString::number(refreshMills));
+    MPLogDebug("Auto refreshing AdUnit %1 enabled for timeout after %2ms", mAdUnitId, refreshMills);
+}
+
+bool MoPubAdManager::dataSaverActive() const {
+    // Anything not known to be WLAN or wired is treated as metered, unknown bearers included.
+    const QNetworkConfiguration::BearerType bearer = mNetworkConfigurationManager->defaultConfiguration().bearerType();
+    return MoPubDataUsage::instance()->dataSaverActive(MoPubDataUsage::isMetered(bearer));
+}
+
+void MoPubAdManager::onRefreshTimer(){
+    if (MoPubTrace::isEnabled()) MoPubTrace::instance()->instant("refreshFired", this, mAdUnitId);
+    loadAd();
+}
+
+void MoPubAdManager::cancelRefreshTimer(){
+    if (mAutoAdRefreshTimer->isActive())
+    {
+        mAutoAdRefreshTimer->stop();
+        MPLogDebug("Auto refreshing AdUnit %1 disabled.", mAdUnitId);
+    }
+}
+
+void MoPubAdManager::loadFailUrl(){
+    if (isLoading()) {
+        ++mSuppressedLoadCount;
+        MPLogDebug("Already loading an ad for %1, failover not started (%2 loads suppressed).", mAdUnitId, mSuppressedLoadCount);
+        return;
+    }
+    failover();
+}
+
+void MoPubAdManager::failover(){
+    if (mFailUrl.isEmpty()) {
+        // No other URLs to try, so signal a failure.
+        emitAdFailed();
+        return;
+    }
+    // Each failover URL is tried once, its response names the next one.
+    const QUrl failUrl = mFailUrl;
+    mFailUrl = QUrl();
+    MPLogInfo("Loading failover url: %1", failUrl);
+    if (MoPubTrace::isEnabled()) MoPubTrace::instance()->instant("failover", this, mAdUnitId, failUrl.toString());
+    startFetch(failUrl);
+}
+
+void MoPubAdManager::cancel(){
+    if (!isLoading()) return;
+    MPLogDebug("Load of %1 cancelled", mAdUnitId);
+    // No ticket matches 0: a queued one is handed back when granted, an in-flight one when its reply arrives.
+    mFetchTicket = 0;
+    mFailUrl = QUrl();
+    mPendingStoredAd = MoPubStoredAd();
+    mBreakerProbe = 0;
+    // The abandoned ticket never reaches finishFetch().
+    endFetchSpan();
+    setFetchState(Cancelled);
+    // Nothing else would start the next load.
+    scheduleRefreshTimerIfEnabled();
+    reportPendingConversion();
+}
+
+void MoPubAdManager::emitAdDidLoad(){
+    MPLogInfo("Ad successfully loaded.");
+    MoPubEarlyStart::instance()->recordAdLoaded(mAdUnitId, mFetchTicket < 0);
+    setFetchState(Idle);
+    if (mPendingStoredAd.isValid()) {
+        // Written on the network thread, the UI thread never waits on the file.
+        QMetaObject::invokeMethod(mAdFetcher, "storeAd", Qt::QueuedConnection,
+                Q_ARG(QString, mAdUnitId), Q_ARG(MoPubStoredAd, mPendingStoredAd));
+        mPendingStoredAd = MoPubStoredAd();
+    }
+    resolveClickUrls();
+    scheduleRefreshTimerIfEnabled();
+    reportPendingConversion();
+    emit adDidLoad();
+}
+void MoPubAdManager::emitAdFailed(){
+    MPLogInfo("Ad failed to load.");
+    setFetchState(Backoff);
+    scheduleRefreshTimerIfEnabled();
+    reportPendingConversion();
+    emit adFailed();
+}
+
+void MoPubAdManager::setViewable(bool viewable){
+    mViewable = viewable;
+    if (!viewable || !mImpressionPending) return;
+    mImpressionPending = false;
+    MPLogDebug("Ad unit %1 viewable, tracking impression", mAdUnitId);
+    trackImpression();
+}
+
+void MoPubAdManager::trackImpression() {
+    if (mImpressionUrl.isEmpty()) return;
+    track(mImpressionUrl, "impression");
+}
+
+void MoPubAdManager::exponentialBackoff(){
+    int refreshMills =  mRefreshTimeMilliseconds * EXPONENTIAL_BACKOFF_FACTOR;
+    if (refreshMills > MAXIMUM_REFRESH_TIME_MILLISECONDS){
+        refreshMills = MAXIMUM_REFRESH_TIME_MILLISECONDS;
+    }
+    mRefreshTimeMilliseconds = refreshMills;
+}
+
+QString MoPubAdManager::createRequestId(){
+    return "&reqid=" + QUuid::createUuid();
+}
+
+QString MoPubAdManager::createRequestTime(){
+    return "&reqt=" + QString::number(QDateTime::currentMSecsSinceEpoch());
+}
+
+void MoPubAdManager::impressionTracking(){
+    track(QUrl(
+                createMoPubAPIUrl(IMPRESSION_HANDLER, mAdUnitId)
+                + "&udid=" + mEnvironment->udid()
+                + "&appid=" + mEnvironment->installId()
+                + createRequestId()
+                + createRequestTime()
+                + "&random=" + QString::number(rand())
+                ), "impression");
+}
+
+void MoPubAdManager::conversionTracking(){
+    // Never compete with the first ad fetch, report once it has settled.
+    mConversionPending = true;
+    if (!isLoading()) reportPendingConversion();
+}
+
+void MoPubAdManager::reportPendingConversion(){
+    if (!mConversionPending) return;
+    mConversionPending = false;
+    const QString installId = mEnvironment->installId();
+    MoPubConversionTracker::instance()->reportInstall(installId,
+            QUrl(MOPUB_URL + CONVERSION_HANDLER + "?id=" + installId + "&udid=" + mEnvironment->udid()),
+            mEnvironment->userAgent().toLatin1());
+}
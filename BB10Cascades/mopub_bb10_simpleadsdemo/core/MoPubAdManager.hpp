@@ -0,0 +1,260 @@
+#ifndef MOPUBADMANAGER_HPP_
+#define MOPUBADMANAGER_HPP_
+#define TESTING
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QUrl>
+
+#include "MoPubAdResponse.hpp"
+#include "MoPubAdStore.hpp"
+#include "MoPubAdUnitMetadata.hpp"
+#include "MoPubUrlRouter.hpp"
+
+class MoPubAdFetcher;
+class QNetworkConfigurationManager;
+class QTimer;
+
+/*!
+ * @brief What the ad engine needs to know about the device and the app it runs in.
+ *
+ * Implemented by the platform adapter, MoPubView on BB10.
+ */
+class MoPubAdEnvironment {
+public:
+    virtual ~MoPubAdEnvironment() {}
+
+    virtual QString userAgent() const = 0;
+    // Hashed device identifier, sent as the udid parameter.
+    virtual QString udid() const = 0;
+    virtual QString installId() const = 0;
+    // "latitude,longitude", empty when unknown.
+    virtual QString location() const { return QString(); }
+    // "p" or "l".
+    virtual QString orientation() const { return QString("p"); }
+    virtual bool isOnScreen() const { return true; }
+};
+
+/*!
+ * @brief The platform independent ad engine behind a placement, the counterpart of MPAdManager on iOS.
+ *
+ * Builds ad requests, applies the response headers, handles backoff, failover, refresh,
+ * click resolution and impression, click and conversion tracking. It only depends on
+ * QtCore and QtNetwork; the adapter renders what htmlReady() hands it, reports what the
+ * creative navigates to through navigate() and whether it is viewable through setViewable().
+ */
+class MoPubAdManager: public QObject {
+    Q_OBJECT
+    Q_ENUMS(FetchState)
+public:
+    /*!
+     * Idle: the last load succeeded, waiting for the refresh timer.
+     * Requesting: a fetch is queued or in flight, failovers included.
+     * Rendering: the creative was handed to the adapter, waiting for finishload or failload.
+     * Backoff: the last load failed, waiting for the refresh timer.
+     * Cancelled: the load was abandoned, late replies are dropped.
+     */
+    enum FetchState {
+        Idle,
+        Requesting,
+        Rendering,
+        Backoff,
+        Cancelled
+    };
+
+    static const QString SDK_VERSION;
+    static const QString API_VERSION;
+    static const QString MOPUB_URL;
+    static const QString AD_HANDLER;
+    static const QString IMPRESSION_HANDLER;
+    static const QString CONVERSION_HANDLER;
+    static const int MINIMUM_REFRESH_TIME_MILLISECONDS;
+    static const int MAXIMUM_REFRESH_TIME_MILLISECONDS;
+    static const double EXPONENTIAL_BACKOFF_FACTOR;
+    static const int DATA_SAVER_REFRESH_FACTOR;
+    static const int RENDER_TIMEOUT_MILLISECONDS;
+
+    explicit MoPubAdManager(MoPubAdEnvironment* environment, QObject* parent = 0);
+    virtual ~MoPubAdManager();
+
+    // The ad request of an ad unit, as sent for its placements in the given environment.
+    static QUrl adRequestUrl(const QString& adUnitId, MoPubAdEnvironment* environment);
+
+    QString adUnitId() const { return mAdUnitId; }
+    void setAdUnitId(const QString& value);
+
+    bool interstitial() const { return mInterstitial; }
+    void setInterstitial(bool value) { mInterstitial = value; }
+
+    int queueWaitMilliseconds() const;
+    int skippedRenderCount() const { return mSkippedRenderCount; }
+    // Of the creative last handed out through htmlReady().
+    MoPubCreativeClassifier::Kind creativeKind() const { return mCreativeKind; }
+    FetchState fetchState() const { return mFetchState; }
+    bool isLoading() const { return mFetchState == Requesting || mFetchState == Rendering; }
+    // Loads asked for while one was already under way, and replies or creative events that
+    // arrived for a load that was no longer current.
+    int suppressedLoadCount() const { return mSuppressedLoadCount; }
+    int discardedReplyCount() const { return mDiscardedReplyCount; }
+    // Loads refused locally because the unit's MoPubCircuitBreaker was open.
+    int shortCircuitedLoadCount() const { return mShortCircuitedLoadCount; }
+    QUrl url() const { return mUrl; }
+
+    QUrl clickThroughUrl() const { return mClickThroughUrl; }
+    void setClickThroughUrl(const QUrl& value);
+
+    QString adOrientation() const { return mAdOrientation; }
+
+    int refreshTimeMilliseconds() const { return mRefreshTimeMilliseconds; }
+    void setRefreshTimeMilliseconds(int value) { mRefreshTimeMilliseconds = value; }
+
+    // How long a creative that needs scripts gets to report finishload or failload before its
+    // load is completed anyway.
+    int renderTimeoutMilliseconds() const;
+    void setRenderTimeoutMilliseconds(int value);
+    // How long a request waits for its reply before it is aborted and fails over, see MoPubAdFetcher.
+    int fetchTimeoutMilliseconds() const { return mFetchTimeoutMilliseconds; }
+    void setFetchTimeoutMilliseconds(int value);
+
+    QUrl redirectUrl() const { return mRedirectUrl; }
+
+    bool autoRefreshEnabled() const { return mAutoRefreshEnabled; }
+    void setAutoRefreshEnabled(bool value);
+    // Holds the refresh back without touching autoRefreshEnabled, while the adapter has nothing
+    // to show a new creative in. Resuming arms a full refresh interval.
+    bool refreshSuspended() const { return mRefreshSuspended; }
+    void setRefreshSuspended(bool value);
+
+    bool interceptslinks() const { return mInterceptslinks; }
+
+    // See MoPubDataUsage: refreshes less often, skips off-screen prefetches and asks for lighter creatives.
+    bool dataSaverActive() const;
+
+    // Classifies a navigation of the creative and does the engine's part of it.
+    MoPubUrlRouter::Route navigate(const QUrl& url);
+    // Classifies it only.
+    MoPubUrlRouter::Route route(const QUrl& url) const { return mUrlRouter.route(url, mUrl); }
+    // Where a click should open, resolved ahead of time when possible. With trackClickUrl the
+    // click tracker is sent as a beacon whenever the browser gets to skip it.
+    QUrl landingUrlForClick(const QUrl& clickUrl, bool trackClickUrl, int* hops = 0);
+    void registerClick();
+
+    // Shows the last good creative of the ad unit when nothing is shown yet, once the
+    // network thread has read it.
+    void showStoredAd();
+
+public Q_SLOTS:
+    void loadAd();
+    void loadFailUrl();
+    // Abandons the load under way, whatever it still delivers is dropped. The refresh timer
+    // starts over, a cancelled load is retried like a failed one.
+    void cancel();
+    void conversionTracking();
+    void impressionTracking();
+    void setViewable(bool viewable);
+    void scheduleRefreshTimerIfEnabled();
+    void cancelRefreshTimer();
+
+Q_SIGNALS:
+    void adWillLoad(const QUrl& adUrl);
+    void adDidLoad();
+    void adFailed();
+    // A creative to render, only emitted when it differs from the one on screen.
+    // Unless creativeKind() needs scripts it is rendered with them disabled.
+    void htmlReady(const QString& html, const QUrl& baseUrl);
+    void layoutChanged(int width, int height, bool scrollable);
+
+private Q_SLOTS:
+    void onFetchGranted(int ticket, int networkPriority);
+    void onAdResponse(const MoPubAdResponse& response);
+    void onFetchAdError(int requestId, int code);
+    void onClickResolved(const QUrl& clickUrl, const QUrl& landingUrl, int hops);
+    void onStoredAdLoaded(const QString& adUnitId, const MoPubStoredAd& ad);
+    void onRefreshTimer();
+    void onRenderTimeout();
+
+private:
+    void setFetchState(FetchState state);
+    void startFetch(const QUrl& url);
+    bool adoptEarlyFetch();
+    void failover();
+    void fetchAd(int networkPriority);
+    bool finishFetch(int requestId);
+    // The queued or request trace span of the current ticket, at most one is open.
+    void beginFetchSpan(const char* name, const QString& detail = QString());
+    void endFetchSpan();
+    void handleAdResponse(const MoPubAdResponse& response);
+    void configureUsingHeaders(const QList<QNetworkReply::RawHeaderPair>& headers);
+    void applyAdUnitMetadata(const MoPubAdUnitMetadata& metadata);
+    bool setAdHtml(const QString& html, const QUrl& baseUrl, const QByteArray& contentHash,
+            MoPubCreativeClassifier::Kind kind);
+    void loadNativeSDK(const MoPubAdResponse& response);
+    void exponentialBackoff();
+    void resolveClickUrls();
+    void addClickTrackingRedirect(QUrl url);
+    void track(const QUrl& url, const char* beacon);
+    void trackImpression();
+    void reportPendingConversion();
+
+    void emitAdDidLoad();
+    void emitAdFailed();
+
+    QUrl generateAdUrl();
+    static QString createMoPubAPIUrl(const QString& handlerPart, const QString& adUnitId);
+    static QString getTimeZone();
+    QString createRequestId();
+    QString createRequestTime();
+
+    MoPubAdEnvironment* mEnvironment;
+    QNetworkConfigurationManager* mNetworkConfigurationManager;
+    MoPubAdFetcher* mAdFetcher;
+    QTimer* mAutoAdRefreshTimer;
+    QTimer* mRenderTimer;
+
+    QUrl mUrl;
+    QUrl mImpressionUrl;
+    QUrl mFailUrl;
+    FetchState mFetchState;
+    bool mInterstitial;
+    int mFetchTicket;
+    const char* mOpenFetchSpan;
+    MoPubUrlRouter mUrlRouter;
+    qint64 mUiThreadNanoseconds;
+    QByteArray mContentHash;
+    MoPubCreativeClassifier::Kind mCreativeKind;
+    int mSkippedRenderCount;
+    int mSuppressedLoadCount;
+    int mDiscardedReplyCount;
+    int mShortCircuitedLoadCount;
+    // MoPubCircuitBreaker token of the load's first request when it probes a half-open breaker.
+    int mBreakerProbe;
+    MoPubStoredAd mPendingStoredAd;
+    MoPubAdUnitMetadata mMetadata;
+    bool mConversionPending;
+    bool mImpressionPending;
+    bool mViewable;
+
+    struct ResolvedClick {
+        QUrl landingUrl;
+        int hops;
+        qint64 expiresAt;
+    };
+    static const qint64 CLICK_RESOLUTION_TTL_MILLISECONDS;
+    QList<QUrl> mClickUrls;
+    QHash<QByteArray, ResolvedClick> mResolvedClicks;
+
+    QString mAdUnitId;
+    QUrl mClickThroughUrl;
+    QString mAdOrientation;
+    int mRefreshTimeMilliseconds;
+    QUrl mRedirectUrl;
+    bool mAutoRefreshEnabled;
+    bool mRefreshSuspended;
+    int mFetchTimeoutMilliseconds;
+    bool mInterceptslinks;
+};
+
+#endif /* MOPUBADMANAGER_HPP_ */
@@ -0,0 +1,113 @@
+#include "MoPubAdPlacementManager.hpp"
+
+#include <QDateTime>
+#include <QMetaObject>
+
+#include "MoPubLogging.hpp"
+
+const int MoPubAdPlacementManager::DEFAULT_MAXIMUM_CONCURRENT_FETCHES = 2;
+
+MoPubAdPlacementManager* MoPubAdPlacementManager::instance(){
+    static MoPubAdPlacementManager manager;
+    return &manager;
+}
+
+MoPubAdPlacementManager::MoPubAdPlacementManager()
+: QObject(0)
+, mMaximumConcurrentFetches(DEFAULT_MAXIMUM_CONCURRENT_FETCHES)
+, mNextTicket(1)
+{
+}
+
+QNetworkRequest::Priority MoPubAdPlacementManager::networkPriority(Priority priority){
+    switch (priority) {
+    case VisibleBanner:     return QNetworkRequest::HighPriority;
+    case OffscreenPrefetch: return QNetworkRequest::NormalPriority;
+    default:                return QNetworkRequest::LowPriority;
+    }
+}
+
+void MoPubAdPlacementManager::registerPlacement(QObject* placement){
+    mStats.insert(placement, PlacementStats());
+}
+
+void MoPubAdPlacementManager::unregisterPlacement(QObject* placement){
+    mStats.remove(placement);
+    for (int i = 0; i < PRIORITY_COUNT; ++i) {
+        QList<Ticket>::iterator it = mQueues[i].begin();
+        while (it != mQueues[i].end()) {
+            if (it->placement == placement || it->placement.isNull()) it = mQueues[i].erase(it);
+            else ++it;
+        }
+    }
+    // A placement going away never reports its in-flight fetch back.
+    QHash<int, QObject*>::iterator it = mInFlight.begin();
+    while (it != mInFlight.end()) {
+        if (it.value() == placement) it = mInFlight.erase(it);
+        else ++it;
+    }
+    dispatch();
+}
+
+int MoPubAdPlacementManager::requestFetch(QObject* placement, Priority priority){
+    Ticket ticket;
+    ticket.id = mNextTicket++;
+    if (mNextTicket <= 0) mNextTicket = 1;
+    ticket.priority = priority;
+    ticket.placement = placement;
+    ticket.enqueuedAt = QDateTime::currentMSecsSinceEpoch();
+    mQueues[priority].append(ticket);
+    dispatch();
+    return ticket.id;
+}
+
+void MoPubAdPlacementManager::fetchFinished(int ticket){
+    if (mInFlight.remove(ticket) > 0) {
+        dispatch();
+        return;
+    }
+    // Not granted yet, drop it from the queues.
+    for (int i = 0; i < PRIORITY_COUNT; ++i) {
+        for (int j = 0; j < mQueues[i].size(); ++j) {
+            if (mQueues[i].at(j).id == ticket) {
+                mQueues[i].removeAt(j);
+                return;
+            }
+        }
+    }
+}
+
+void MoPubAdPlacementManager::setMaximumConcurrentFetches(int value){
+    mMaximumConcurrentFetches = qMax(1, value);
+    dispatch();
+}
+
+qint64 MoPubAdPlacementManager::lastQueueWaitMilliseconds(QObject* placement) const {
+    return mStats.value(placement).lastWaitMilliseconds;
+}
+
+qint64 MoPubAdPlacementManager::totalQueueWaitMilliseconds(QObject* placement) const {
+    return mStats.value(placement).totalWaitMilliseconds;
+}
+
+void MoPubAdPlacementManager::dispatch(){
+    for (int i = 0; i < PRIORITY_COUNT && mInFlight.size() < mMaximumConcurrentFetches; ++i) {
+        while (!mQueues[i].isEmpty() && mInFlight.size() < mMaximumConcurrentFetches) {
+            Ticket ticket = mQueues[i].takeFirst();
+            if (ticket.placement.isNull()) continue;
+
+            qint64 wait = QDateTime::currentMSecsSinceEpoch() - ticket.enqueuedAt;
+            if (mStats.contains(ticket.placement)) {
+                PlacementStats& stats = mStats[ticket.placement];
+                stats.lastWaitMilliseconds = wait;
+                stats.totalWaitMilliseconds += wait;
+            }
+            MPLogDebug("Fetch ticket %1 granted after %2 ms in queue %3", ticket.id, wait, i);
+
+            mInFlight.insert(ticket.id, ticket.placement);
+            // Queued, so a placement asking for a fetch is never called back re-entrantly.
+            QMetaObject::invokeMethod(ticket.placement, "onFetchGranted", Qt::QueuedConnection,
+                    Q_ARG(int, ticket.id), Q_ARG(int, networkPriority(ticket.priority)));
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef MOPUBADPLACEMENTMANAGER_HPP_
+#define MOPUBADPLACEMENTMANAGER_HPP_
+
+#include <QHash>
+#include <QList>
+#include <QNetworkRequest>
+#include <QObject>
+#include <QPointer>
+
+/*!
+ * @brief Coordinates the ad fetches of every placement in the app.
+ *
+ * Placements ask for a fetch slot with requestFetch() and get a ticket back. At most
+ * maximumConcurrentFetches() tickets are in flight at once; the rest wait in per-priority
+ * queues. A granted ticket is delivered to the placement by a queued call of its
+ * onFetchGranted(int ticket, int networkPriority) slot, and must be handed back with
+ * fetchFinished() once the fetch completed, failed or was abandoned.
+ */
+class MoPubAdPlacementManager: public QObject {
+    Q_OBJECT
+public:
+    // Lower values are served first.
+    enum Priority {
+        VisibleBanner = 0,
+        OffscreenPrefetch = 1,
+        InterstitialPreload = 2
+    };
+
+    static const int DEFAULT_MAXIMUM_CONCURRENT_FETCHES;
+
+    static MoPubAdPlacementManager* instance();
+
+    void registerPlacement(QObject* placement);
+    void unregisterPlacement(QObject* placement);
+
+    int requestFetch(QObject* placement, Priority priority);
+    void fetchFinished(int ticket);
+
+    int maximumConcurrentFetches() const { return mMaximumConcurrentFetches; }
+    void setMaximumConcurrentFetches(int value);
+
+    // Time the last granted fetch of the placement spent queued, and the total so far.
+    qint64 lastQueueWaitMilliseconds(QObject* placement) const;
+    qint64 totalQueueWaitMilliseconds(QObject* placement) const;
+
+    static QNetworkRequest::Priority networkPriority(Priority priority);
+
+private:
+    MoPubAdPlacementManager();
+
+    void dispatch();
+
+    static const int PRIORITY_COUNT = 3;
+
+    struct Ticket {
+        int id;
+        Priority priority;
+        QPointer<QObject> placement;
+        qint64 enqueuedAt;
+    };
+
+    struct PlacementStats {
+        PlacementStats() : lastWaitMilliseconds(0), totalWaitMilliseconds(0) {}
+        qint64 lastWaitMilliseconds;
+        qint64 totalWaitMilliseconds;
+    };
+
+    QList<Ticket> mQueues[PRIORITY_COUNT];
+    QHash<int, QObject*> mInFlight;
+    QHash<QObject*, PlacementStats> mStats;
+    int mMaximumConcurrentFetches;
+    int mNextTicket;
+};
+
+#endif /* MOPUBADPLACEMENTMANAGER_HPP_ */
@@ -0,0 +1,144 @@
+#include "MoPubAdResponse.hpp"
+
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QRegExp>
+
+#include "MoPubAdEnvelope.hpp"
+#include "MoPubLogging.hpp"
+
+namespace {
+    const int MAXIMUM_CLICK_URLS = 3;
+    // Trackers and failover URLs change with every request without changing the creative.
+    const char* const RENDERING_HEADERS[] = { "X-Adtype", "X-Width", "X-Height", "X-Scrollable", "X-Orientation" };
+    const int RENDERING_HEADER_COUNT = sizeof(RENDERING_HEADERS) / sizeof(RENDERING_HEADERS[0]);
+
+    QList<QUrl> findClickUrls(const QString& html) {
+        QList<QUrl> urls;
+        QRegExp anchor("<a\\s[^>]*href\\s*=\\s*[\"']([^\"']+)[\"']", Qt::CaseInsensitive);
+        int pos = 0;
+        while (urls.size() < MAXIMUM_CLICK_URLS && (pos = anchor.indexIn(html, pos)) != -1) {
+            pos += anchor.matchedLength();
+            QUrl url(anchor.cap(1));
+            QString scheme = url.scheme().toLower();
+            if ((scheme == "http" || scheme == "https") && !urls.contains(url)) urls.append(url);
+        }
+        return urls;
+    }
+
+    QByteArray headerValue(const QList<QNetworkReply::RawHeaderPair>& headers, const char* name, bool* found = 0) {
+        for (int i = 0; i < headers.size(); ++i) {
+            if (qstricmp(headers.at(i).first.constData(), name) == 0) {
+                if (found) *found = true;
+                return headers.at(i).second;
+            }
+        }
+        if (found) *found = false;
+        return QByteArray();
+    }
+}
+
+MoPubAdResponse MoPubAdResponse::fromReply(QNetworkReply* reply){
+    Q_CHECK_PTR(reply);
+    MoPubAdResponse response;
+    response.url = reply->request().url();
+
+    // Client and Server HTTP errors should result in an exponential back off
+    QVariant statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+    if (!statusCode.isNull() && statusCode.toInt() >= 400){
+        response.status = ServerErrorBackoff;
+        response.reasonPhrase = reply->attribute(QNetworkRequest::HttpReasonPhraseAttribute).toString();
+        return response;
+    }else if (!statusCode.isNull() && statusCode.toInt() != 200){
+        response.status = ServerErrorNoBackoff;
+        response.reasonPhrase = reply->attribute(QNetworkRequest::HttpReasonPhraseAttribute).toString();
+        return response;
+    }
+
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+    response.headers = reply->rawHeaderPairs();
+    const QByteArray data = reply->readAll();
+    QByteArray body = data;
+    MoPubAdEnvelope envelope;
+    const bool enveloped = MoPubAdEnvelope::isEnvelope(response.headers);
+    if (enveloped) {
+        if (!envelope.decode(data)) {
+            response.status = ServerErrorNoBackoff;
+            response.reasonPhrase = "Malformed ad envelope";
+            return response;
+        }
+        // The metadata outlives the envelope, copy it ahead of the HTTP headers, the creative is decoded below.
+        QList<QNetworkReply::RawHeaderPair> headers;
+        for (int i = 0; i < envelope.headers.size(); ++i) {
+            headers.append(qMakePair(QByteArray(envelope.headers.at(i).first.constData(), envelope.headers.at(i).first.size()),
+                    QByteArray(envelope.headers.at(i).second.constData(), envelope.headers.at(i).second.size())));
+        }
+        response.headers = headers + response.headers;
+        body = envelope.body;
+    }
+
+    bool found = false;
+    const QByteArray adTypeHeader = headerValue(response.headers, "X-Adtype", &found);
+    if (found) {
+        response.adTypeName = QString(adTypeHeader);
+        QString adType = response.adTypeName.toLower();
+
+        if (adType == "clear"){
+            response.adType = ClearAd;
+            return response;
+        } else if (adType == "custom"){
+            response.adType = CustomAd;
+            response.customSelector = QString(headerValue(response.headers, "X-Customselector", &response.hasCustomSelector));
+            return response;
+        } else if (adType == "mraid"){
+            response.adType = MraidAd;
+            response.nativeParams.insert("X-Adtype", response.adTypeName);
+            response.nativeParams.insert("X-Nativeparams", QString(body));
+            return response;
+        } else if (adType != "html"){
+            response.adType = NativeAd;
+            response.nativeParams.insert("X-Adtype", response.adTypeName);
+            // Shares the header's bytes, nothing is decoded until the params are read.
+            response.nativeParamsJson = headerValue(response.headers, "X-Nativeparams");
+            if (response.nativeParamsJson.isEmpty()) response.nativeParamsJson = "{}";
+            QString ftHeader(headerValue(response.headers, "X-Fulladtype"));
+            if (!ftHeader.isEmpty()) {
+                response.nativeParams.insert("X-Fulladtype", ftHeader);
+            }
+            return response;
+        }
+    }
+
+    // Handle HTML ad.
+    response.adType = HtmlAd;
+    response.html = QString(body);
+
+    //Remove webview's incorrectly handling of meta viewport device-size element.
+    QRegExp viewport("<meta name=\"viewport\".*>");
+    viewport.setMinimal(true);
+    response.html.remove(viewport);
+
+    response.clickUrls = findClickUrls(response.html);
+    response.creativeKind = MoPubCreativeClassifier::classify(response.html);
+    response.contentHash = hashContent(response.html.toUtf8(), response.headers);
+    MPLogDebug("Parsed %1 response of %2 bytes in %3 us", enveloped ? "enveloped" : "header format",
+            data.size(), parseTimer.nsecsElapsed() / 1000);
+    return response;
+}
+
+QByteArray MoPubAdResponse::hashContent(const QByteArray& html, const QList<QNetworkReply::RawHeaderPair>& headers){
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (int h = 0; h < RENDERING_HEADER_COUNT; ++h) {
+        hash.addData(RENDERING_HEADERS[h]);
+        for (int i = 0; i < headers.size(); ++i) {
+            if (qstricmp(headers.at(i).first.constData(), RENDERING_HEADERS[h]) == 0) {
+                hash.addData(headers.at(i).second);
+                break;
+            }
+        }
+        hash.addData("\n", 1);
+    }
+    hash.addData(html);
+    return hash.result();
+}
@@ -0,0 +1,62 @@
+#ifndef MOPUBADRESPONSE_HPP_
+#define MOPUBADRESPONSE_HPP_
+
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+#include <QNetworkReply>
+#include <QString>
+#include <QUrl>
+
+#include "MoPubCreativeClassifier.hpp"
+
+/*!
+ * @brief Fully parsed ad server response.
+ *
+ * Built on the network thread from a finished reply, so the UI thread only has to
+ * apply the headers and hand the sanitized html to the WebView.
+ */
+struct MoPubAdResponse {
+    enum Status {
+        Success,
+        ServerErrorBackoff,     // 4xx and 5xx, stretch the refresh interval
+        ServerErrorNoBackoff    // any other status but 200
+    };
+
+    enum AdType {
+        HtmlAd,
+        ClearAd,
+        CustomAd,
+        MraidAd,
+        NativeAd
+    };
+
+    MoPubAdResponse() : requestId(0), status(Success), adType(HtmlAd), hasCustomSelector(false), creativeKind(MoPubCreativeClassifier::Dynamic) {}
+
+    static MoPubAdResponse fromReply(QNetworkReply* reply);
+    // Identifies what a creative looks like on screen: the html and the headers that shape its rendering.
+    static QByteArray hashContent(const QByteArray& html, const QList<QNetworkReply::RawHeaderPair>& headers);
+
+    int requestId;
+    Status status;
+    QString reasonPhrase;
+    QUrl url;
+    QList<QNetworkReply::RawHeaderPair> headers;
+    AdType adType;
+    QString adTypeName;
+    bool hasCustomSelector;
+    QString customSelector;
+    QHash<QString, QString> nativeParams;
+    // X-Nativeparams of a native ad as it came, read with MoPubJsonReader.
+    QByteArray nativeParamsJson;
+    QString html;
+    // Absolute http(s) links found in the html, candidates for click pre-resolution.
+    QList<QUrl> clickUrls;
+    QByteArray contentHash;
+    // Whether the html needs scripts to render, decides how it is rendered.
+    MoPubCreativeClassifier::Kind creativeKind;
+};
+
+Q_DECLARE_METATYPE(MoPubAdResponse)
+
+#endif /* MOPUBADRESPONSE_HPP_ */
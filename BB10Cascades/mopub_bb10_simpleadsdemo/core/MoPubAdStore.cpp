@@ -0,0 +1,193 @@
+#include "MoPubAdStore.hpp"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "MoPubLogging.hpp"
+
+const int MoPubAdStore::MAXIMUM_ENTRIES = 3;
+const qint64 MoPubAdStore::DEFAULT_EXPIRY_MILLISECONDS = 6 * 60 * 60 * 1000;
+
+namespace {
+    const quint32 STORE_MAGIC = 0x4d504153; // "MPAS"
+    const quint16 STORE_VERSION = 1;
+
+    struct StoreEntry {
+        qint64 savedAt;
+        qint64 expiresAt;
+        QByteArray baseUrl;
+        QList<QNetworkReply::RawHeaderPair> headers;
+        // Compressed html, pointing into the mapped file.
+        const char* html;
+        quint32 htmlLength;
+    };
+
+    bool parseEntries(const QByteArray& raw, QList<StoreEntry>* entries) {
+        QDataStream in(raw);
+        in.setVersion(QDataStream::Qt_4_8);
+
+        quint32 magic = 0;
+        quint16 version = 0;
+        quint16 count = 0;
+        in >> magic >> version >> count;
+        if (in.status() != QDataStream::Ok || magic != STORE_MAGIC || version != STORE_VERSION) return false;
+
+        for (quint16 i = 0; i < count; ++i) {
+            StoreEntry entry;
+            quint16 headerCount = 0;
+            in >> entry.savedAt >> entry.expiresAt >> entry.baseUrl >> headerCount;
+            for (quint16 h = 0; h < headerCount; ++h) {
+                QByteArray name, value;
+                in >> name >> value;
+                entry.headers.append(qMakePair(name, value));
+            }
+            in >> entry.htmlLength;
+            if (in.status() != QDataStream::Ok) return false;
+
+            qint64 offset = in.device()->pos();
+            if (offset + entry.htmlLength > raw.size()) return false;
+            entry.html = raw.constData() + offset;
+            in.skipRawData(entry.htmlLength);
+            entries->append(entry);
+        }
+        return true;
+    }
+
+    void writeEntry(QDataStream& out, qint64 savedAt, qint64 expiresAt, const QByteArray& baseUrl,
+            const QList<QNetworkReply::RawHeaderPair>& headers, const char* html, quint32 htmlLength) {
+        out << savedAt << expiresAt << baseUrl << quint16(headers.size());
+        for (int i = 0; i < headers.size(); ++i) {
+            out << headers.at(i).first << headers.at(i).second;
+        }
+        out << htmlLength;
+        out.writeRawData(html, htmlLength);
+    }
+}
+
+MoPubAdStore* MoPubAdStore::instance(){
+    static MoPubAdStore store;
+    return &store;
+}
+
+MoPubAdStore::MoPubAdStore()
+: mDirectory(QDir::homePath() + "/mopub/adstore")
+{
+    if (!mDirectory.exists()) {
+        mDirectory.mkpath(".");
+    }
+}
+
+QString MoPubAdStore::pathForAdUnit(const QString& adUnitId) const {
+    return mDirectory.filePath(QString(QUrl::toPercentEncoding(adUnitId)) + ".ads");
+}
+
+MoPubStoredAd MoPubAdStore::latest(const QString& adUnitId) const {
+    MoPubStoredAd ad;
+    if (adUnitId.isEmpty()) return ad;
+
+    QFile file(pathForAdUnit(adUnitId));
+    if (!file.open(QIODevice::ReadOnly) || file.size() <= 0) return ad;
+    uchar* map = file.map(0, file.size());
+    if (!map) return ad;
+
+    QList<StoreEntry> entries;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (parseEntries(QByteArray::fromRawData(reinterpret_cast<const char*>(map), int(file.size())), &entries)) {
+        foreach (const StoreEntry& entry, entries) {
+            if (entry.expiresAt > 0 && now >= entry.expiresAt) continue;
+            // Only the entry handed out is ever decompressed, straight out of the mapping.
+            ad.html = qUncompress(reinterpret_cast<const uchar*>(entry.html), entry.htmlLength);
+            if (ad.html.isEmpty()) continue;
+            ad.baseUrl = QUrl::fromEncoded(entry.baseUrl);
+            ad.headers = entry.headers;
+            ad.savedAt = entry.savedAt;
+            ad.expiresAt = entry.expiresAt;
+            break;
+        }
+    }
+    file.unmap(map);
+    return ad;
+}
+
+void MoPubAdStore::save(const QString& adUnitId, const MoPubStoredAd& ad){
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (adUnitId.isEmpty() || !ad.isValid() || ad.isExpired(now)) return;
+
+    const QString path = pathForAdUnit(adUnitId);
+    const QByteArray compressed = qCompress(ad.html);
+
+    QByteArray buffer;
+    QDataStream out(&buffer, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_8);
+
+    // Keep the still valid previous entries, without decompressing them, behind the new one.
+    QFile previous(path);
+    uchar* map = 0;
+    QList<StoreEntry> kept;
+    if (previous.open(QIODevice::ReadOnly) && previous.size() > 0) {
+        map = previous.map(0, previous.size());
+        if (map) {
+            QList<StoreEntry> entries;
+            parseEntries(QByteArray::fromRawData(reinterpret_cast<const char*>(map), int(previous.size())), &entries);
+            foreach (const StoreEntry& entry, entries) {
+                if (kept.size() >= MAXIMUM_ENTRIES - 1) break;
+                if (entry.expiresAt > 0 && now >= entry.expiresAt) continue;
+                // The same creative served again replaces its older copy.
+                if (entry.htmlLength == quint32(compressed.size())
+                        && memcmp(entry.html, compressed.constData(), entry.htmlLength) == 0) continue;
+                kept.append(entry);
+            }
+        }
+    }
+
+    out << STORE_MAGIC << STORE_VERSION << quint16(kept.size() + 1);
+    writeEntry(out, ad.savedAt, ad.expiresAt, ad.baseUrl.toEncoded(), ad.headers,
+            compressed.constData(), compressed.size());
+    foreach (const StoreEntry& entry, kept) {
+        writeEntry(out, entry.savedAt, entry.expiresAt, entry.baseUrl, entry.headers, entry.html, entry.htmlLength);
+    }
+
+    if (map) previous.unmap(map);
+    previous.close();
+
+    // Write to the side and swap so a crash never leaves a truncated store behind.
+    const QString tempPath = path + ".tmp";
+    QFile file(tempPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        MPLogWarn("Can't write the ad store for %1", adUnitId);
+        return;
+    }
+    const bool written = file.write(buffer) == buffer.size() && file.flush();
+    file.close();
+    if (!written) {
+        MPLogWarn("Can't write the ad store for %1", adUnitId);
+        QFile::remove(tempPath);
+        return;
+    }
+    // rename() replaces the old store in one step, QFile::rename() refuses to overwrite.
+    if (::rename(QFile::encodeName(tempPath).constData(), QFile::encodeName(path).constData()) != 0) {
+        MPLogWarn("Can't replace the ad store for %1", adUnitId);
+        QFile::remove(tempPath);
+    }
+}
+
+qint64 MoPubAdStore::expiryFromHeaders(const QList<QNetworkReply::RawHeaderPair>& headers, qint64 now){
+    for (int i = 0; i < headers.size(); ++i) {
+        if (qstricmp(headers.at(i).first.constData(), "Cache-Control") != 0) continue;
+        const QByteArray value = headers.at(i).second.toLower();
+        if (value.contains("no-store")) return now;
+        int index = value.indexOf("max-age=");
+        if (index >= 0) {
+            int end = index + 8;
+            while (end < value.size() && value.at(end) >= '0' && value.at(end) <= '9') ++end;
+            bool ok = false;
+            qint64 seconds = value.mid(index + 8, end - index - 8).toLongLong(&ok);
+            if (ok) return now + seconds * 1000;
+        }
+    }
+    return now + DEFAULT_EXPIRY_MILLISECONDS;
+}
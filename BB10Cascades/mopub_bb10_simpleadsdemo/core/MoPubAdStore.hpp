@@ -0,0 +1,61 @@
+#ifndef MOPUBADSTORE_HPP_
+#define MOPUBADSTORE_HPP_
+
+#include <QByteArray>
+#include <QDir>
+#include <QList>
+#include <QMetaType>
+#include <QString>
+#include <QUrl>
+#include <QNetworkReply>
+
+/*!
+ * @brief A successfully rendered creative together with the response headers it was served with.
+ */
+struct MoPubStoredAd {
+    MoPubStoredAd() : savedAt(0), expiresAt(0) {}
+
+    bool isValid() const { return !html.isEmpty(); }
+    bool isExpired(qint64 now) const { return expiresAt > 0 && now >= expiresAt; }
+
+    QUrl baseUrl;
+    QByteArray html;
+    QList<QNetworkReply::RawHeaderPair> headers;
+    qint64 savedAt;
+    qint64 expiresAt;
+};
+
+/*!
+ * @brief Persistent per-ad-unit store of the last good creatives.
+ *
+ * Each ad unit gets one file holding up to MAXIMUM_ENTRIES creatives, newest first, with
+ * the html compressed. Files are memory-mapped on read and only the entry that is handed
+ * out gets decompressed, so restoring the last ad at startup or while offline is cheap.
+ * It is file I/O all the same, only MoPubAdFetcher uses it, on MoPubNetworkThread.
+ */
+class MoPubAdStore {
+public:
+    static const int MAXIMUM_ENTRIES;
+    static const qint64 DEFAULT_EXPIRY_MILLISECONDS;
+
+    static MoPubAdStore* instance();
+
+    // Newest creative for the ad unit that has not expired yet, or an invalid one.
+    MoPubStoredAd latest(const QString& adUnitId) const;
+    void save(const QString& adUnitId, const MoPubStoredAd& ad);
+
+    // Expiry time for a creative served with the given headers, honouring Cache-Control max-age.
+    static qint64 expiryFromHeaders(const QList<QNetworkReply::RawHeaderPair>& headers, qint64 now);
+
+private:
+    MoPubAdStore();
+    Q_DISABLE_COPY(MoPubAdStore)
+
+    QString pathForAdUnit(const QString& adUnitId) const;
+
+    QDir mDirectory;
+};
+
+Q_DECLARE_METATYPE(MoPubStoredAd)
+
+#endif /* MOPUBADSTORE_HPP_ */
@@ -0,0 +1,91 @@
+#include "MoPubAdUnitMetadata.hpp"
+
+#include <QDir>
+#include <QSettings>
+#include <QUrl>
+
+#include "MoPubLogging.hpp"
+
+namespace {
+    QByteArray headerValue(const QList<QNetworkReply::RawHeaderPair>& headers, const char* name, bool* found) {
+        for (int i = 0; i < headers.size(); ++i) {
+            if (qstricmp(headers.at(i).first.constData(), name) == 0) {
+                *found = true;
+                return headers.at(i).second;
+            }
+        }
+        *found = false;
+        return QByteArray();
+    }
+
+    QString groupFor(const QString& adUnitId) {
+        return QString(QUrl::toPercentEncoding(adUnitId));
+    }
+}
+
+MoPubAdUnitMetadata MoPubAdUnitMetadata::fromHeaders(const QList<QNetworkReply::RawHeaderPair>& headers){
+    MoPubAdUnitMetadata metadata;
+    bool found = false;
+
+    metadata.scrollable = headerValue(headers, "X-Scrollable", &found) == "1";
+
+    QByteArray width = headerValue(headers, "X-Width", &found);
+    bool hasWidth = found;
+    QByteArray height = headerValue(headers, "X-Height", &found);
+    if (hasWidth && found) {
+        metadata.width = width.toInt();
+        metadata.height = height.toInt();
+    }
+
+    QByteArray refresh = headerValue(headers, "X-Refreshtime", &found);
+    if (found) metadata.refreshTimeMilliseconds = refresh.toInt() * 1000;
+
+    metadata.orientation = QString(headerValue(headers, "X-Orientation", &found));
+    return metadata;
+}
+
+MoPubAdUnitMetadataCache* MoPubAdUnitMetadataCache::instance(){
+    static MoPubAdUnitMetadataCache cache;
+    return &cache;
+}
+
+MoPubAdUnitMetadataCache::MoPubAdUnitMetadataCache()
+: mSettingsPath(QDir::homePath() + "/mopub/adunits.ini")
+{
+}
+
+bool MoPubAdUnitMetadataCache::lookup(const QString& adUnitId, MoPubAdUnitMetadata* metadata) const {
+    if (adUnitId.isEmpty()) return false;
+    QHash<QString, MoPubAdUnitMetadata>::const_iterator entry = mEntries.constFind(adUnitId);
+    if (entry != mEntries.constEnd()) {
+        *metadata = entry.value();
+        return true;
+    }
+
+    QSettings settings(mSettingsPath, QSettings::IniFormat);
+    settings.beginGroup(groupFor(adUnitId));
+    if (!settings.contains("width")) return false;
+    metadata->width = settings.value("width").toInt();
+    metadata->height = settings.value("height").toInt();
+    metadata->refreshTimeMilliseconds = settings.value("refreshTimeMilliseconds").toInt();
+    metadata->scrollable = settings.value("scrollable").toBool();
+    metadata->orientation = settings.value("orientation").toString();
+    mEntries.insert(adUnitId, *metadata);
+    return true;
+}
+
+void MoPubAdUnitMetadataCache::save(const QString& adUnitId, const MoPubAdUnitMetadata& metadata){
+    if (adUnitId.isEmpty()) return;
+    MoPubAdUnitMetadata previous;
+    if (lookup(adUnitId, &previous) && previous == metadata) return;
+
+    MPLogDebug("Ad unit %1 metadata changed to %2x%3", adUnitId, metadata.width, metadata.height);
+    mEntries.insert(adUnitId, metadata);
+    QSettings settings(mSettingsPath, QSettings::IniFormat);
+    settings.beginGroup(groupFor(adUnitId));
+    settings.setValue("width", metadata.width);
+    settings.setValue("height", metadata.height);
+    settings.setValue("refreshTimeMilliseconds", metadata.refreshTimeMilliseconds);
+    settings.setValue("scrollable", metadata.scrollable);
+    settings.setValue("orientation", metadata.orientation);
+}
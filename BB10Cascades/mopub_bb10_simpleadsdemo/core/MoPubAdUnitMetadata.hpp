@@ -0,0 +1,54 @@
+#ifndef MOPUBADUNITMETADATA_HPP_
+#define MOPUBADUNITMETADATA_HPP_
+
+#include <QHash>
+#include <QList>
+#include <QNetworkReply>
+#include <QString>
+
+/*!
+ * @brief The response headers that shape an ad unit's slot: size, scrolling, refresh and orientation.
+ */
+struct MoPubAdUnitMetadata {
+    MoPubAdUnitMetadata() : width(0), height(0), refreshTimeMilliseconds(0), scrollable(false) {}
+
+    static MoPubAdUnitMetadata fromHeaders(const QList<QNetworkReply::RawHeaderPair>& headers);
+
+    bool operator==(const MoPubAdUnitMetadata& other) const {
+        return width == other.width && height == other.height
+                && refreshTimeMilliseconds == other.refreshTimeMilliseconds
+                && scrollable == other.scrollable && orientation == other.orientation;
+    }
+    bool operator!=(const MoPubAdUnitMetadata& other) const { return !(*this == other); }
+
+    // 0 when the server did not say.
+    int width;
+    int height;
+    int refreshTimeMilliseconds;
+    bool scrollable;
+    QString orientation;
+};
+
+/*!
+ * @brief Last seen metadata of each ad unit, kept across launches.
+ *
+ * Lets a view size its slot and pick its scroll mode as soon as its ad unit is known,
+ * before the first response arrives. Entries are cached in memory and the settings
+ * file is only rewritten when an ad unit's metadata actually changed.
+ */
+class MoPubAdUnitMetadataCache {
+public:
+    static MoPubAdUnitMetadataCache* instance();
+
+    bool lookup(const QString& adUnitId, MoPubAdUnitMetadata* metadata) const;
+    void save(const QString& adUnitId, const MoPubAdUnitMetadata& metadata);
+
+private:
+    MoPubAdUnitMetadataCache();
+    Q_DISABLE_COPY(MoPubAdUnitMetadataCache)
+
+    QString mSettingsPath;
+    mutable QHash<QString, MoPubAdUnitMetadata> mEntries;
+};
+
+#endif /* MOPUBADUNITMETADATA_HPP_ */
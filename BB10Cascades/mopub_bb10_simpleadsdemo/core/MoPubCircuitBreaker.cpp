@@ -0,0 +1,147 @@
+#include "MoPubCircuitBreaker.hpp"
+
+#include <QDateTime>
+
+#include "MoPubLogging.hpp"
+#include "MoPubTrace.hpp"
+
+const int MoPubCircuitBreaker::WINDOW_SIZE = 10;
+const int MoPubCircuitBreaker::MINIMUM_SAMPLES = 4;
+const int MoPubCircuitBreaker::ERROR_PERCENT_THRESHOLD = 50;
+const int MoPubCircuitBreaker::FAILURE_PERCENT_THRESHOLD = 80;
+const int MoPubCircuitBreaker::MINIMUM_COOLDOWN_MILLISECONDS = 30 * 1000;
+const int MoPubCircuitBreaker::MAXIMUM_COOLDOWN_MILLISECONDS = 15 * 60 * 1000;
+const int MoPubCircuitBreaker::PROBE_TIMEOUT_MILLISECONDS = 30 * 1000;
+
+namespace {
+    const char* const STATE_NAMES[] = { "closed", "open", "halfopen" };
+}
+
+MoPubCircuitBreaker* MoPubCircuitBreaker::instance(){
+    static MoPubCircuitBreaker breaker;
+    return &breaker;
+}
+
+MoPubCircuitBreaker::MoPubCircuitBreaker()
+: QObject(0)
+, mLastProbe(0)
+{
+}
+
+const char* MoPubCircuitBreaker::stateName(State state){
+    return STATE_NAMES[state];
+}
+
+bool MoPubCircuitBreaker::allowRequest(const QString& adUnitId, int* probe){
+    if (probe) *probe = 0;
+    QHash<QString, Breaker>::iterator it = mBreakers.find(adUnitId);
+    if (it == mBreakers.end() || it->state == Closed) return true;
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (it->state == Open && now - it->openedAt >= it->cooldownMilliseconds) {
+        setState(adUnitId, *it, HalfOpen);
+    }
+    // One probe at a time, a probe that never reported back (cancelled, network error) is replaced.
+    if (it->state == HalfOpen && (it->probeSentAt == 0 || now - it->probeSentAt >= PROBE_TIMEOUT_MILLISECONDS)) {
+        it->probeSentAt = now;
+        if (++mLastProbe <= 0) mLastProbe = 1;
+        it->probe = mLastProbe;
+        if (probe) *probe = it->probe;
+        MPLogInfo("Circuit breaker of %1 half-open, probing", adUnitId);
+        return true;
+    }
+    ++it->refusedCount;
+    return false;
+}
+
+void MoPubCircuitBreaker::record(const QString& adUnitId, Outcome outcome, int probe){
+    Breaker& breaker = mBreakers[adUnitId];
+    switch (breaker.state) {
+    case HalfOpen:
+        // Replies to requests sent before the breaker opened, of other placements or of failover hops.
+        if (probe == 0 || probe != breaker.probe) return;
+        breaker.probeSentAt = 0;
+        breaker.probe = 0;
+        if (outcome == Served) {
+            breaker.window.clear();
+            breaker.cooldownMilliseconds = 0;
+            setState(adUnitId, breaker, Closed);
+        } else {
+            open(adUnitId, breaker, qMin(breaker.cooldownMilliseconds * 2, MAXIMUM_COOLDOWN_MILLISECONDS));
+        }
+        return;
+    case Open:
+        // A reply of a request that went out before the breaker opened.
+        return;
+    case Closed:
+        break;
+    }
+
+    breaker.window.append(outcome);
+    if (breaker.window.size() > WINDOW_SIZE) breaker.window.removeFirst();
+    if (breaker.window.size() < MINIMUM_SAMPLES) return;
+
+    int errors = 0;
+    int failures = 0;
+    foreach (Outcome past, breaker.window) {
+        if (past == ServerError) ++errors;
+        if (past != Served) ++failures;
+    }
+    const int samples = breaker.window.size();
+    if (errors * 100 >= samples * ERROR_PERCENT_THRESHOLD || failures * 100 >= samples * FAILURE_PERCENT_THRESHOLD) {
+        MPLogWarn("Circuit breaker of %1 tripped: %2 errors and %3 no-fills in the last %4 responses",
+                adUnitId, errors, failures - errors, samples);
+        open(adUnitId, breaker, MINIMUM_COOLDOWN_MILLISECONDS);
+    }
+}
+
+void MoPubCircuitBreaker::open(const QString& adUnitId, Breaker& breaker, int cooldownMilliseconds){
+    breaker.cooldownMilliseconds = cooldownMilliseconds;
+    breaker.openedAt = QDateTime::currentMSecsSinceEpoch();
+    breaker.probeSentAt = 0;
+    breaker.probe = 0;
+    setState(adUnitId, breaker, Open);
+}
+
+void MoPubCircuitBreaker::setState(const QString& adUnitId, Breaker& breaker, State state){
+    if (state == breaker.state) return;
+    MPLogInfo("Circuit breaker of %1: %2 -> %3%4", adUnitId, STATE_NAMES[breaker.state], STATE_NAMES[state],
+            state == Open ? QString(" for %1 ms").arg(breaker.cooldownMilliseconds) : QString());
+    if (MoPubTrace::isEnabled()) MoPubTrace::instance()->instant(STATE_NAMES[state], this, adUnitId, "breaker");
+    breaker.state = state;
+    ++breaker.transitionCount;
+    emit stateChanged(adUnitId, state);
+}
+
+MoPubCircuitBreaker::State MoPubCircuitBreaker::state(const QString& adUnitId) const {
+    QHash<QString, Breaker>::const_iterator it = mBreakers.constFind(adUnitId);
+    return it == mBreakers.constEnd() ? Closed : it->state;
+}
+
+int MoPubCircuitBreaker::retryAfterMilliseconds(const QString& adUnitId) const {
+    QHash<QString, Breaker>::const_iterator it = mBreakers.constFind(adUnitId);
+    if (it == mBreakers.constEnd() || it->state != Open) return 0;
+    return qMax(qint64(0), it->openedAt + it->cooldownMilliseconds - QDateTime::currentMSecsSinceEpoch());
+}
+
+QVariantMap MoPubCircuitBreaker::report() const {
+    QVariantMap report;
+    for (QHash<QString, Breaker>::const_iterator it = mBreakers.constBegin(); it != mBreakers.constEnd(); ++it) {
+        int errors = 0;
+        int noFills = 0;
+        foreach (Outcome past, it->window) {
+            if (past == ServerError) ++errors;
+            else if (past == NoFill) ++noFills;
+        }
+        QVariantMap unit;
+        unit.insert("state", QString(STATE_NAMES[it->state]));
+        unit.insert("responses", it->window.size());
+        unit.insert("errors", errors);
+        unit.insert("noFills", noFills);
+        unit.insert("refused", it->refusedCount);
+        unit.insert("transitions", it->transitionCount);
+        unit.insert("retryAfterMilliseconds", retryAfterMilliseconds(it.key()));
+        report.insert(it.key(), unit);
+    }
+    return report;
+}
@@ -0,0 +1,87 @@
+#ifndef MOPUBCIRCUITBREAKER_HPP_
+#define MOPUBCIRCUITBREAKER_HPP_
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QVariantMap>
+
+/*!
+ * @brief Stops every placement of an ad unit from asking for ads the server keeps failing or not filling.
+ *
+ * Closed: requests go out, the outcome of the last WINDOW_SIZE responses is kept. Once
+ * at least MINIMUM_SAMPLES are known and too many of them were server errors or no-fills
+ * the breaker opens. Open: requests are refused locally until the cooldown is over, then
+ * one probe is let through and the breaker is half-open. Half-open: only the reply to the
+ * probe counts, a served probe closes it, a failed one opens it again for twice as long.
+ * Shared by all placements of the app and only used from the UI thread.
+ */
+class MoPubCircuitBreaker: public QObject {
+    Q_OBJECT
+public:
+    enum State {
+        Closed,
+        Open,
+        HalfOpen
+    };
+
+    enum Outcome {
+        Served,
+        NoFill,
+        ServerError
+    };
+
+    static const int WINDOW_SIZE;
+    static const int MINIMUM_SAMPLES;
+    static const int ERROR_PERCENT_THRESHOLD;
+    static const int FAILURE_PERCENT_THRESHOLD;
+    static const int MINIMUM_COOLDOWN_MILLISECONDS;
+    static const int MAXIMUM_COOLDOWN_MILLISECONDS;
+    static const int PROBE_TIMEOUT_MILLISECONDS;
+
+    static MoPubCircuitBreaker* instance();
+    static const char* stateName(State state);
+
+    // False when the request must not go out. May turn an open breaker half-open, the caller then
+    // sends the probe and gets its token in probe, 0 for any other request.
+    bool allowRequest(const QString& adUnitId, int* probe = 0);
+    // With the token of the request the reply answers, only the probe's reply moves a half-open breaker.
+    void record(const QString& adUnitId, Outcome outcome, int probe = 0);
+
+    State state(const QString& adUnitId) const;
+    // Until an open breaker lets a probe through, 0 otherwise.
+    int retryAfterMilliseconds(const QString& adUnitId) const;
+    // Per ad unit: state, recent errors, no-fills and responses, refused requests and transitions.
+    QVariantMap report() const;
+
+Q_SIGNALS:
+    void stateChanged(const QString& adUnitId, int state);
+
+private:
+    MoPubCircuitBreaker();
+    Q_DISABLE_COPY(MoPubCircuitBreaker)
+
+    struct Breaker {
+        Breaker() : state(Closed), cooldownMilliseconds(0), openedAt(0), probeSentAt(0), probe(0),
+                refusedCount(0), transitionCount(0) {}
+        State state;
+        QList<Outcome> window;
+        int cooldownMilliseconds;
+        qint64 openedAt;
+        // 0 unless a half-open probe is out.
+        qint64 probeSentAt;
+        // Token of that probe.
+        int probe;
+        int refusedCount;
+        int transitionCount;
+    };
+
+    void setState(const QString& adUnitId, Breaker& breaker, State state);
+    void open(const QString& adUnitId, Breaker& breaker, int cooldownMilliseconds);
+
+    QHash<QString, Breaker> mBreakers;
+    int mLastProbe;
+};
+
+#endif /* MOPUBCIRCUITBREAKER_HPP_ */
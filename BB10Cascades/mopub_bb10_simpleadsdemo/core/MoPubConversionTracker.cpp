@@ -0,0 +1,108 @@
+#include "MoPubConversionTracker.hpp"
+
+#include <QDir>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSettings>
+#include <QTimer>
+
+#include "MoPubDataUsage.hpp"
+#include "MoPubLogging.hpp"
+#include "MoPubNetworkThread.hpp"
+#include "MoPubReplyOwnership.hpp"
+
+const int MoPubConversionTracker::START_DELAY_MILLISECONDS = 5000;
+const int MoPubConversionTracker::INITIAL_RETRY_MILLISECONDS = 30000;
+const int MoPubConversionTracker::MAXIMUM_RETRY_MILLISECONDS = 30 * 60 * 1000;
+
+MoPubConversionTracker* MoPubConversionTracker::instance(){
+    static MoPubConversionTracker* tracker = new MoPubConversionTracker();
+    return tracker;
+}
+
+MoPubConversionTracker::MoPubConversionTracker()
+: QObject(0)
+, mSettingsPath(QDir::homePath() + "/mopub/conversion.ini")
+, mTimer(new QTimer(this))
+, mInFlight(false)
+, mAttempts(0)
+, mRetryMilliseconds(INITIAL_RETRY_MILLISECONDS)
+{
+    mTimer->setSingleShot(true);
+    bool res = connect(mTimer, SIGNAL(timeout()), this, SLOT(send()));
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+    moveToThread(MoPubNetworkThread::instance());
+}
+
+void MoPubConversionTracker::reportInstall(const QString& installId, const QUrl& url, const QByteArray& userAgent){
+    QMetaObject::invokeMethod(this, "start", Qt::QueuedConnection,
+            Q_ARG(QString, installId), Q_ARG(QUrl, url), Q_ARG(QByteArray, userAgent));
+}
+
+bool MoPubConversionTracker::isReported(const QString& installId) const {
+    QSettings settings(mSettingsPath, QSettings::IniFormat);
+    return settings.value(installId + "/reported", false).toBool();
+}
+
+void MoPubConversionTracker::setReported(const QString& installId){
+    QSettings settings(mSettingsPath, QSettings::IniFormat);
+    settings.setValue(installId + "/reported", true);
+    settings.setValue(installId + "/attempts", mAttempts);
+    settings.sync();
+}
+
+void MoPubConversionTracker::start(const QString& installId, const QUrl& url, const QByteArray& userAgent){
+    // Already scheduled or in flight for this session.
+    if (mInFlight || mTimer->isActive()) return;
+    if (isReported(installId)) {
+        MPLogDebug("Conversion already tracked for %1", installId);
+        return;
+    }
+    mInstallId = installId;
+    mUrl = url;
+    mUserAgent = userAgent;
+    mRetryMilliseconds = INITIAL_RETRY_MILLISECONDS;
+    // Stay out of the way of the launch traffic.
+    mTimer->start(START_DELAY_MILLISECONDS);
+}
+
+void MoPubConversionTracker::send(){
+    ++mAttempts;
+    MPLogInfo("Conversion track attempt %1: %2", mAttempts, mUrl);
+
+    QNetworkRequest request = QNetworkRequest();
+    request.setUrl(mUrl);
+    request.setRawHeader("User-Agent", mUserAgent);
+    request.setPriority(QNetworkRequest::LowPriority);
+    QNetworkReply* reply = MoPubReplyOwnership::adopt(
+            MoPubNetworkThread::instance()->networkAccessManager()->get(request), this);
+    mInFlight = true;
+    bool res = connect(reply, SIGNAL(finished()), this, SLOT(onReply()));
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+}
+
+void MoPubConversionTracker::onReply(){
+    MoPubScopedReply reply(qobject_cast<QNetworkReply*>(sender()));
+    Q_CHECK_PTR(reply);
+    mInFlight = false;
+    MoPubDataUsage::instance()->recordReply(QString(), MoPubDataUsage::Conversion, reply.data());
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    // Same acknowledgement the other SDKs wait for: a 200 with a body.
+    if (reply->error() == QNetworkReply::NoError && status == 200 && reply->bytesAvailable() > 0) {
+        MPLogInfo("Conversion track successful after %1 attempts", mAttempts);
+        setReported(mInstallId);
+    } else {
+        MPLogWarn("Conversion track failed, status %1: %2", status, reply->errorString());
+        scheduleRetry();
+    }
+}
+
+void MoPubConversionTracker::scheduleRetry(){
+    MPLogDebug("Retrying conversion track in %1 ms", mRetryMilliseconds);
+    mTimer->start(mRetryMilliseconds);
+    mRetryMilliseconds = qMin(mRetryMilliseconds * 2, MAXIMUM_RETRY_MILLISECONDS);
+}
@@ -0,0 +1,53 @@
+#ifndef MOPUBCONVERSIONTRACKER_HPP_
+#define MOPUBCONVERSIONTRACKER_HPP_
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QUrl>
+
+class QTimer;
+
+/*!
+ * @brief Reports the app install to MoPub once, the counterpart of MPAdConversionTracker on iOS.
+ *
+ * Lives on MoPubNetworkThread. Whether the install was reported is kept in a settings
+ * file, so the /m/open request only goes out until the server has acknowledged it once.
+ * Failed attempts are retried with exponential backoff for as long as the app runs.
+ */
+class MoPubConversionTracker: public QObject {
+    Q_OBJECT
+public:
+    static const int START_DELAY_MILLISECONDS;
+    static const int INITIAL_RETRY_MILLISECONDS;
+    static const int MAXIMUM_RETRY_MILLISECONDS;
+
+    static MoPubConversionTracker* instance();
+
+    // Safe to call from any thread, does nothing once the install has been reported.
+    void reportInstall(const QString& installId, const QUrl& url, const QByteArray& userAgent);
+
+private Q_SLOTS:
+    void start(const QString& installId, const QUrl& url, const QByteArray& userAgent);
+    void send();
+    void onReply();
+
+private:
+    MoPubConversionTracker();
+    Q_DISABLE_COPY(MoPubConversionTracker)
+
+    bool isReported(const QString& installId) const;
+    void setReported(const QString& installId);
+    void scheduleRetry();
+
+    QString mSettingsPath;
+    QTimer* mTimer;
+    QString mInstallId;
+    QUrl mUrl;
+    QByteArray mUserAgent;
+    bool mInFlight;
+    int mAttempts;
+    int mRetryMilliseconds;
+};
+
+#endif /* MOPUBCONVERSIONTRACKER_HPP_ */
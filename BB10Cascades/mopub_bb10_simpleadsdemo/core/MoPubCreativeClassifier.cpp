@@ -0,0 +1,69 @@
+#include "MoPubCreativeClassifier.hpp"
+
+#include <QAtomicInt>
+#include <QRegExp>
+#include <QStringList>
+
+namespace {
+    const char* const KIND_NAMES[] = { "dynamic", "static markup", "static image link" };
+    const int KIND_COUNT = sizeof(KIND_NAMES) / sizeof(KIND_NAMES[0]);
+
+    // Anything that can run code or navigate on its own.
+    const char* const DYNAMIC_PATTERN =
+            "<\\s*(script|iframe|frame|form|object|embed|applet)\\b"
+            "|javascript:"
+            "|\\son[a-z]+\\s*="
+            "|http-equiv\\s*=\\s*[\"']?refresh";
+
+    QAtomicInt sClassified[KIND_COUNT];
+    QAtomicInt sDisplayed[KIND_COUNT];
+    QAtomicInt sDisplayMilliseconds[KIND_COUNT];
+
+    int countMatches(const QString& html, const QRegExp& pattern) {
+        int count = 0;
+        int pos = 0;
+        while ((pos = pattern.indexIn(html, pos)) != -1) {
+            pos += pattern.matchedLength();
+            ++count;
+        }
+        return count;
+    }
+}
+
+MoPubCreativeClassifier::Kind MoPubCreativeClassifier::classify(const QString& html){
+    // QRegExp keeps match state, so every call gets its own.
+    Kind kind = Dynamic;
+    if (QRegExp(DYNAMIC_PATTERN, Qt::CaseInsensitive).indexIn(html) == -1) {
+        const int images = countMatches(html, QRegExp("<img\\b", Qt::CaseInsensitive));
+        const int anchors = countMatches(html, QRegExp("<a\\b", Qt::CaseInsensitive));
+        kind = (images == 1 && anchors <= 1) ? StaticImageLink : StaticMarkup;
+    }
+    sClassified[kind].fetchAndAddRelaxed(1);
+    return kind;
+}
+
+const char* MoPubCreativeClassifier::kindName(Kind kind){
+    return KIND_NAMES[kind];
+}
+
+void MoPubCreativeClassifier::recordDisplayTime(Kind kind, int milliseconds){
+    sDisplayed[kind].fetchAndAddRelaxed(1);
+    sDisplayMilliseconds[kind].fetchAndAddRelaxed(milliseconds);
+}
+
+QString MoPubCreativeClassifier::summary(){
+    int total = 0;
+    for (int i = 0; i < KIND_COUNT; ++i) total += sClassified[i];
+    if (total == 0) return QString("no creatives classified");
+
+    QStringList parts;
+    for (int i = 0; i < KIND_COUNT; ++i) {
+        const int displayed = sDisplayed[i];
+        parts << QString("%1 %2 (%3%), %4 ms to display")
+                .arg(KIND_NAMES[i])
+                .arg(int(sClassified[i]))
+                .arg(100 * sClassified[i] / total)
+                .arg(displayed > 0 ? sDisplayMilliseconds[i] / displayed : 0);
+    }
+    return parts.join("; ");
+}
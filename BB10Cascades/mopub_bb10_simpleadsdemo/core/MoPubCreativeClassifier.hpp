@@ -0,0 +1,32 @@
+#ifndef MOPUBCREATIVECLASSIFIER_HPP_
+#define MOPUBCREATIVECLASSIFIER_HPP_
+
+#include <QString>
+
+/*!
+ * @brief Tells creatives that need a scripting engine apart from those that are plain markup.
+ *
+ * Most banners are a linked image. They have no scripts, frames or forms, so they are
+ * rendered with JavaScript disabled and never pay for starting the engine. Counts per
+ * kind and the time each kind takes to display are kept for the whole process.
+ */
+class MoPubCreativeClassifier {
+public:
+    enum Kind {
+        Dynamic,            // scripts, frames, forms, plugins or inline handlers
+        StaticMarkup,       // plain html and css
+        StaticImageLink     // a single image, optionally behind a single link
+    };
+
+    // Thread safe, run on the network thread while parsing the response.
+    static Kind classify(const QString& html);
+    static bool needsScript(Kind kind) { return kind == Dynamic; }
+    static const char* kindName(Kind kind);
+
+    // From the creative being handed to the renderer until it finished loading.
+    static void recordDisplayTime(Kind kind, int milliseconds);
+    // One line with the share of each kind and its average time to display.
+    static QString summary();
+};
+
+#endif /* MOPUBCREATIVECLASSIFIER_HPP_ */
@@ -0,0 +1,222 @@
+#include "MoPubDataUsage.hpp"
+
+#include <QDir>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSettings>
+#include <QStringList>
+#include <QUrl>
+
+#include "MoPubLogging.hpp"
+
+const int MoPubDataUsage::FLUSH_INTERVAL_MILLISECONDS = 60000;
+
+namespace {
+    const char* const KIND_NAMES[] = { "adFetch", "tracking", "clickResolve", "conversion" };
+    const int KIND_COUNT = sizeof(KIND_NAMES) / sizeof(KIND_NAMES[0]);
+    const char* const DAY_GROUP = "_day";
+    const char* const DATA_SAVER_GROUP = "_dataSaver";
+    // Traffic that belongs to no ad unit, conversions.
+    const char* const APP_GROUP = "_app";
+    // Host, Connection, Accept-Encoding and Accept-Language, added by QNetworkAccessManager.
+    const int IMPLICIT_REQUEST_HEADER_BYTES = 120;
+    // "HTTP/1.1 200 OK\r\n" and the blank line ending the headers.
+    const int STATUS_LINE_BYTES = 19;
+
+    QString groupFor(const QString& adUnitId) {
+        if (adUnitId.isEmpty()) return QString(APP_GROUP);
+        return QString(QUrl::toPercentEncoding(adUnitId));
+    }
+
+    qint64 requestBytes(QNetworkReply* reply) {
+        const QNetworkRequest request = reply->request();
+        const char* method = reply->operation() == QNetworkAccessManager::HeadOperation ? "HEAD" : "GET";
+        // "GET /path?query HTTP/1.1\r\n"
+        qint64 bytes = qstrlen(method) + 1 + request.url().encodedPath().size() + request.url().encodedQuery().size() + 12;
+        foreach (const QByteArray& name, request.rawHeaderList()) {
+            bytes += name.size() + request.rawHeader(name).size() + 4;
+        }
+        return bytes + IMPLICIT_REQUEST_HEADER_BYTES + 2;
+    }
+
+    qint64 responseBytes(QNetworkReply* reply) {
+        qint64 bytes = STATUS_LINE_BYTES;
+        foreach (const QNetworkReply::RawHeaderPair& header, reply->rawHeaderPairs()) {
+            bytes += header.first.size() + header.second.size() + 4;
+        }
+        return bytes + reply->bytesAvailable();
+    }
+}
+
+MoPubDataUsage* MoPubDataUsage::instance(){
+    static MoPubDataUsage usage;
+    return &usage;
+}
+
+MoPubDataUsage::MoPubDataUsage()
+: mSettingsPath(QDir::homePath() + "/mopub/datausage.ini")
+, mBytesToday(0)
+, mDataSaverMode(DataSaverOff)
+, mDailyBudgetBytes(0)
+, mDirty(false)
+{
+    QSettings settings(mSettingsPath, QSettings::IniFormat);
+    foreach (const QString& group, settings.childGroups()) {
+        if (group == DAY_GROUP || group == DATA_SAVER_GROUP) continue;
+        settings.beginGroup(group);
+        const QString adUnitId = group == APP_GROUP ? QString() : QUrl::fromPercentEncoding(group.toLatin1());
+        for (int kind = 0; kind < KIND_COUNT; ++kind) {
+            if (!settings.contains(QString(KIND_NAMES[kind]) + "/sent")) continue;
+            Counters& counters = mCounters[Key(adUnitId, kind)];
+            counters.sent = settings.value(QString(KIND_NAMES[kind]) + "/sent").toLongLong();
+            counters.received = settings.value(QString(KIND_NAMES[kind]) + "/received").toLongLong();
+        }
+        settings.endGroup();
+    }
+    settings.beginGroup(DAY_GROUP);
+    mToday = settings.value("date").toDate();
+    mBytesToday = settings.value("bytes").toLongLong();
+    settings.endGroup();
+    settings.beginGroup(DATA_SAVER_GROUP);
+    const int mode = settings.value("mode", int(DataSaverOff)).toInt();
+    if (mode >= DataSaverOff && mode <= DataSaverOn) mDataSaverMode = DataSaverMode(mode);
+    mDailyBudgetBytes = qMax(qint64(0), settings.value("dailyBudgetBytes").toLongLong());
+    settings.endGroup();
+    rollOverDay();
+    mSinceFlush.start();
+}
+
+void MoPubDataUsage::rollOverDay(){
+    const QDate today = QDate::currentDate();
+    if (mToday == today) return;
+    mToday = today;
+    mBytesToday = 0;
+    mDirty = true;
+}
+
+void MoPubDataUsage::recordReply(const QString& adUnitId, Kind kind, QNetworkReply* reply){
+    const qint64 sent = requestBytes(reply);
+    const qint64 received = responseBytes(reply);
+
+    QMutexLocker lock(&mMutex);
+    Counters& counters = mCounters[Key(adUnitId, kind)];
+    counters.sent += sent;
+    counters.received += received;
+    rollOverDay();
+    mBytesToday += sent + received;
+    mDirty = true;
+    MPLogTrace("%1 bytes up, %2 down for %3 of %4", sent, received, KIND_NAMES[kind], adUnitId);
+    // Rewriting the file on every beacon would cost more than the beacon.
+    if (mSinceFlush.elapsed() < FLUSH_INTERVAL_MILLISECONDS) return;
+    lock.unlock();
+    flush();
+}
+
+void MoPubDataUsage::flush(){
+    QMutexLocker flushLock(&mFlushMutex);
+    QMutexLocker lock(&mMutex);
+    mSinceFlush.restart();
+    if (!mDirty) return;
+    mDirty = false;
+    // Written from a copy, recordReply() on the network thread must not wait on the file.
+    const QHash<Key, Counters> counters = mCounters;
+    const QDate today = mToday;
+    const qint64 bytesToday = mBytesToday;
+    const DataSaverMode dataSaverMode = mDataSaverMode;
+    const qint64 dailyBudgetBytes = mDailyBudgetBytes;
+    lock.unlock();
+
+    QSettings settings(mSettingsPath, QSettings::IniFormat);
+    QHash<Key, Counters>::const_iterator it = counters.constBegin();
+    for (; it != counters.constEnd(); ++it) {
+        settings.beginGroup(groupFor(it.key().first));
+        settings.setValue(QString(KIND_NAMES[it.key().second]) + "/sent", it->sent);
+        settings.setValue(QString(KIND_NAMES[it.key().second]) + "/received", it->received);
+        settings.endGroup();
+    }
+    settings.beginGroup(DAY_GROUP);
+    settings.setValue("date", today);
+    settings.setValue("bytes", bytesToday);
+    settings.endGroup();
+    settings.beginGroup(DATA_SAVER_GROUP);
+    settings.setValue("mode", int(dataSaverMode));
+    settings.setValue("dailyBudgetBytes", dailyBudgetBytes);
+    settings.endGroup();
+    MPLogDebug("Ad traffic today: %1 bytes", bytesToday);
+}
+
+qint64 MoPubDataUsage::bytesSent(const QString& adUnitId, Kind kind) const {
+    QMutexLocker lock(&mMutex);
+    return mCounters.value(Key(adUnitId, kind)).sent;
+}
+
+qint64 MoPubDataUsage::bytesReceived(const QString& adUnitId, Kind kind) const {
+    QMutexLocker lock(&mMutex);
+    return mCounters.value(Key(adUnitId, kind)).received;
+}
+
+qint64 MoPubDataUsage::bytesToday() const {
+    QMutexLocker lock(&mMutex);
+    return mToday == QDate::currentDate() ? mBytesToday : 0;
+}
+
+QVariantMap MoPubDataUsage::report() const {
+    QMutexLocker lock(&mMutex);
+    QVariantMap report;
+    QHash<Key, Counters>::const_iterator it = mCounters.constBegin();
+    for (; it != mCounters.constEnd(); ++it) {
+        QVariantMap counters;
+        counters.insert("sent", it->sent);
+        counters.insert("received", it->received);
+        QVariantMap kinds = report.value(it.key().first).toMap();
+        kinds.insert(KIND_NAMES[it.key().second], counters);
+        report.insert(it.key().first, kinds);
+    }
+    report.insert("today", mToday == QDate::currentDate() ? mBytesToday : 0);
+    return report;
+}
+
+MoPubDataUsage::DataSaverMode MoPubDataUsage::dataSaverMode() const {
+    QMutexLocker lock(&mMutex);
+    return mDataSaverMode;
+}
+
+void MoPubDataUsage::setDataSaverMode(DataSaverMode mode){
+    QMutexLocker lock(&mMutex);
+    if (mode == mDataSaverMode) return;
+    mDataSaverMode = mode;
+    mDirty = true;
+    lock.unlock();
+    // A setting, unlike the counters, is not worth losing to a crash.
+    flush();
+}
+
+qint64 MoPubDataUsage::dailyBudgetBytes() const {
+    QMutexLocker lock(&mMutex);
+    return mDailyBudgetBytes;
+}
+
+void MoPubDataUsage::setDailyBudgetBytes(qint64 bytes){
+    QMutexLocker lock(&mMutex);
+    if (bytes == mDailyBudgetBytes) return;
+    mDailyBudgetBytes = bytes;
+    mDirty = true;
+    lock.unlock();
+    flush();
+}
+
+bool MoPubDataUsage::isMetered(QNetworkConfiguration::BearerType bearer){
+    return bearer != QNetworkConfiguration::BearerWLAN && bearer != QNetworkConfiguration::BearerEthernet;
+}
+
+bool MoPubDataUsage::dataSaverActive(bool metered) const {
+    QMutexLocker lock(&mMutex);
+    switch (mDataSaverMode) {
+    case DataSaverOff:  return false;
+    case DataSaverOn:   return true;
+    case DataSaverAuto: break;
+    }
+    if (metered) return true;
+    return mDailyBudgetBytes > 0 && mToday == QDate::currentDate() && mBytesToday >= mDailyBudgetBytes;
+}
@@ -0,0 +1,90 @@
+#ifndef MOPUBDATAUSAGE_HPP_
+#define MOPUBDATAUSAGE_HPP_
+
+#include <QDate>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QNetworkConfiguration>
+#include <QPair>
+#include <QString>
+#include <QVariantMap>
+
+class QNetworkReply;
+
+/*!
+ * @brief Bytes the SDK sent and received, per ad unit and request kind, kept across launches.
+ *
+ * Sizes cover the request and status lines, headers and bodies as Qt sees them, so
+ * compressed bodies count uncompressed. Resources the WebView loads for a creative
+ * are not seen here. Also decides when the data saver is on: never, which is the default,
+ * always, or on metered networks and once the daily budget is spent. The mode and the
+ * budget are kept along with the counters. Thread safe.
+ */
+class MoPubDataUsage {
+public:
+    enum Kind {
+        AdFetch,
+        Tracking,
+        ClickResolve,
+        Conversion
+    };
+
+    enum DataSaverMode {
+        DataSaverOff,
+        DataSaverAuto,
+        DataSaverOn
+    };
+
+    static MoPubDataUsage* instance();
+
+    // Once the reply finished and before its body is read. Conversions have no ad unit.
+    void recordReply(const QString& adUnitId, Kind kind, QNetworkReply* reply);
+
+    qint64 bytesSent(const QString& adUnitId, Kind kind) const;
+    qint64 bytesReceived(const QString& adUnitId, Kind kind) const;
+    // Both directions, all ad units and kinds, since midnight.
+    qint64 bytesToday() const;
+    // { adUnitId: { kind: { "sent": n, "received": n } }, "today": n }, for the app to show.
+    QVariantMap report() const;
+
+    DataSaverMode dataSaverMode() const;
+    void setDataSaverMode(DataSaverMode mode);
+    // 0 for no budget.
+    qint64 dailyBudgetBytes() const;
+    void setDailyBudgetBytes(qint64 bytes);
+    bool dataSaverActive(bool metered) const;
+    // Anything not known to be WLAN or wired.
+    static bool isMetered(QNetworkConfiguration::BearerType bearer);
+
+    void flush();
+
+private:
+    MoPubDataUsage();
+    Q_DISABLE_COPY(MoPubDataUsage)
+
+    static const int FLUSH_INTERVAL_MILLISECONDS;
+
+    struct Counters {
+        Counters() : sent(0), received(0) {}
+        qint64 sent;
+        qint64 received;
+    };
+    typedef QPair<QString, int> Key;
+
+    void rollOverDay();
+
+    mutable QMutex mMutex;
+    // Held while writing, so a flush never overwrites a newer one. Taken before mMutex.
+    QMutex mFlushMutex;
+    QString mSettingsPath;
+    QHash<Key, Counters> mCounters;
+    QDate mToday;
+    qint64 mBytesToday;
+    DataSaverMode mDataSaverMode;
+    qint64 mDailyBudgetBytes;
+    bool mDirty;
+    QElapsedTimer mSinceFlush;
+};
+
+#endif /* MOPUBDATAUSAGE_HPP_ */
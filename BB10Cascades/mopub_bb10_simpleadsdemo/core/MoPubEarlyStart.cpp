@@ -0,0 +1,142 @@
+#include "MoPubEarlyStart.hpp"
+
+#include <QDateTime>
+#include <QMetaObject>
+#include <QNetworkConfigurationManager>
+#include <QNetworkRequest>
+
+#include "MoPubAdFetcher.hpp"
+#include "MoPubAdManager.hpp"
+#include "MoPubDataUsage.hpp"
+#include "MoPubLogging.hpp"
+#include "MoPubTrace.hpp"
+
+const int MoPubEarlyStart::RESPONSE_TTL_MILLISECONDS = 60 * 1000;
+
+namespace {
+    qint64 launchedAt = 0;
+}
+
+MoPubEarlyStart* MoPubEarlyStart::instance(){
+    static MoPubEarlyStart earlyStart;
+    return &earlyStart;
+}
+
+void MoPubEarlyStart::markLaunch(){
+    if (launchedAt == 0) launchedAt = QDateTime::currentMSecsSinceEpoch();
+}
+
+MoPubEarlyStart::MoPubEarlyStart()
+: QObject(0)
+, mNextTicket(-1)
+, mFirstAdRecorded(false)
+{
+    markLaunch();
+}
+
+void MoPubEarlyStart::start(const QStringList& adUnitIds, MoPubAdEnvironment* environment){
+    Q_CHECK_PTR(environment);
+    // Qt 4 can't open a connection ahead of a request, the DNS answer is what can be had early.
+    // The fetches below then leave a kept-alive connection behind for the views.
+    mLookupTimer.start();
+    QHostInfo::lookupHost(QUrl(MoPubAdManager::MOPUB_URL).host(), this, SLOT(onHostLookedUp(QHostInfo)));
+
+    const QNetworkConfiguration::BearerType bearer = QNetworkConfigurationManager().defaultConfiguration().bearerType();
+    if (MoPubDataUsage::instance()->dataSaverActive(MoPubDataUsage::isMetered(bearer))) {
+        MPLogInfo("Data saver on, no early ad fetches.");
+        return;
+    }
+
+    const QByteArray userAgent = environment->userAgent().toLatin1();
+    foreach (const QString& adUnitId, adUnitIds) {
+        if (adUnitId.isEmpty() || mFetches.contains(adUnitId)) continue;
+        Fetch fetch;
+        fetch.ticket = mNextTicket--;
+        fetch.url = MoPubAdManager::adRequestUrl(adUnitId, environment);
+        fetch.fetcher = new MoPubAdFetcher();
+        bool res = connect(fetch.fetcher, SIGNAL(adResponse(MoPubAdResponse)), this, SLOT(onAdResponse(MoPubAdResponse)));
+        Q_ASSERT(res);
+        res = connect(fetch.fetcher, SIGNAL(fetchFailed(int, int)), this, SLOT(onFetchFailed(int, int)));
+        Q_ASSERT(res);
+        Q_UNUSED(res);
+        QMetaObject::invokeMethod(fetch.fetcher, "setAdUnitId", Qt::QueuedConnection, Q_ARG(QString, adUnitId));
+        QMetaObject::invokeMethod(fetch.fetcher, "fetch", Qt::QueuedConnection,
+                Q_ARG(int, fetch.ticket), Q_ARG(QUrl, fetch.url), Q_ARG(QByteArray, userAgent),
+                Q_ARG(int, int(QNetworkRequest::HighPriority)), Q_ARG(bool, false));
+        MPLogDebug("Early fetch of %1 started %2 ms after launch", adUnitId, QDateTime::currentMSecsSinceEpoch() - launchedAt);
+        mFetches.insert(adUnitId, fetch);
+    }
+}
+
+void MoPubEarlyStart::onHostLookedUp(const QHostInfo& host){
+    MPLogDebug("Ad server %1 looked up in %2 ms: %3", host.hostName(), mLookupTimer.elapsed(),
+            host.error() == QHostInfo::NoError ? QString("ok") : host.errorString());
+}
+
+int MoPubEarlyStart::adopt(const QString& adUnitId, QObject* placement, QUrl* url){
+    QHash<QString, Fetch>::iterator it = mFetches.find(adUnitId);
+    // Another placement of the unit adopted it already.
+    if (it == mFetches.end() || !it->placement.isNull()) return 0;
+    if (it->done && (it->errorCode != 0
+            || QDateTime::currentMSecsSinceEpoch() - it->finishedAt > RESPONSE_TTL_MILLISECONDS)) {
+        mFetches.erase(it);
+        return 0;
+    }
+    it->placement = placement;
+    if (url) *url = it->url;
+    const int ticket = it->ticket;
+    MPLogInfo("%1 adopts its early fetch, %2", adUnitId, it->done ? QString("already answered") : QString("still in flight"));
+    if (it->done) deliver(*it);
+    return ticket;
+}
+
+QString MoPubEarlyStart::adUnitIdForTicket(int ticket) const {
+    for (QHash<QString, Fetch>::const_iterator it = mFetches.constBegin(); it != mFetches.constEnd(); ++it) {
+        if (it->ticket == ticket) return it.key();
+    }
+    return QString();
+}
+
+void MoPubEarlyStart::onAdResponse(const MoPubAdResponse& response){
+    finish(response.requestId, &response, 0);
+}
+
+void MoPubEarlyStart::onFetchFailed(int requestId, int code){
+    finish(requestId, 0, code);
+}
+
+void MoPubEarlyStart::finish(int ticket, const MoPubAdResponse* response, int errorCode){
+    const QString adUnitId = adUnitIdForTicket(ticket);
+    if (adUnitId.isEmpty()) return;
+    Fetch& fetch = mFetches[adUnitId];
+    fetch.done = true;
+    if (response) fetch.response = *response;
+    fetch.errorCode = errorCode;
+    fetch.finishedAt = QDateTime::currentMSecsSinceEpoch();
+    // The fetcher lives on the network thread, let it go away there.
+    fetch.fetcher->deleteLater();
+    fetch.fetcher = 0;
+    MPLogDebug("Early fetch of %1 answered %2 ms after launch", adUnitId, fetch.finishedAt - launchedAt);
+    if (!fetch.placement.isNull()) deliver(fetch);
+}
+
+void MoPubEarlyStart::deliver(Fetch& fetch){
+    // Queued like the fetcher's own signals, the placement is still inside loadAd() when adopting.
+    if (fetch.errorCode != 0) {
+        QMetaObject::invokeMethod(fetch.placement, "onFetchAdError", Qt::QueuedConnection,
+                Q_ARG(int, fetch.ticket), Q_ARG(int, fetch.errorCode));
+    } else {
+        QMetaObject::invokeMethod(fetch.placement, "onAdResponse", Qt::QueuedConnection,
+                Q_ARG(MoPubAdResponse, fetch.response));
+    }
+    // Delivered once, later loads of the unit fetch their own.
+    mFetches.remove(adUnitIdForTicket(fetch.ticket));
+}
+
+void MoPubEarlyStart::recordAdLoaded(const QString& adUnitId, bool adopted){
+    if (mFirstAdRecorded) return;
+    mFirstAdRecorded = true;
+    const qint64 elapsed = QDateTime::currentMSecsSinceEpoch() - launchedAt;
+    MPLogInfo("Launch to first ad: %1 ms, %2 (%3)", elapsed, adUnitId, adopted ? QString("early fetch") : QString("own fetch"));
+    if (MoPubTrace::isEnabled()) MoPubTrace::instance()->instant("firstAd", this, adUnitId, QString::number(elapsed));
+}
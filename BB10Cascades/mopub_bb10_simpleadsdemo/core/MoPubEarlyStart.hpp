@@ -0,0 +1,79 @@
+#ifndef MOPUBEARLYSTART_HPP_
+#define MOPUBEARLYSTART_HPP_
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostInfo>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QUrl>
+
+#include "MoPubAdResponse.hpp"
+
+class MoPubAdEnvironment;
+class MoPubAdFetcher;
+
+/*!
+ * @brief Fetches the first ads of known ad units while the app is still building its scene.
+ *
+ * Call start() from main() or the application constructor, before the QML is loaded.
+ * It looks up the ad server and requests an ad for each unit right away. The first
+ * load of a MoPubAdManager for one of those units adopts the result, whether it has
+ * arrived already or is still on its way, instead of sending a request of its own.
+ * The time from markLaunch() to the first ad loaded is logged.
+ */
+class MoPubEarlyStart: public QObject {
+    Q_OBJECT
+public:
+    // Older responses are dropped, the view fetches a fresh one.
+    static const int RESPONSE_TTL_MILLISECONDS;
+
+    static MoPubEarlyStart* instance();
+
+    // As early in main() as possible, before the Application is created is fine.
+    static void markLaunch();
+
+    void start(const QStringList& adUnitIds, MoPubAdEnvironment* environment);
+
+    // A ticket the result will be delivered under to the placement's onAdResponse() or onFetchAdError()
+    // slot, by a queued call; 0 when there is nothing to adopt. Tickets are negative, they never come
+    // from MoPubAdPlacementManager.
+    int adopt(const QString& adUnitId, QObject* placement, QUrl* url);
+
+    // The first call logs the launch to first ad time.
+    void recordAdLoaded(const QString& adUnitId, bool adopted);
+
+private Q_SLOTS:
+    void onHostLookedUp(const QHostInfo& host);
+    void onAdResponse(const MoPubAdResponse& response);
+    void onFetchFailed(int requestId, int code);
+
+private:
+    MoPubEarlyStart();
+    Q_DISABLE_COPY(MoPubEarlyStart)
+
+    struct Fetch {
+        Fetch() : ticket(0), fetcher(0), done(false), errorCode(0), finishedAt(0) {}
+        int ticket;
+        QUrl url;
+        MoPubAdFetcher* fetcher;
+        bool done;
+        MoPubAdResponse response;
+        // Network error when done without a response.
+        int errorCode;
+        qint64 finishedAt;
+        QPointer<QObject> placement;
+    };
+
+    void finish(int ticket, const MoPubAdResponse* response, int errorCode);
+    void deliver(Fetch& fetch);
+    QString adUnitIdForTicket(int ticket) const;
+
+    QHash<QString, Fetch> mFetches;
+    int mNextTicket;
+    QElapsedTimer mLookupTimer;
+    bool mFirstAdRecorded;
+};
+
+#endif /* MOPUBEARLYSTART_HPP_ */
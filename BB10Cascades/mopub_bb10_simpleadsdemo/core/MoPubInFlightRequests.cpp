@@ -0,0 +1,119 @@
+#include "MoPubInFlightRequests.hpp"
+
+#include <QNetworkReply>
+#include <QPair>
+#include <QtAlgorithms>
+
+#include "MoPubAdFetcher.hpp"
+#include "MoPubLogging.hpp"
+
+namespace {
+    const char* const KIND_NAMES[] = { "ad fetch", "tracking" };
+    const int KIND_COUNT = sizeof(KIND_NAMES) / sizeof(KIND_NAMES[0]);
+    const char* const KEY_PROPERTY = "mopubInFlightKey";
+
+    QAtomicInt sPolicies[KIND_COUNT] = { QAtomicInt(MoPubInFlightRequests::Separate), QAtomicInt(MoPubInFlightRequests::Coalesce) };
+    QAtomicInt sIssued[KIND_COUNT];
+    QAtomicInt sCoalesced[KIND_COUNT];
+}
+
+MoPubInFlightRequests::MoPubInFlightRequests()
+: QObject(0)
+{
+}
+
+MoPubInFlightRequests* MoPubInFlightRequests::instance(){
+    // First used, and so created, on the network thread.
+    static MoPubInFlightRequests requests;
+    return &requests;
+}
+
+void MoPubInFlightRequests::setPolicy(Kind kind, Policy policy){
+    sPolicies[kind] = policy;
+}
+
+MoPubInFlightRequests::Policy MoPubInFlightRequests::policy(Kind kind){
+    return static_cast<Policy>(int(sPolicies[kind]));
+}
+
+int MoPubInFlightRequests::issuedCount(Kind kind){
+    return sIssued[kind];
+}
+
+int MoPubInFlightRequests::coalescedCount(Kind kind){
+    return sCoalesced[kind];
+}
+
+QByteArray MoPubInFlightRequests::key(Kind kind, const QUrl& url){
+    // Parameter order, case of the host, default ports and fragments don't make a different request.
+    QUrl normalized(url);
+    normalized.setScheme(url.scheme().toLower());
+    normalized.setHost(url.host().toLower());
+    if ((normalized.scheme() == "http" && url.port() == 80) || (normalized.scheme() == "https" && url.port() == 443)) {
+        normalized.setPort(-1);
+    }
+    normalized.setFragment(QString());
+    QList<QPair<QByteArray, QByteArray> > items = url.encodedQueryItems();
+    qSort(items);
+    normalized.setEncodedQueryItems(items);
+    return QByteArray::number(kind) + ' ' + normalized.toEncoded();
+}
+
+bool MoPubInFlightRequests::join(Kind kind, const QUrl& url, MoPubAdFetcher* fetcher, int requestId){
+    if (policy(kind) != Coalesce) return false;
+    QHash<QByteArray, Entry>::iterator entry = mEntries.find(key(kind, url));
+    if (entry == mEntries.end()) return false;
+    if (fetcher) {
+        Waiter waiter;
+        waiter.fetcher = fetcher;
+        waiter.requestId = requestId;
+        entry->waiters.append(waiter);
+    }
+    sCoalesced[kind].fetchAndAddRelaxed(1);
+    MPLogDebug("Coalesced %1 request %2, %3 of %4 so far", KIND_NAMES[kind], url,
+            int(sCoalesced[kind]), int(sIssued[kind]) + int(sCoalesced[kind]));
+    return true;
+}
+
+void MoPubInFlightRequests::add(Kind kind, const QUrl& url, QNetworkReply* reply){
+    sIssued[kind].fetchAndAddRelaxed(1);
+    if (policy(kind) != Coalesce) return;
+    const QByteArray requestKey = key(kind, url);
+    Entry entry;
+    entry.reply = reply;
+    mEntries.insert(requestKey, entry);
+    reply->setProperty(KEY_PROPERTY, requestKey);
+    // Direct, the table and the replies share the network thread.
+    bool res = connect(reply, SIGNAL(destroyed(QObject*)), this, SLOT(onReplyDestroyed(QObject*)), Qt::DirectConnection);
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+}
+
+QList<MoPubInFlightRequests::Waiter> MoPubInFlightRequests::take(QNetworkReply* reply){
+    const QByteArray requestKey = reply->property(KEY_PROPERTY).toByteArray();
+    if (requestKey.isEmpty()) return QList<Waiter>();
+    QHash<QByteArray, Entry>::iterator entry = mEntries.find(requestKey);
+    // A later request with the same key may have replaced it, when the policy changed in between.
+    if (entry == mEntries.end() || entry->reply != reply) return QList<Waiter>();
+    QList<Waiter> waiters = entry->waiters;
+    mEntries.erase(entry);
+    disconnect(reply, SIGNAL(destroyed(QObject*)), this, SLOT(onReplyDestroyed(QObject*)));
+    return waiters;
+}
+
+void MoPubInFlightRequests::onReplyDestroyed(QObject* reply){
+    // Aborted before it finished, along with the fetcher that owned it.
+    QHash<QByteArray, Entry>::iterator entry = mEntries.begin();
+    while (entry != mEntries.end()) {
+        if (entry->reply != reply) {
+            ++entry;
+            continue;
+        }
+        foreach (const Waiter& waiter, entry->waiters) {
+            if (waiter.fetcher.isNull()) continue;
+            QMetaObject::invokeMethod(waiter.fetcher, "onSharedFetchAbandoned", Qt::DirectConnection,
+                    Q_ARG(int, waiter.requestId));
+        }
+        entry = mEntries.erase(entry);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef MOPUBINFLIGHTREQUESTS_HPP_
+#define MOPUBINFLIGHTREQUESTS_HPP_
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QUrl>
+
+class MoPubAdFetcher;
+class QNetworkReply;
+
+/*!
+ * @brief Table of the requests in flight on MoPubNetworkThread, so identical ones share a reply.
+ *
+ * Requests are keyed by kind and normalized URL. What a duplicate does depends on the
+ * policy of its kind: with Coalesce it attaches to the reply already in flight, with
+ * Separate it goes out on its own. Tracking beacons are coalesced by default, since a
+ * beacon fired twice counts twice. Ad fetches are separate by default, since views
+ * sharing a fetch show the same creative. Only to be used on the network thread,
+ * except for the policies and counters.
+ */
+class MoPubInFlightRequests: public QObject {
+    Q_OBJECT
+public:
+    enum Kind {
+        AdFetch,
+        Tracking
+    };
+    enum Policy {
+        Separate,
+        Coalesce
+    };
+
+    static MoPubInFlightRequests* instance();
+
+    static void setPolicy(Kind kind, Policy policy);
+    static Policy policy(Kind kind);
+    // Requests that went out, and duplicates that attached to one of them instead.
+    static int issuedCount(Kind kind);
+    static int coalescedCount(Kind kind);
+
+    static QByteArray key(Kind kind, const QUrl& url);
+
+    // True when an identical request is in flight and coalescing is allowed. An ad fetch
+    // then gets the shared result delivered by the fetcher that owns the reply.
+    bool join(Kind kind, const QUrl& url, MoPubAdFetcher* fetcher = 0, int requestId = 0);
+    void add(Kind kind, const QUrl& url, QNetworkReply* reply);
+
+    struct Waiter {
+        QPointer<MoPubAdFetcher> fetcher;
+        int requestId;
+    };
+    // Closes the entry of a finished reply, returning the requests that joined it.
+    QList<Waiter> take(QNetworkReply* reply);
+
+private Q_SLOTS:
+    void onReplyDestroyed(QObject* reply);
+
+private:
+    MoPubInFlightRequests();
+
+    struct Entry {
+        // Only compared, never dereferenced: it is gone once destroyed() arrives.
+        QObject* reply;
+        QList<Waiter> waiters;
+    };
+    QHash<QByteArray, Entry> mEntries;
+};
+
+#endif /* MOPUBINFLIGHTREQUESTS_HPP_ */
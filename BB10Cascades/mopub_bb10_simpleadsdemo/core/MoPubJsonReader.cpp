@@ -0,0 +1,230 @@
+#include "MoPubJsonReader.hpp"
+
+#include <string.h>
+
+static bool isHexDigit(char c){
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+MoPubJsonReader::MoPubJsonReader(const QByteArray& json)
+: mSource(json)
+, mData(mSource.constData())
+, mSize(mSource.size())
+, mPos(0)
+, mToken(Null)
+, mState(ExpectValue)
+, mStart(0)
+, mLength(0)
+, mEscaped(false)
+{
+}
+
+MoPubJsonReader::Token MoPubJsonReader::fail(const char* error){
+    mError = QString::fromLatin1(error);
+    mToken = Invalid;
+    return mToken;
+}
+
+void MoPubJsonReader::skipWhitespace(){
+    while (mPos < mSize && (mData[mPos] == ' ' || mData[mPos] == '\t' || mData[mPos] == '\n' || mData[mPos] == '\r')) ++mPos;
+}
+
+MoPubJsonReader::Token MoPubJsonReader::next(){
+    if (mToken == Invalid || mToken == End) return mToken;
+    skipWhitespace();
+
+    if (mState == AfterValue) {
+        if (mStack.isEmpty()) {
+            if (mPos != mSize) return fail("Trailing characters");
+            mToken = End;
+            return mToken;
+        }
+        if (mPos >= mSize) return fail("Unterminated container");
+        const char c = mData[mPos];
+        const char open = mStack[mStack.size() - 1];
+        if (c == ',') {
+            ++mPos;
+            skipWhitespace();
+            mState = open == '{' ? ExpectName : ExpectValue;
+        } else if ((c == '}' && open == '{') || (c == ']' && open == '[')) {
+            ++mPos;
+            mStack.removeLast();
+            mToken = c == '}' ? EndObject : EndArray;
+            return mToken;
+        } else {
+            return fail("Expected ',' or the end of the container");
+        }
+    }
+    if (mPos >= mSize) return fail("Unexpected end of input");
+
+    if (mState == ExpectNameOrEnd || mState == ExpectValueOrEnd) {
+        const char close = mState == ExpectNameOrEnd ? '}' : ']';
+        if (mData[mPos] == close) {
+            ++mPos;
+            mStack.removeLast();
+            mState = AfterValue;
+            mToken = close == '}' ? EndObject : EndArray;
+            return mToken;
+        }
+        mState = mState == ExpectNameOrEnd ? ExpectName : ExpectValue;
+    }
+
+    if (mState == ExpectName) {
+        if (mData[mPos] != '"') return fail("Expected a name");
+        if (scanString(Name) == Invalid) return mToken;
+        skipWhitespace();
+        if (mPos >= mSize || mData[mPos] != ':') return fail("Expected ':'");
+        ++mPos;
+        mState = ExpectValue;
+        return mToken;
+    }
+
+    mState = AfterValue;
+    switch (mData[mPos]) {
+    case '{':
+        mStack.append('{');
+        ++mPos;
+        mState = ExpectNameOrEnd;
+        mToken = BeginObject;
+        return mToken;
+    case '[':
+        mStack.append('[');
+        ++mPos;
+        mState = ExpectValueOrEnd;
+        mToken = BeginArray;
+        return mToken;
+    case '"':
+        return scanString(String);
+    case 't':
+        return scanLiteral("true", Bool);
+    case 'f':
+        return scanLiteral("false", Bool);
+    case 'n':
+        return scanLiteral("null", Null);
+    default:
+        return scanNumber();
+    }
+}
+
+MoPubJsonReader::Token MoPubJsonReader::scanString(Token token){
+    mEscaped = false;
+    mStart = ++mPos;
+    while (mPos < mSize) {
+        const unsigned char c = mData[mPos];
+        if (c == '"') {
+            mLength = mPos - mStart;
+            ++mPos;
+            mToken = token;
+            return mToken;
+        }
+        if (c < 0x20) return fail("Control character in string");
+        if (c == '\\') {
+            mEscaped = true;
+            ++mPos;
+            if (mPos >= mSize) break;
+            if (mData[mPos] == 'u') {
+                // toString() decodes the four digits as they are, they must be there.
+                if (mSize - mPos <= 4) break;
+                for (int i = 1; i <= 4; ++i) {
+                    if (!isHexDigit(mData[mPos + i])) return fail("Bad \\u escape");
+                }
+                mPos += 4;
+            }
+        }
+        ++mPos;
+    }
+    return fail("Unterminated string");
+}
+
+MoPubJsonReader::Token MoPubJsonReader::scanLiteral(const char* literal, Token token){
+    const int length = qstrlen(literal);
+    if (mSize - mPos < length || memcmp(mData + mPos, literal, length) != 0) return fail("Unknown literal");
+    mStart = mPos;
+    mLength = length;
+    mPos += length;
+    mToken = token;
+    return mToken;
+}
+
+MoPubJsonReader::Token MoPubJsonReader::scanNumber(){
+    mStart = mPos;
+    if (mPos < mSize && mData[mPos] == '-') ++mPos;
+    const int digits = mPos;
+    while (mPos < mSize && mData[mPos] >= '0' && mData[mPos] <= '9') ++mPos;
+    if (mPos == digits) return fail("Unexpected character");
+    if (mPos < mSize && mData[mPos] == '.') {
+        ++mPos;
+        while (mPos < mSize && mData[mPos] >= '0' && mData[mPos] <= '9') ++mPos;
+    }
+    if (mPos < mSize && (mData[mPos] == 'e' || mData[mPos] == 'E')) {
+        ++mPos;
+        if (mPos < mSize && (mData[mPos] == '+' || mData[mPos] == '-')) ++mPos;
+        while (mPos < mSize && mData[mPos] >= '0' && mData[mPos] <= '9') ++mPos;
+    }
+    mLength = mPos - mStart;
+    mToken = Number;
+    return mToken;
+}
+
+bool MoPubJsonReader::skipValue(){
+    if (mToken != BeginObject && mToken != BeginArray) return mToken != Invalid;
+    const int depth = mStack.size();
+    while (next() != Invalid) {
+        if ((mToken == EndObject || mToken == EndArray) && mStack.size() < depth) return true;
+    }
+    return false;
+}
+
+QByteArray MoPubJsonReader::view() const {
+    switch (mToken) {
+    case Name:
+    case String:
+    case Number:
+    case Bool:
+    case Null:
+        return QByteArray::fromRawData(mData + mStart, mLength);
+    default:
+        return QByteArray();
+    }
+}
+
+QString MoPubJsonReader::toString() const {
+    const QByteArray text = view();
+    if (!mEscaped || (mToken != Name && mToken != String)) return QString::fromUtf8(text.constData(), text.size());
+
+    QString out;
+    out.reserve(text.size());
+    int chunk = 0;
+    for (int i = 0; i < text.size(); ++i) {
+        if (text.at(i) != '\\') continue;
+        out.append(QString::fromUtf8(text.constData() + chunk, i - chunk));
+        ++i;
+        switch (text.at(i)) {
+        case 'b': out.append(QChar('\b')); break;
+        case 'f': out.append(QChar('\f')); break;
+        case 'n': out.append(QChar('\n')); break;
+        case 'r': out.append(QChar('\r')); break;
+        case 't': out.append(QChar('\t')); break;
+        // Surrogate pairs come as two escapes and end up as the two UTF-16 units they are.
+        case 'u': out.append(QChar(ushort(text.mid(i + 1, 4).toUShort(0, 16)))); i += 4; break;
+        default:  out.append(QChar::fromLatin1(text.at(i))); break;
+        }
+        chunk = i + 1;
+    }
+    out.append(QString::fromUtf8(text.constData() + chunk, text.size() - chunk));
+    return out;
+}
+
+int MoPubJsonReader::toInt(bool* ok) const {
+    // Numbers are often sent as strings.
+    const QByteArray text = view();
+    bool converted = false;
+    int value = text.toInt(&converted);
+    if (!converted) value = int(text.toDouble(&converted));
+    if (ok) *ok = converted;
+    return converted ? value : 0;
+}
+
+double MoPubJsonReader::toDouble(bool* ok) const {
+    return view().toDouble(ok);
+}
@@ -0,0 +1,77 @@
+#ifndef MOPUBJSONREADER_HPP_
+#define MOPUBJSONREADER_HPP_
+
+#include <QByteArray>
+#include <QString>
+#include <QVarLengthArray>
+
+/*!
+ * @brief Pull reader for JSON held in a QByteArray, without building a QVariantMap.
+ *
+ * next() steps from token to token and checks the grammar as it goes. Names, strings and
+ * numbers are handed out as views into the source, escapes untouched; toString() decodes
+ * them only when asked to. Values of no interest are passed over with skipValue(). The
+ * source must stay alive and unchanged while the reader and its views are used.
+ */
+class MoPubJsonReader {
+public:
+    enum Token {
+        Invalid,
+        BeginObject,
+        EndObject,
+        BeginArray,
+        EndArray,
+        Name,
+        String,
+        Number,
+        Bool,
+        Null,
+        End
+    };
+
+    explicit MoPubJsonReader(const QByteArray& json);
+
+    Token next();
+    Token token() const { return mToken; }
+    // Whole objects and arrays when on their Begin token, leaves the reader on their End token.
+    bool skipValue();
+
+    // Text of the current name or string between the quotes, or of the current literal.
+    QByteArray view() const;
+    QString toString() const;
+    int toInt(bool* ok = 0) const;
+    double toDouble(bool* ok = 0) const;
+    bool toBool() const { return mToken == Bool && mData[mStart] == 't'; }
+
+    QString errorString() const { return mError; }
+    int errorOffset() const { return mToken == Invalid ? mPos : -1; }
+
+private:
+    enum State {
+        ExpectValue,
+        ExpectName,
+        ExpectNameOrEnd,
+        ExpectValueOrEnd,
+        AfterValue
+    };
+
+    Token fail(const char* error);
+    Token scanString(Token token);
+    Token scanLiteral(const char* literal, Token token);
+    Token scanNumber();
+    void skipWhitespace();
+
+    const QByteArray mSource;
+    const char* mData;
+    int mSize;
+    int mPos;
+    Token mToken;
+    State mState;
+    QVarLengthArray<char, 16> mStack;
+    int mStart;
+    int mLength;
+    bool mEscaped;
+    QString mError;
+};
+
+#endif /* MOPUBJSONREADER_HPP_ */
@@ -0,0 +1,181 @@
+#include "MoPubLogging.hpp"
+
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QString>
+#include <QThread>
+#include <QtGlobal>
+
+#ifdef QT_NO_DEBUG
+volatile int MoPubLog::sLevel = MoPubLogLevelInfo;
+#else
+volatile int MoPubLog::sLevel = MoPubLogLevelDebug;
+#endif
+
+namespace {
+    const int MAXIMUM_ARGUMENTS = 4;
+    const int RING_CAPACITY = 256; // must be a power of two
+    const int RING_MASK = RING_CAPACITY - 1;
+    const unsigned long DRAIN_INTERVAL_MILLISECONDS = 250;
+
+    struct LogRecord {
+        LogRecord() : timestamp(0), level(MoPubLogLevelAll), format(0), argc(0) {}
+        qint64 timestamp;
+        MoPubLogLevel level;
+        const char* format;
+        int argc;
+        QVariant args[MAXIMUM_ARGUMENTS];
+    };
+
+    /*
+     * Bounded multi-producer, single-consumer ring. Every slot carries a sequence number
+     * telling producers and the consumer whose turn it is, so neither side takes a lock.
+     */
+    class LogRing {
+    public:
+        LogRing() : mEnqueuePos(0), mDequeuePos(0), mDropped(0) {
+            for (int i = 0; i < RING_CAPACITY; ++i) mSlots[i].sequence = i;
+        }
+
+        bool push(const LogRecord& record) {
+            int pos = mEnqueuePos;
+            Slot* slot;
+            for (;;) {
+                slot = &mSlots[pos & RING_MASK];
+                int diff = slot->sequence.fetchAndAddAcquire(0) - pos;
+                if (diff == 0) {
+                    if (mEnqueuePos.testAndSetRelaxed(pos, pos + 1)) break;
+                    pos = mEnqueuePos;
+                } else if (diff < 0) {
+                    mDropped.fetchAndAddRelaxed(1);
+                    return false;
+                } else {
+                    pos = mEnqueuePos;
+                }
+            }
+            slot->record = record;
+            slot->sequence.fetchAndStoreRelease(pos + 1);
+            return true;
+        }
+
+        bool pop(LogRecord* record) {
+            Slot* slot = &mSlots[mDequeuePos & RING_MASK];
+            if (slot->sequence.fetchAndAddAcquire(0) - (mDequeuePos + 1) < 0) return false;
+            *record = slot->record;
+            slot->record = LogRecord();
+            slot->sequence.fetchAndStoreRelease(mDequeuePos + RING_CAPACITY);
+            ++mDequeuePos;
+            return true;
+        }
+
+        int dropped() const { return mDropped; }
+
+    private:
+        struct Slot {
+            QAtomicInt sequence;
+            LogRecord record;
+        };
+        Slot mSlots[RING_CAPACITY];
+        QAtomicInt mEnqueuePos;
+        int mDequeuePos; // only touched by the drain thread
+        QAtomicInt mDropped;
+    };
+
+    const char* levelName(MoPubLogLevel level) {
+        if (level >= MoPubLogLevelFatal) return "FATAL";
+        if (level >= MoPubLogLevelError) return "ERROR";
+        if (level >= MoPubLogLevelWarn) return "WARN";
+        if (level >= MoPubLogLevelInfo) return "INFO";
+        if (level >= MoPubLogLevelDebug) return "DEBUG";
+        return "TRACE";
+    }
+
+    QString format(const LogRecord& record) {
+        QString message = QString::fromLatin1(record.format);
+        switch (record.argc) {
+        case 1: return message.arg(record.args[0].toString());
+        case 2: return message.arg(record.args[0].toString(), record.args[1].toString());
+        case 3: return message.arg(record.args[0].toString(), record.args[1].toString(), record.args[2].toString());
+        case 4: return message.arg(record.args[0].toString(), record.args[1].toString(), record.args[2].toString(),
+                record.args[3].toString());
+        default: return message;
+        }
+    }
+
+    class LogDrain: public QThread {
+    public:
+        LogDrain() : mStopping(0) {}
+        ~LogDrain() {
+            mStopping = 1;
+            wait();
+            drain();
+        }
+
+        LogRing ring;
+
+    protected:
+        void run() {
+            while (!mStopping) {
+                drain();
+                msleep(DRAIN_INTERVAL_MILLISECONDS);
+            }
+        }
+
+    private:
+        void drain() {
+            LogRecord record;
+            while (ring.pop(&record)) {
+                qDebug("MOPUB: %lld %s %s", record.timestamp, levelName(record.level), qPrintable(format(record)));
+            }
+        }
+
+        QAtomicInt mStopping;
+    };
+
+    LogDrain* sharedDrain() {
+        static LogDrain logDrain;
+        if (!logDrain.isRunning() && !logDrain.isFinished()) {
+            logDrain.start(QThread::LowestPriority);
+        }
+        return &logDrain;
+    }
+}
+
+void MoPubLog::push(MoPubLogLevel level, const char* format, int argc, const QVariant* args){
+    LogRecord record;
+    record.timestamp = QDateTime::currentMSecsSinceEpoch();
+    record.level = level;
+    record.format = format;
+    record.argc = argc;
+    for (int i = 0; i < argc; ++i) record.args[i] = args[i];
+    sharedDrain()->ring.push(record);
+}
+
+void MoPubLog::log(MoPubLogLevel level, const char* format){
+    push(level, format, 0, 0);
+}
+
+void MoPubLog::log(MoPubLogLevel level, const char* format, const QVariant& a1){
+    push(level, format, 1, &a1);
+}
+
+void MoPubLog::log(MoPubLogLevel level, const char* format, const QVariant& a1, const QVariant& a2){
+    const QVariant args[] = { a1, a2 };
+    push(level, format, 2, args);
+}
+
+void MoPubLog::log(MoPubLogLevel level, const char* format, const QVariant& a1, const QVariant& a2,
+        const QVariant& a3){
+    const QVariant args[] = { a1, a2, a3 };
+    push(level, format, 3, args);
+}
+
+void MoPubLog::log(MoPubLogLevel level, const char* format, const QVariant& a1, const QVariant& a2,
+        const QVariant& a3, const QVariant& a4){
+    const QVariant args[] = { a1, a2, a3, a4 };
+    push(level, format, 4, args);
+}
+
+int MoPubLog::droppedCount(){
+    return sharedDrain()->ring.dropped();
+}
@@ -0,0 +1,99 @@
+#ifndef MOPUBLOGGING_HPP_
+#define MOPUBLOGGING_HPP_
+
+#include <QVariant>
+
+// Lower = finer-grained logs.
+enum MoPubLogLevel {
+    MoPubLogLevelAll    = 0,
+    MoPubLogLevelTrace  = 10,
+    MoPubLogLevelDebug  = 20,
+    MoPubLogLevelInfo   = 30,
+    MoPubLogLevelWarn   = 40,
+    MoPubLogLevelError  = 50,
+    MoPubLogLevelFatal  = 60,
+    MoPubLogLevelOff    = 70
+};
+
+// Levels below MOPUB_LOG_COMPILED_LEVEL compile to nothing.
+#ifndef MOPUB_LOG_COMPILED_LEVEL
+#ifdef QT_NO_DEBUG
+#define MOPUB_LOG_COMPILED_LEVEL 30
+#else
+#define MOPUB_LOG_COMPILED_LEVEL 0
+#endif
+#endif
+
+/*!
+ * @brief Leveled logging for the MoPub SDK, the counterpart of MPLogging on iOS.
+ *
+ * Log calls only capture the format literal and their arguments as QVariants into a
+ * lock-free ring buffer. Formatting and output happen on a background thread, so
+ * a log call on the UI thread costs a few atomic operations. Records are dropped,
+ * and counted, when the buffer is full.
+ *
+ * Formats use QString::arg() placeholders: MPLogDebug("Fetch ad for %1", url);
+ */
+class MoPubLog {
+public:
+    static MoPubLogLevel level() { return static_cast<MoPubLogLevel>(sLevel); }
+    static void setLevel(MoPubLogLevel level) { sLevel = level; }
+    static bool isEnabled(MoPubLogLevel level) { return level >= sLevel; }
+
+    static void log(MoPubLogLevel level, const char* format);
+    static void log(MoPubLogLevel level, const char* format, const QVariant& a1);
+    static void log(MoPubLogLevel level, const char* format, const QVariant& a1, const QVariant& a2);
+    static void log(MoPubLogLevel level, const char* format, const QVariant& a1, const QVariant& a2,
+            const QVariant& a3);
+    static void log(MoPubLogLevel level, const char* format, const QVariant& a1, const QVariant& a2,
+            const QVariant& a3, const QVariant& a4);
+
+    // Number of records lost because the ring buffer was full.
+    static int droppedCount();
+
+private:
+    static void push(MoPubLogLevel level, const char* format, int argc, const QVariant* args);
+
+    static volatile int sLevel;
+};
+
+#define MP_LOG_AT(lvl, ...) do { if (MoPubLog::isEnabled(lvl)) MoPubLog::log(lvl, __VA_ARGS__); } while (0)
+#define MP_LOG_NOTHING(...) do {} while (0)
+
+#if MOPUB_LOG_COMPILED_LEVEL <= 10
+#define MPLogTrace(...) MP_LOG_AT(MoPubLogLevelTrace, __VA_ARGS__)
+#else
+#define MPLogTrace(...) MP_LOG_NOTHING(__VA_ARGS__)
+#endif
+
+#if MOPUB_LOG_COMPILED_LEVEL <= 20
+#define MPLogDebug(...) MP_LOG_AT(MoPubLogLevelDebug, __VA_ARGS__)
+#else
+#define MPLogDebug(...) MP_LOG_NOTHING(__VA_ARGS__)
+#endif
+
+#if MOPUB_LOG_COMPILED_LEVEL <= 30
+#define MPLogInfo(...) MP_LOG_AT(MoPubLogLevelInfo, __VA_ARGS__)
+#else
+#define MPLogInfo(...) MP_LOG_NOTHING(__VA_ARGS__)
+#endif
+
+#if MOPUB_LOG_COMPILED_LEVEL <= 40
+#define MPLogWarn(...) MP_LOG_AT(MoPubLogLevelWarn, __VA_ARGS__)
+#else
+#define MPLogWarn(...) MP_LOG_NOTHING(__VA_ARGS__)
+#endif
+
+#if MOPUB_LOG_COMPILED_LEVEL <= 50
+#define MPLogError(...) MP_LOG_AT(MoPubLogLevelError, __VA_ARGS__)
+#else
+#define MPLogError(...) MP_LOG_NOTHING(__VA_ARGS__)
+#endif
+
+#if MOPUB_LOG_COMPILED_LEVEL <= 60
+#define MPLogFatal(...) MP_LOG_AT(MoPubLogLevelFatal, __VA_ARGS__)
+#else
+#define MPLogFatal(...) MP_LOG_NOTHING(__VA_ARGS__)
+#endif
+
+#endif /* MOPUBLOGGING_HPP_ */
@@ -0,0 +1,258 @@
+#include "MoPubNetworkCapture.hpp"
+
+#include <QNetworkRequest>
+#include <QTimer>
+
+#include <string.h>
+
+#include "MoPubAdEnvelope.hpp"
+#include "MoPubLogging.hpp"
+
+namespace {
+    const quint32 CAPTURE_MAGIC = 0x4d504e43; // "MPNC"
+    const quint16 CAPTURE_VERSION = 1;
+    const char* STARTED_AT_PROPERTY = "mopubCaptureStartedAt";
+
+    // Query items that change on every request and would defeat matching.
+    const char* VOLATILE_QUERY_ITEMS[] = { "ll", "z", "o", "reqid", "reqt", "random" };
+    const int VOLATILE_QUERY_ITEM_COUNT = sizeof(VOLATILE_QUERY_ITEMS) / sizeof(VOLATILE_QUERY_ITEMS[0]);
+
+    void writeHeaders(QDataStream& out, const QList<QNetworkReply::RawHeaderPair>& headers) {
+        out << quint16(headers.size());
+        for (int i = 0; i < headers.size(); ++i) {
+            out << headers.at(i).first << headers.at(i).second;
+        }
+    }
+
+    void readHeaders(QDataStream& in, QList<QNetworkReply::RawHeaderPair>* headers) {
+        quint16 count = 0;
+        in >> count;
+        for (quint16 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+            QByteArray name, value;
+            in >> name >> value;
+            headers->append(qMakePair(name, value));
+        }
+    }
+}
+
+QByteArray MoPubCapturedExchange::keyFor(QNetworkAccessManager::Operation operation, const QUrl& url){
+    QUrl key(url);
+    for (int i = 0; i < VOLATILE_QUERY_ITEM_COUNT; ++i) {
+        key.removeAllQueryItems(VOLATILE_QUERY_ITEMS[i]);
+    }
+    return QByteArray::number(int(operation)) + ' ' + key.toEncoded();
+}
+
+QDataStream& operator<<(QDataStream& out, const MoPubCapturedExchange& exchange){
+    out << qint32(exchange.operation) << exchange.url;
+    writeHeaders(out, exchange.requestHeaders);
+    out << exchange.startedAt << exchange.duration << qint32(exchange.statusCode) << exchange.reasonPhrase;
+    writeHeaders(out, exchange.responseHeaders);
+    out << qint32(exchange.networkError) << qCompress(exchange.body);
+    return out;
+}
+
+QDataStream& operator>>(QDataStream& in, MoPubCapturedExchange& exchange){
+    qint32 operation = 0, statusCode = 0, networkError = 0;
+    QByteArray body;
+    in >> operation >> exchange.url;
+    readHeaders(in, &exchange.requestHeaders);
+    in >> exchange.startedAt >> exchange.duration >> statusCode >> exchange.reasonPhrase;
+    readHeaders(in, &exchange.responseHeaders);
+    in >> networkError >> body;
+    exchange.operation = static_cast<QNetworkAccessManager::Operation>(operation);
+    exchange.statusCode = statusCode;
+    exchange.networkError = static_cast<QNetworkReply::NetworkError>(networkError);
+    exchange.body = qUncompress(body);
+    return in;
+}
+
+MoPubRecordingNetworkAccessManager::MoPubRecordingNetworkAccessManager(const QString& path, QObject* parent)
+: QNetworkAccessManager(parent)
+, mFile(path)
+{
+    if (mFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        mStream.setDevice(&mFile);
+        mStream.setVersion(QDataStream::Qt_4_8);
+        mStream << CAPTURE_MAGIC << CAPTURE_VERSION;
+        MPLogInfo("Capturing network traffic to %1", path);
+    } else {
+        MPLogWarn("Can't open network capture file %1", path);
+    }
+    mClock.start();
+
+    // Connected before any reply exists, so this runs ahead of every other finished() receiver.
+    bool res = connect(this, SIGNAL(finished(QNetworkReply*)), this, SLOT(onReplyFinished(QNetworkReply*)));
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+}
+
+QNetworkReply* MoPubRecordingNetworkAccessManager::createRequest(Operation op, const QNetworkRequest& request,
+        QIODevice* outgoingData){
+    QNetworkReply* reply = QNetworkAccessManager::createRequest(op, request, outgoingData);
+    reply->setProperty(STARTED_AT_PROPERTY, mClock.elapsed());
+    return reply;
+}
+
+void MoPubRecordingNetworkAccessManager::onReplyFinished(QNetworkReply* reply){
+    if (!mStream.device()) return;
+
+    MoPubCapturedExchange exchange;
+    exchange.operation = reply->operation();
+    exchange.url = reply->request().url().toEncoded();
+    const QList<QByteArray> names = reply->request().rawHeaderList();
+    for (int i = 0; i < names.size(); ++i) {
+        exchange.requestHeaders.append(qMakePair(names.at(i), reply->request().rawHeader(names.at(i))));
+    }
+    exchange.startedAt = reply->property(STARTED_AT_PROPERTY).toLongLong();
+    exchange.duration = mClock.elapsed() - exchange.startedAt;
+    exchange.statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    exchange.reasonPhrase = reply->attribute(QNetworkRequest::HttpReasonPhraseAttribute).toByteArray();
+    exchange.responseHeaders = reply->rawHeaderPairs();
+    exchange.networkError = reply->error();
+    // Peek, the body still belongs to whoever issued the request.
+    exchange.body = reply->peek(reply->bytesAvailable());
+
+    mStream << exchange;
+    mFile.flush();
+}
+
+MoPubReplayNetworkAccessManager::MoPubReplayNetworkAccessManager(const QString& path, double timeScale, QObject* parent)
+: QNetworkAccessManager(parent)
+, mTimeScale(timeScale)
+, mServeEnvelopes(false)
+, mHeaderFormatBytes(0)
+, mEnvelopeBytes(0)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        MPLogWarn("Can't open network replay file %1", path);
+        return;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_8);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (magic != CAPTURE_MAGIC || version != CAPTURE_VERSION) {
+        MPLogWarn("%1 is not a network capture file", path);
+        return;
+    }
+    int count = 0;
+    while (!in.atEnd()) {
+        MoPubCapturedExchange exchange;
+        in >> exchange;
+        if (in.status() != QDataStream::Ok) break;
+        mExchanges[MoPubCapturedExchange::keyFor(exchange.operation, QUrl::fromEncoded(exchange.url))].append(exchange);
+        ++count;
+    }
+    MPLogInfo("Replaying %1 captured exchanges from %2 at time scale %3", count, path, mTimeScale);
+}
+
+QNetworkReply* MoPubReplayNetworkAccessManager::createRequest(Operation op, const QNetworkRequest& request,
+        QIODevice* outgoingData){
+    Q_UNUSED(outgoingData);
+    MoPubCapturedExchange exchange;
+    QList<MoPubCapturedExchange>& queue = mExchanges[MoPubCapturedExchange::keyFor(op, request.url())];
+    if (!queue.isEmpty()) {
+        exchange = queue.takeFirst();
+    } else {
+        MPLogWarn("Nothing captured for %1", request.url());
+        exchange.url = request.url().toEncoded();
+        exchange.statusCode = 404;
+        exchange.reasonPhrase = "Not Found";
+        exchange.networkError = QNetworkReply::ContentNotFoundError;
+    }
+    if (mServeEnvelopes && exchange.statusCode == 200 && request.rawHeader("Accept").contains(MoPubAdEnvelope::CONTENT_TYPE)
+            && !MoPubAdEnvelope::isEnvelope(exchange.responseHeaders)) {
+        envelope(&exchange);
+    }
+    return new MoPubReplayReply(request, op, exchange, int(exchange.duration * mTimeScale), this);
+}
+
+void MoPubReplayNetworkAccessManager::envelope(MoPubCapturedExchange* exchange){
+    qint64 headerFormatBytes = exchange->body.size();
+    QList<QNetworkReply::RawHeaderPair> httpHeaders;
+    for (int i = 0; i < exchange->responseHeaders.size(); ++i) {
+        const QNetworkReply::RawHeaderPair& header = exchange->responseHeaders.at(i);
+        headerFormatBytes += header.first.size() + header.second.size() + 4;
+        if (qstrnicmp(header.first.constData(), "X-", 2) == 0 || qstricmp(header.first.constData(), "Content-Type") == 0
+                || qstricmp(header.first.constData(), "Content-Length") == 0) continue;
+        httpHeaders.append(header);
+    }
+    exchange->body = MoPubAdEnvelope::encode(exchange->responseHeaders, exchange->body);
+    httpHeaders.append(qMakePair(QByteArray("Content-Type"), QByteArray(MoPubAdEnvelope::CONTENT_TYPE)));
+    httpHeaders.append(qMakePair(QByteArray("Content-Length"), QByteArray::number(exchange->body.size())));
+
+    qint64 envelopeBytes = exchange->body.size();
+    for (int i = 0; i < httpHeaders.size(); ++i) envelopeBytes += httpHeaders.at(i).first.size() + httpHeaders.at(i).second.size() + 4;
+    // The HTTP headers both formats share are counted on both sides.
+    mHeaderFormatBytes += headerFormatBytes;
+    mEnvelopeBytes += envelopeBytes;
+    exchange->responseHeaders = httpHeaders;
+    MPLogDebug("Served an envelope of %1 bytes for %2 bytes of headers and body, %3 against %4 so far",
+            envelopeBytes, headerFormatBytes, mEnvelopeBytes, mHeaderFormatBytes);
+}
+
+MoPubReplayReply::MoPubReplayReply(const QNetworkRequest& request, QNetworkAccessManager::Operation operation,
+        const MoPubCapturedExchange& exchange, int delayMilliseconds, QObject* parent)
+: QNetworkReply(parent)
+, mExchange(exchange)
+, mOffset(0)
+, mDelivered(false)
+, mDone(false)
+{
+    setRequest(request);
+    setOperation(operation);
+    setUrl(request.url());
+    QTimer::singleShot(qMax(0, delayMilliseconds), this, SLOT(deliver()));
+}
+
+void MoPubReplayReply::deliver(){
+    if (mDone) return;
+    mDelivered = true;
+    open(QIODevice::ReadOnly);
+    if (mExchange.statusCode > 0) {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, mExchange.statusCode);
+        setAttribute(QNetworkRequest::HttpReasonPhraseAttribute, mExchange.reasonPhrase);
+    }
+    for (int i = 0; i < mExchange.responseHeaders.size(); ++i) {
+        setRawHeader(mExchange.responseHeaders.at(i).first, mExchange.responseHeaders.at(i).second);
+    }
+    emit metaDataChanged();
+    if (!mExchange.body.isEmpty()) {
+        emit downloadProgress(mExchange.body.size(), mExchange.body.size());
+        emit readyRead();
+    }
+    finish(mExchange.networkError, QString());
+}
+
+void MoPubReplayReply::finish(QNetworkReply::NetworkError code, const QString& errorString){
+    mDone = true;
+    if (code != QNetworkReply::NoError) {
+        setError(code, errorString.isEmpty() ? QString("Replayed error %1").arg(int(code)) : errorString);
+        emit error(code);
+    }
+    setFinished(true);
+    emit finished();
+}
+
+void MoPubReplayReply::abort(){
+    if (mDone) return;
+    mExchange.body.clear();
+    finish(QNetworkReply::OperationCanceledError, "Operation canceled");
+}
+
+qint64 MoPubReplayReply::bytesAvailable() const {
+    if (!mDelivered) return QNetworkReply::bytesAvailable();
+    return mExchange.body.size() - mOffset + QNetworkReply::bytesAvailable();
+}
+
+qint64 MoPubReplayReply::readData(char* data, qint64 maxSize){
+    if (!mDelivered) return 0;
+    if (mOffset >= mExchange.body.size()) return mDone ? -1 : 0;
+    qint64 count = qMin(maxSize, mExchange.body.size() - mOffset);
+    memcpy(data, mExchange.body.constData() + mOffset, count);
+    mOffset += count;
+    return count;
+}
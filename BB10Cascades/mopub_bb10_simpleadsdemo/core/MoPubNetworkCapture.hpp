@@ -0,0 +1,117 @@
+#ifndef MOPUBNETWORKCAPTURE_HPP_
+#define MOPUBNETWORKCAPTURE_HPP_
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+/*!
+ * @brief One request and its response as written to a capture log.
+ */
+struct MoPubCapturedExchange {
+    MoPubCapturedExchange() : operation(QNetworkAccessManager::GetOperation), startedAt(0), duration(0),
+            statusCode(0), networkError(QNetworkReply::NoError) {}
+
+    // Key replayed requests are matched on: the volatile query items are left out.
+    static QByteArray keyFor(QNetworkAccessManager::Operation operation, const QUrl& url);
+
+    QNetworkAccessManager::Operation operation;
+    QByteArray url;
+    QList<QNetworkReply::RawHeaderPair> requestHeaders;
+    qint64 startedAt;   // milliseconds since the capture started
+    qint64 duration;    // milliseconds until the reply finished
+    int statusCode;
+    QByteArray reasonPhrase;
+    QList<QNetworkReply::RawHeaderPair> responseHeaders;
+    QNetworkReply::NetworkError networkError;
+    QByteArray body;
+};
+
+QDataStream& operator<<(QDataStream& out, const MoPubCapturedExchange& exchange);
+QDataStream& operator>>(QDataStream& in, MoPubCapturedExchange& exchange);
+
+/*!
+ * @brief Network manager writing every exchange it carries to a capture log.
+ *
+ * Records are appended as the replies finish, before any other receiver reads the
+ * body, with the body compressed.
+ */
+class MoPubRecordingNetworkAccessManager: public QNetworkAccessManager {
+    Q_OBJECT
+public:
+    MoPubRecordingNetworkAccessManager(const QString& path, QObject* parent = 0);
+
+protected:
+    QNetworkReply* createRequest(Operation op, const QNetworkRequest& request, QIODevice* outgoingData = 0);
+
+private Q_SLOTS:
+    void onReplyFinished(QNetworkReply* reply);
+
+private:
+    QFile mFile;
+    QDataStream mStream;
+    QElapsedTimer mClock;
+};
+
+/*!
+ * @brief Local stand-in for the ad server serving a capture log back.
+ *
+ * Requests are matched on MoPubCapturedExchange::keyFor() in the order they were
+ * captured, and answered after the captured duration multiplied by the time scale.
+ * Requests with nothing left to replay get a 404. With envelopes served, requests
+ * accepting MoPubAdEnvelope get their captured X- headers and body repacked into one.
+ */
+class MoPubReplayNetworkAccessManager: public QNetworkAccessManager {
+    Q_OBJECT
+public:
+    MoPubReplayNetworkAccessManager(const QString& path, double timeScale = 1.0, QObject* parent = 0);
+
+    void setServeEnvelopes(bool serve) { mServeEnvelopes = serve; }
+
+protected:
+    QNetworkReply* createRequest(Operation op, const QNetworkRequest& request, QIODevice* outgoingData = 0);
+
+private:
+    void envelope(MoPubCapturedExchange* exchange);
+
+    QHash<QByteArray, QList<MoPubCapturedExchange> > mExchanges;
+    double mTimeScale;
+    bool mServeEnvelopes;
+    qint64 mHeaderFormatBytes;
+    qint64 mEnvelopeBytes;
+};
+
+/*!
+ * @brief Reply handed out by MoPubReplayNetworkAccessManager.
+ */
+class MoPubReplayReply: public QNetworkReply {
+    Q_OBJECT
+public:
+    MoPubReplayReply(const QNetworkRequest& request, QNetworkAccessManager::Operation operation,
+            const MoPubCapturedExchange& exchange, int delayMilliseconds, QObject* parent = 0);
+
+    void abort();
+    qint64 bytesAvailable() const;
+    bool isSequential() const { return true; }
+
+protected:
+    qint64 readData(char* data, qint64 maxSize);
+
+private Q_SLOTS:
+    void deliver();
+
+private:
+    void finish(QNetworkReply::NetworkError code, const QString& errorString);
+
+    MoPubCapturedExchange mExchange;
+    qint64 mOffset;
+    bool mDelivered;
+    bool mDone;
+};
+
+#endif /* MOPUBNETWORKCAPTURE_HPP_ */
@@ -0,0 +1,72 @@
+#include "MoPubNetworkThread.hpp"
+
+#include <QCoreApplication>
+#include <QNetworkAccessManager>
+#include <QScopedPointer>
+
+#include "MoPubAdResponse.hpp"
+#include "MoPubAdStore.hpp"
+#include "MoPubNetworkCapture.hpp"
+
+namespace {
+    QString captureFile;
+    QString replayFile;
+    double replayTimeScale = 1.0;
+
+    QNetworkAccessManager* createNetworkAccessManager() {
+        if (replayFile.isEmpty() && captureFile.isEmpty()) {
+            replayFile = QString::fromLocal8Bit(qgetenv("MOPUB_NETWORK_REPLAY"));
+            captureFile = QString::fromLocal8Bit(qgetenv("MOPUB_NETWORK_CAPTURE"));
+            bool ok = false;
+            double timeScale = qgetenv("MOPUB_NETWORK_REPLAY_TIMESCALE").toDouble(&ok);
+            if (ok) replayTimeScale = timeScale;
+        }
+        if (!replayFile.isEmpty()) {
+            MoPubReplayNetworkAccessManager* replay = new MoPubReplayNetworkAccessManager(replayFile, replayTimeScale);
+            replay->setServeEnvelopes(!qgetenv("MOPUB_NETWORK_REPLAY_ENVELOPE").isEmpty());
+            return replay;
+        }
+        if (!captureFile.isEmpty()) return new MoPubRecordingNetworkAccessManager(captureFile);
+        return new QNetworkAccessManager();
+    }
+}
+
+MoPubNetworkThread* MoPubNetworkThread::instance(){
+    static MoPubNetworkThread* thread = 0;
+    if (!thread) {
+        qRegisterMetaType<MoPubAdResponse>("MoPubAdResponse");
+        qRegisterMetaType<MoPubStoredAd>("MoPubStoredAd");
+        thread = new MoPubNetworkThread();
+        bool res = connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), thread, SLOT(quit()));
+        Q_ASSERT(res);
+        Q_UNUSED(res);
+        thread->start();
+        // Hand out the thread only once its network manager exists.
+        thread->mStarted.acquire();
+    }
+    return thread;
+}
+
+void MoPubNetworkThread::setCaptureFile(const QString& path){
+    captureFile = path;
+}
+
+void MoPubNetworkThread::setReplayFile(const QString& path, double timeScale){
+    replayFile = path;
+    replayTimeScale = timeScale;
+}
+
+MoPubNetworkThread::MoPubNetworkThread()
+: mNetworkAccessManager(0)
+, mReplaying(false)
+{
+}
+
+void MoPubNetworkThread::run(){
+    QScopedPointer<QNetworkAccessManager> networkAccessManager(createNetworkAccessManager());
+    mNetworkAccessManager = networkAccessManager.data();
+    mReplaying = qobject_cast<MoPubReplayNetworkAccessManager*>(mNetworkAccessManager) != 0;
+    mStarted.release();
+    exec();
+    mNetworkAccessManager = 0;
+}
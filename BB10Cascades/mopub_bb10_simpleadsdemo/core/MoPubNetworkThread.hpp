@@ -0,0 +1,44 @@
+#ifndef MOPUBNETWORKTHREAD_HPP_
+#define MOPUBNETWORKTHREAD_HPP_
+
+#include <QSemaphore>
+#include <QThread>
+
+class QNetworkAccessManager;
+class QString;
+
+/*!
+ * @brief The thread all MoPub network I/O and response parsing runs on.
+ *
+ * Owns its own QNetworkAccessManager, created on the thread itself, so replies
+ * are delivered and parsed away from the Cascades UI thread.
+ */
+class MoPubNetworkThread: public QThread {
+    Q_OBJECT
+public:
+    static MoPubNetworkThread* instance();
+
+    // Traffic capture and replay, to be set before the first ad view is created.
+    // MOPUB_NETWORK_CAPTURE, MOPUB_NETWORK_REPLAY and MOPUB_NETWORK_REPLAY_TIMESCALE
+    // in the environment do the same. MOPUB_NETWORK_REPLAY_ENVELOPE=1 has the replay
+    // answer ad requests with MoPubAdEnvelope.
+    static void setCaptureFile(const QString& path);
+    static void setReplayFile(const QString& path, double timeScale = 1.0);
+
+    // Only to be used from objects living on this thread.
+    QNetworkAccessManager* networkAccessManager() const { return mNetworkAccessManager; }
+    // A replay answers every request locally, the device being offline doesn't matter to it.
+    bool isReplaying() const { return mReplaying; }
+
+protected:
+    void run();
+
+private:
+    MoPubNetworkThread();
+
+    QNetworkAccessManager* mNetworkAccessManager;
+    bool mReplaying;
+    QSemaphore mStarted;
+};
+
+#endif /* MOPUBNETWORKTHREAD_HPP_ */
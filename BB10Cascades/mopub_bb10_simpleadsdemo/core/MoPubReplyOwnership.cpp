@@ -0,0 +1,37 @@
+#include "MoPubReplyOwnership.hpp"
+
+#include <QAtomicInt>
+
+namespace {
+    QAtomicInt sLiveReplies;
+    QAtomicInt sTotalReplies;
+}
+
+MoPubReplyOwnership* MoPubReplyOwnership::instance(){
+    static MoPubReplyOwnership ownership;
+    return &ownership;
+}
+
+QNetworkReply* MoPubReplyOwnership::adopt(QNetworkReply* reply, QObject* owner){
+    Q_CHECK_PTR(reply);
+    reply->setParent(owner);
+    sLiveReplies.fetchAndAddRelaxed(1);
+    sTotalReplies.fetchAndAddRelaxed(1);
+    // Direct, replies are destroyed on the network thread and only touch the counter.
+    bool res = connect(reply, SIGNAL(destroyed()), instance(), SLOT(onReplyDestroyed()), Qt::DirectConnection);
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+    return reply;
+}
+
+void MoPubReplyOwnership::onReplyDestroyed(){
+    sLiveReplies.fetchAndAddRelaxed(-1);
+}
+
+int MoPubReplyOwnership::liveCount(){
+    return sLiveReplies;
+}
+
+int MoPubReplyOwnership::totalCount(){
+    return sTotalReplies;
+}
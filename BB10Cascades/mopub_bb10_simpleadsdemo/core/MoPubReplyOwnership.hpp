@@ -0,0 +1,33 @@
+#ifndef MOPUBREPLYOWNERSHIP_HPP_
+#define MOPUBREPLYOWNERSHIP_HPP_
+
+#include <QNetworkReply>
+#include <QObject>
+#include <QScopedPointer>
+
+// Hands a finished reply back to the event loop however the slot handling it returns.
+typedef QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> MoPubScopedReply;
+
+/*!
+ * @brief Single point of ownership for every QNetworkReply the SDK issues.
+ *
+ * adopt() parents the reply to the object that issued it, so replies still pending
+ * go away with it, and counts it until it is destroyed. A live count that keeps
+ * growing over a long session means a path is leaking replies.
+ */
+class MoPubReplyOwnership: public QObject {
+    Q_OBJECT
+public:
+    static QNetworkReply* adopt(QNetworkReply* reply, QObject* owner);
+    static int liveCount();
+    static int totalCount();
+
+private Q_SLOTS:
+    void onReplyDestroyed();
+
+private:
+    MoPubReplyOwnership() {}
+    static MoPubReplyOwnership* instance();
+};
+
+#endif /* MOPUBREPLYOWNERSHIP_HPP_ */
@@ -0,0 +1,186 @@
+#include "MoPubStallWatchdog.hpp"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <QVariantList>
+
+#include <limits.h>
+
+#include "MoPubLogging.hpp"
+#include "MoPubTrace.hpp"
+
+const int MoPubStallWatchdog::HEARTBEAT_INTERVAL_MILLISECONDS = 50;
+// Three frames at 60 fps.
+const int MoPubStallWatchdog::STALL_THRESHOLD_MILLISECONDS = 50;
+const int MoPubStallWatchdog::REPORT_INTERVAL_MILLISECONDS = 60000;
+const int MoPubStallWatchdog::WORST_STALL_COUNT = 10;
+
+namespace {
+    // Upper bounds of the drift histogram buckets.
+    const int BUCKET_LIMITS[] = { 16, 33, 50, 100, 250, 500, 1000, INT_MAX };
+    const int BUCKET_COUNT = sizeof(BUCKET_LIMITS) / sizeof(BUCKET_LIMITS[0]);
+    const qint64 MAXIMUM_LOG_BYTES = 256 * 1024;
+    // Late by more than this the process was suspended, not stalled.
+    const int SUSPENSION_MILLISECONDS = 10000;
+}
+
+MoPubStallWatchdog* MoPubStallWatchdog::instance(){
+    static MoPubStallWatchdog watchdog;
+    return &watchdog;
+}
+
+MoPubStallWatchdog::MoPubStallWatchdog()
+: QObject(0)
+, mHeartbeat(new QTimer(this))
+, mStallCount(0)
+, mOperation(0)
+, mOperationMilliseconds(0)
+{
+    for (int i = 0; i < BUCKET_COUNT; ++i) mHistogram.append(0);
+    mHeartbeat->setInterval(HEARTBEAT_INTERVAL_MILLISECONDS);
+    bool res = connect(mHeartbeat, SIGNAL(timeout()), this, SLOT(onHeartbeat()));
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+}
+
+bool MoPubStallWatchdog::isRunning() const {
+    return mHeartbeat->isActive();
+}
+
+void MoPubStallWatchdog::start(){
+    if (isRunning()) return;
+    mSinceHeartbeat.start();
+    if (!mSinceReport.isValid()) mSinceReport.start();
+    mOperation = 0;
+    mOperationMilliseconds = 0;
+    mHeartbeat->start();
+}
+
+void MoPubStallWatchdog::stop(){
+    mHeartbeat->stop();
+}
+
+void MoPubStallWatchdog::recordOperation(const char* operation, const QString& adUnitId, int milliseconds){
+    if (milliseconds < mOperationMilliseconds) return;
+    mOperation = operation;
+    mOperationAdUnitId = adUnitId;
+    mOperationMilliseconds = milliseconds;
+}
+
+void MoPubStallWatchdog::onHeartbeat(){
+    int drift = qMax(0, int(mSinceHeartbeat.restart()) - HEARTBEAT_INTERVAL_MILLISECONDS);
+    if (drift > SUSPENSION_MILLISECONDS) drift = 0;
+    int bucket = 0;
+    while (drift > BUCKET_LIMITS[bucket]) ++bucket;
+    ++mHistogram[bucket];
+    if (drift >= STALL_THRESHOLD_MILLISECONDS) recordStall(drift);
+
+    mOperation = 0;
+    mOperationAdUnitId.clear();
+    mOperationMilliseconds = 0;
+    if (mSinceReport.elapsed() >= REPORT_INTERVAL_MILLISECONDS) report();
+}
+
+void MoPubStallWatchdog::recordStall(int driftMilliseconds){
+    ++mStallCount;
+    Stall stall;
+    stall.at = QDateTime::currentMSecsSinceEpoch();
+    stall.driftMilliseconds = driftMilliseconds;
+    // Whatever else blocked the loop was not one of ours.
+    stall.operation = mOperation ? QString(mOperation) : QString("unattributed");
+    stall.adUnitId = mOperationAdUnitId;
+    stall.operationMilliseconds = mOperationMilliseconds;
+    MPLogDebug("UI stalled %1 ms during %2 of %3", driftMilliseconds, stall.operation, stall.adUnitId);
+
+    // Kept sorted, worst first.
+    int i = 0;
+    while (i < mWorstStalls.size() && mWorstStalls.at(i).driftMilliseconds >= driftMilliseconds) ++i;
+    if (i >= WORST_STALL_COUNT) return;
+    mWorstStalls.insert(i, stall);
+    if (mWorstStalls.size() > WORST_STALL_COUNT) mWorstStalls.removeLast();
+}
+
+void MoPubStallWatchdog::report(){
+    mSinceReport.restart();
+    if (mStallCount == 0) return;
+
+    QVariantList histogram;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        QVariantMap bucket;
+        bucket.insert("upToMilliseconds", BUCKET_LIMITS[i]);
+        bucket.insert("count", mHistogram.at(i));
+        histogram.append(bucket);
+    }
+    QVariantList worst;
+    foreach (const Stall& stall, mWorstStalls) {
+        QVariantMap entry;
+        entry.insert("driftMilliseconds", stall.driftMilliseconds);
+        entry.insert("operation", stall.operation);
+        entry.insert("adUnitId", stall.adUnitId);
+        entry.insert("operationMilliseconds", stall.operationMilliseconds);
+        entry.insert("at", QDateTime::fromMSecsSinceEpoch(stall.at));
+        worst.append(entry);
+    }
+    QVariantMap report;
+    report.insert("histogram", histogram);
+    report.insert("worst", worst);
+    report.insert("stalls", mStallCount);
+
+    MPLogInfo("%1 UI stalls over %2 ms, worst %3 ms during %4", mStallCount, STALL_THRESHOLD_MILLISECONDS,
+            mWorstStalls.first().driftMilliseconds, mWorstStalls.first().operation);
+    writeLog(report);
+    emit stallReport(report);
+
+    // Each report covers the interval since the previous one.
+    for (int i = 0; i < BUCKET_COUNT; ++i) mHistogram[i] = 0;
+    mWorstStalls.clear();
+    mStallCount = 0;
+}
+
+void MoPubStallWatchdog::writeLog(const QVariantMap& report){
+    QDir().mkpath(QDir::homePath() + "/mopub");
+    QFile file(QDir::homePath() + "/mopub/stalls.log");
+    // Start over rather than grow without bound.
+    QIODevice::OpenMode mode = QIODevice::WriteOnly | QIODevice::Text;
+    mode |= file.size() > MAXIMUM_LOG_BYTES ? QIODevice::Truncate : QIODevice::Append;
+    if (!file.open(mode)) {
+        MPLogWarn("Can't write %1: %2", file.fileName(), file.errorString());
+        return;
+    }
+    QTextStream out(&file);
+    out << QDateTime::currentDateTime().toString(Qt::ISODate) << " stalls " << report.value("stalls").toInt() << "\n";
+    out << "  drift ms:";
+    foreach (const QVariant& bucket, report.value("histogram").toList()) {
+        const QVariantMap map = bucket.toMap();
+        const int limit = map.value("upToMilliseconds").toInt();
+        out << " <=" << (limit == INT_MAX ? QString("inf") : QString::number(limit)) << ":" << map.value("count").toInt();
+    }
+    out << "\n";
+    foreach (const QVariant& stall, report.value("worst").toList()) {
+        const QVariantMap map = stall.toMap();
+        out << "  " << map.value("driftMilliseconds").toInt() << " ms " << map.value("operation").toString()
+            << " (" << map.value("operationMilliseconds").toInt() << " ms) " << map.value("adUnitId").toString()
+            << " at " << map.value("at").toDateTime().toString(Qt::ISODate) << "\n";
+    }
+}
+
+MoPubStallScope::MoPubStallScope(const char* operation, const QString& adUnitId)
+: mOperation(operation)
+, mAdUnitId(adUnitId)
+, mTraceStart(MoPubTrace::isEnabled() ? MoPubTrace::instance()->now() : -1)
+{
+    mTimer.start();
+}
+
+MoPubStallScope::~MoPubStallScope(){
+    // The same operations show as slices of their thread in a trace.
+    if (mTraceStart >= 0) MoPubTrace::instance()->complete(mOperation, mTraceStart, mAdUnitId);
+    MoPubStallWatchdog* watchdog = MoPubStallWatchdog::instance();
+    // Only what blocks the thread the heartbeat runs on.
+    if (!watchdog->isRunning() || QThread::currentThread() != watchdog->thread()) return;
+    watchdog->recordOperation(mOperation, mAdUnitId, mTimer.elapsed());
+}
@@ -0,0 +1,89 @@
+#ifndef MOPUBSTALLWATCHDOG_HPP_
+#define MOPUBSTALLWATCHDOG_HPP_
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QVariantMap>
+
+class QTimer;
+
+/*!
+ * @brief Measures how late the UI event loop runs and blames stalls on the ad operation behind them.
+ *
+ * A heartbeat timer is expected every HEARTBEAT_INTERVAL_MILLISECONDS, whatever it is late
+ * by is time the event loop was blocked. Ad operations on the UI thread are wrapped in
+ * a MoPubStallScope; a stall is tagged with the longest one that ran since the previous
+ * heartbeat. A drift histogram and the worst stalls are reported every minute through
+ * stallReport() and appended to ~/mopub/stalls.log. Lives on the UI thread.
+ */
+class MoPubStallWatchdog: public QObject {
+    Q_OBJECT
+public:
+    static const int HEARTBEAT_INTERVAL_MILLISECONDS;
+    static const int STALL_THRESHOLD_MILLISECONDS;
+    static const int REPORT_INTERVAL_MILLISECONDS;
+    static const int WORST_STALL_COUNT;
+
+    static MoPubStallWatchdog* instance();
+
+    bool isRunning() const;
+    void recordOperation(const char* operation, const QString& adUnitId, int milliseconds);
+
+public Q_SLOTS:
+    void start();
+    void stop();
+    void report();
+
+Q_SIGNALS:
+    // { "histogram": [ { "upToMilliseconds", "count" } ], "worst": [ { "driftMilliseconds",
+    //   "operation", "adUnitId", "operationMilliseconds", "at" } ], "stalls": n }
+    void stallReport(const QVariantMap& report);
+
+private Q_SLOTS:
+    void onHeartbeat();
+
+private:
+    MoPubStallWatchdog();
+
+    struct Stall {
+        qint64 at;
+        int driftMilliseconds;
+        QString operation;
+        QString adUnitId;
+        int operationMilliseconds;
+    };
+    void recordStall(int driftMilliseconds);
+    void writeLog(const QVariantMap& report);
+
+    QTimer* mHeartbeat;
+    QElapsedTimer mSinceHeartbeat;
+    QElapsedTimer mSinceReport;
+    QList<int> mHistogram;
+    QList<Stall> mWorstStalls;
+    int mStallCount;
+    // Longest operation since the previous heartbeat.
+    const char* mOperation;
+    QString mOperationAdUnitId;
+    int mOperationMilliseconds;
+};
+
+/*!
+ * @brief Marks an ad operation on the UI thread for MoPubStallWatchdog, for as long as it is in scope.
+ */
+class MoPubStallScope {
+public:
+    MoPubStallScope(const char* operation, const QString& adUnitId);
+    ~MoPubStallScope();
+
+private:
+    Q_DISABLE_COPY(MoPubStallScope)
+
+    const char* mOperation;
+    QString mAdUnitId;
+    QElapsedTimer mTimer;
+    qint64 mTraceStart;
+};
+
+#endif /* MOPUBSTALLWATCHDOG_HPP_ */
@@ -0,0 +1,149 @@
+#include "MoPubTrace.hpp"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+
+#include "MoPubLogging.hpp"
+
+const int MoPubTrace::MAXIMUM_EVENTS = 200000;
+volatile int MoPubTrace::sEnabled = 0;
+
+namespace {
+    QString escaped(const QString& value) {
+        QString out;
+        out.reserve(value.size());
+        for (int i = 0; i < value.size(); ++i) {
+            const QChar c = value.at(i);
+            if (c == '"' || c == '\\') out.append('\\').append(c);
+            else if (c.unicode() < 0x20) out.append(QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0')));
+            else out.append(c);
+        }
+        return out;
+    }
+}
+
+MoPubTrace* MoPubTrace::instance(){
+    static MoPubTrace trace;
+    return &trace;
+}
+
+MoPubTrace::MoPubTrace()
+: QObject(0)
+, mDroppedCount(0)
+{
+    mClock.start();
+    mQuitPath = QString::fromLocal8Bit(qgetenv("MOPUB_TRACE"));
+    if (mQuitPath.isEmpty()) return;
+    start();
+    if (QCoreApplication::instance()) {
+        bool res = connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(onAboutToQuit()));
+        Q_ASSERT(res);
+        Q_UNUSED(res);
+    }
+}
+
+qint64 MoPubTrace::now() const {
+    return mClock.nsecsElapsed() / 1000;
+}
+
+void MoPubTrace::start(){
+    QMutexLocker lock(&mMutex);
+    mEvents.clear();
+    mThreadNames.clear();
+    mDroppedCount = 0;
+    sEnabled = 1;
+    MPLogInfo("Trace recording started");
+}
+
+void MoPubTrace::stop(){
+    sEnabled = 0;
+}
+
+void MoPubTrace::append(Event& event){
+    const quintptr thread = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    event.thread = thread;
+    QMutexLocker lock(&mMutex);
+    if (mEvents.size() >= MAXIMUM_EVENTS) {
+        ++mDroppedCount;
+        return;
+    }
+    if (!mThreadNames.contains(thread)) {
+        QThread* current = QThread::currentThread();
+        const bool ui = QCoreApplication::instance() && current == QCoreApplication::instance()->thread();
+        mThreadNames.insert(thread, ui ? QString("UI") : QString(current->metaObject()->className()));
+    }
+    mEvents.append(event);
+}
+
+void MoPubTrace::begin(const char* name, const void* placement, const QString& adUnitId, const QString& detail){
+    if (!sEnabled) return;
+    Event event = { name, 'b', now(), 0, reinterpret_cast<quintptr>(placement), 0, adUnitId, detail };
+    append(event);
+}
+
+void MoPubTrace::end(const char* name, const void* placement){
+    if (!sEnabled) return;
+    Event event = { name, 'e', now(), 0, reinterpret_cast<quintptr>(placement), 0, QString(), QString() };
+    append(event);
+}
+
+void MoPubTrace::instant(const char* name, const void* placement, const QString& adUnitId, const QString& detail){
+    if (!sEnabled) return;
+    Event event = { name, 'n', now(), 0, reinterpret_cast<quintptr>(placement), 0, adUnitId, detail };
+    append(event);
+}
+
+void MoPubTrace::complete(const char* name, qint64 startMicros, const QString& adUnitId, const QString& detail){
+    if (!sEnabled) return;
+    const qint64 end = now();
+    Event event = { name, 'X', startMicros, end - startMicros, 0, 0, adUnitId, detail };
+    append(event);
+}
+
+bool MoPubTrace::save(const QString& path){
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        MPLogWarn("Can't write trace %1: %2", path, file.errorString());
+        return false;
+    }
+    QMutexLocker lock(&mMutex);
+    const qint64 pid = QCoreApplication::applicationPid();
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    QHash<quintptr, QString>::const_iterator thread = mThreadNames.constBegin();
+    for (; thread != mThreadNames.constEnd(); ++thread) {
+        if (!first) out << ",\n";
+        first = false;
+        out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid << ",\"tid\":" << thread.key()
+            << ",\"args\":{\"name\":\"" << escaped(thread.value()) << "\"}}";
+    }
+    foreach (const Event& event, mEvents) {
+        if (!first) out << ",\n";
+        first = false;
+        out << "{\"ph\":\"" << event.phase << "\",\"cat\":\"mopub\",\"name\":\"" << event.name
+            << "\",\"pid\":" << pid << ",\"tid\":" << event.thread << ",\"ts\":" << event.timestamp;
+        if (event.phase == 'X') out << ",\"dur\":" << event.duration;
+        // Async events of one placement share a lane.
+        else out << ",\"id\":\"0x" << QString::number(event.placement, 16) << "\"";
+        out << ",\"args\":{";
+        if (!event.adUnitId.isEmpty()) out << "\"adUnitId\":\"" << escaped(event.adUnitId) << "\"";
+        if (!event.detail.isEmpty()) {
+            if (!event.adUnitId.isEmpty()) out << ",";
+            out << "\"detail\":\"" << escaped(event.detail) << "\"";
+        }
+        out << "}}";
+    }
+    out << "\n]}\n";
+    out.flush();
+    MPLogInfo("Trace of %1 events written to %2, %3 dropped", mEvents.size(), path, mDroppedCount);
+    return file.error() == QFile::NoError;
+}
+
+void MoPubTrace::onAboutToQuit(){
+    stop();
+    save(mQuitPath);
+}
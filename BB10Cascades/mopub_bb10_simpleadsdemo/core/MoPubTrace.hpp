@@ -0,0 +1,70 @@
+#ifndef MOPUBTRACE_HPP_
+#define MOPUBTRACE_HPP_
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+
+/*!
+ * @brief Records the ad lifecycle as Chrome trace events, to open a session in chrome://tracing.
+ *
+ * Each placement gets its own async lane, keyed by its ad manager: the load, its fetch states,
+ * queue waits and requests as spans, beacons, refresh timers and creative reports as instants.
+ * Work blocking a thread shows as complete events on that thread. Off by default and then costs
+ * one flag check per event; start() records in memory until save() writes the JSON out.
+ * With MOPUB_TRACE=<path> in the environment recording starts with the first ad manager and
+ * the trace is written to path when the app quits. Thread safe.
+ */
+class MoPubTrace: public QObject {
+    Q_OBJECT
+public:
+    static MoPubTrace* instance();
+    static bool isEnabled() { return sEnabled; }
+
+    // Microseconds on the trace clock, for complete events.
+    qint64 now() const;
+
+    void begin(const char* name, const void* placement, const QString& adUnitId, const QString& detail = QString());
+    void end(const char* name, const void* placement);
+    void instant(const char* name, const void* placement, const QString& adUnitId, const QString& detail = QString());
+    void complete(const char* name, qint64 startMicros, const QString& adUnitId, const QString& detail = QString());
+
+public Q_SLOTS:
+    // Drops whatever was recorded before.
+    void start();
+    void stop();
+    bool save(const QString& path);
+
+private Q_SLOTS:
+    void onAboutToQuit();
+
+private:
+    MoPubTrace();
+
+    static const int MAXIMUM_EVENTS;
+    static volatile int sEnabled;
+
+    struct Event {
+        const char* name;
+        char phase;
+        qint64 timestamp;
+        qint64 duration;
+        quintptr placement;
+        quintptr thread;
+        QString adUnitId;
+        QString detail;
+    };
+    void append(Event& event);
+
+    mutable QMutex mMutex;
+    QElapsedTimer mClock;
+    QList<Event> mEvents;
+    QHash<quintptr, QString> mThreadNames;
+    int mDroppedCount;
+    QString mQuitPath;
+};
+
+#endif /* MOPUBTRACE_HPP_ */
@@ -0,0 +1,73 @@
+#include "MoPubUrlRouter.hpp"
+
+namespace {
+    struct MoPubHostRoute {
+        const char* host;
+        MoPubUrlRouter::Route route;
+    };
+
+    const MoPubHostRoute MOPUB_HOST_ROUTES[] = {
+        { "finishload", MoPubUrlRouter::FinishLoad },
+        { "close",      MoPubUrlRouter::Close },
+        { "failload",   MoPubUrlRouter::FailLoad },
+        { "custom",     MoPubUrlRouter::Custom }
+    };
+    const int MOPUB_HOST_ROUTE_COUNT = sizeof(MOPUB_HOST_ROUTES) / sizeof(MOPUB_HOST_ROUTES[0]);
+
+    inline bool equalsIgnoreCase(const QString& value, const char* latin1) {
+        return QString::compare(value, QLatin1String(latin1), Qt::CaseInsensitive) == 0;
+    }
+}
+
+MoPubUrlRouter::MoPubUrlRouter()
+{
+}
+
+void MoPubUrlRouter::Prefix::compile(const QUrl& prefix){
+    valid = !prefix.isEmpty();
+    if (!valid) {
+        scheme = QString();
+        host = QString();
+        port = -1;
+        path = QString();
+        hasQuery = false;
+        query = QByteArray();
+        return;
+    }
+    scheme = prefix.scheme();
+    host = prefix.host();
+    port = prefix.port();
+    path = prefix.path();
+    hasQuery = prefix.hasQuery();
+    query = prefix.encodedQuery();
+}
+
+bool MoPubUrlRouter::Prefix::matches(const QUrl& url) const {
+    if (!valid) return false;
+    if (url.port() != port) return false;
+    if (QString::compare(url.scheme(), scheme, Qt::CaseInsensitive) != 0) return false;
+    if (QString::compare(url.host(), host, Qt::CaseInsensitive) != 0) return false;
+    // A prefix carrying a query only matches the exact same path followed by that query prefix.
+    if (hasQuery) {
+        return url.path() == path && url.encodedQuery().startsWith(query);
+    }
+    return url.path().startsWith(path);
+}
+
+MoPubUrlRouter::Route MoPubUrlRouter::route(const QUrl& url, const QUrl& adUrl) const {
+    if (mLaunchPage.matches(url)) return LaunchPage;
+
+    const QString scheme = url.scheme();
+    if (equalsIgnoreCase(scheme, "mopub")) {
+        const QString host = url.host();
+        for (int i = 0; i < MOPUB_HOST_ROUTE_COUNT; ++i) {
+            if (equalsIgnoreCase(host, MOPUB_HOST_ROUTES[i].host)) return MOPUB_HOST_ROUTES[i].route;
+        }
+        return MoPubUnknown;
+    }
+
+    if (url == adUrl) return Passthrough;
+    if (mClickThrough.matches(url)) return ClickThrough;
+    if (equalsIgnoreCase(scheme, "http") || equalsIgnoreCase(scheme, "https")) return Browser;
+    return External;
+}
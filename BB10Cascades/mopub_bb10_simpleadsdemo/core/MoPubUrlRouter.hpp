@@ -0,0 +1,56 @@
+#ifndef MOPUBURLROUTER_HPP_
+#define MOPUBURLROUTER_HPP_
+
+#include <QByteArray>
+#include <QString>
+#include <QUrl>
+
+/*!
+ * @brief Precompiled routing table for WebView navigation requests.
+ *
+ * The launch-page and click-through prefixes are split into their URL components
+ * once, when the ad response headers arrive, so each navigation is matched against
+ * the components QUrl already holds instead of building and comparing full strings.
+ */
+class MoPubUrlRouter {
+public:
+    enum Route {
+        Passthrough,    // the ad page itself, let the WebView load it
+        LaunchPage,     // shares the X-Launchpage prefix
+        ClickThrough,   // already points at the X-Clickthrough tracker
+        FinishLoad,     // mopub://finishload
+        Close,          // mopub://close
+        FailLoad,       // mopub://failload
+        Custom,         // mopub://custom
+        MoPubUnknown,   // any other mopub:// host
+        Browser,        // http or https click
+        External        // any other scheme, handed to the invocation framework
+    };
+
+    MoPubUrlRouter();
+
+    void setLaunchPagePrefix(const QUrl& prefix) { mLaunchPage.compile(prefix); }
+    void setClickThroughPrefix(const QUrl& prefix) { mClickThrough.compile(prefix); }
+
+    Route route(const QUrl& url, const QUrl& adUrl) const;
+
+private:
+    struct Prefix {
+        Prefix() : valid(false), port(-1), hasQuery(false) {}
+        void compile(const QUrl& prefix);
+        bool matches(const QUrl& url) const;
+
+        bool valid;
+        QString scheme;
+        QString host;
+        int port;
+        QString path;
+        bool hasQuery;
+        QByteArray query;
+    };
+
+    Prefix mLaunchPage;
+    Prefix mClickThrough;
+};
+
+#endif /* MOPUBURLROUTER_HPP_ */
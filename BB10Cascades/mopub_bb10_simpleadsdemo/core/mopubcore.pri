@@ -0,0 +1,8 @@
+# Platform independent MoPub engine, QtCore and QtNetwork only.
+# Included by the BB10 app, and by mopubcore.pro to build it as a static library.
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+QT += network
+
+SOURCES += $$PWD/*.cpp
+HEADERS += $$PWD/*.hpp
@@ -0,0 +1,10 @@
+# Builds the engine on its own, e.g. on a desktop host:
+#   qmake core/mopubcore.pro && make
+# Its tests are in core/tests.
+TEMPLATE = lib
+TARGET = mopubcore
+
+CONFIG += staticlib warn_on
+QT = core network
+
+include(mopubcore.pri)
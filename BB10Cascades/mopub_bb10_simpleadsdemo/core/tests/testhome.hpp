@@ -0,0 +1,48 @@
+#ifndef TESTHOME_HPP_
+#define TESTHOME_HPP_
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+
+/*!
+ * @brief A $HOME of the test's own, removed again when it goes.
+ *
+ * The stores, caches and logs of the engine all live under ~/mopub, this keeps them out
+ * of the real one. Create it before the first engine object, those read HOME once.
+ */
+class TestHome {
+public:
+    explicit TestHome(const QString& name)
+    : mPath(QDir::tempPath() + QString("/%1-%2").arg(name).arg(QCoreApplication::applicationPid()))
+    , mValid(QDir().mkpath(mPath))
+    {
+        if (mValid) qputenv("HOME", QFile::encodeName(mPath));
+    }
+
+    ~TestHome() {
+        if (mValid) removeDirectory(mPath);
+    }
+
+    bool isValid() const { return mValid; }
+    QString path() const { return mPath; }
+
+    static bool removeDirectory(const QString& path) {
+        QDir dir(path);
+        foreach (const QFileInfo& entry, dir.entryInfoList(QDir::NoDotAndDotDot | QDir::AllEntries | QDir::Hidden)) {
+            if (entry.isDir() && !entry.isSymLink()) removeDirectory(entry.filePath());
+            else QFile::remove(entry.filePath());
+        }
+        return dir.rmdir(path);
+    }
+
+private:
+    Q_DISABLE_COPY(TestHome)
+
+    QString mPath;
+    bool mValid;
+};
+
+#endif /* TESTHOME_HPP_ */
@@ -0,0 +1,9 @@
+# Shared by the engine tests, each one builds the engine sources in.
+QT = core network testlib
+CONFIG += testcase console warn_on
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD
+HEADERS += $$PWD/testhome.hpp
+
+include(../mopubcore.pri)
@@ -0,0 +1,9 @@
+# Desktop tests of the engine, e.g.:
+#   qmake core/tests/tests.pro && make && make check
+TEMPLATE = subdirs
+SUBDIRS = \
+    tst_mopubadenvelope \
+    tst_mopubadmanager \
+    tst_mopubjsonreader \
+    tst_mopublogging \
+    tst_mopubreplyownership
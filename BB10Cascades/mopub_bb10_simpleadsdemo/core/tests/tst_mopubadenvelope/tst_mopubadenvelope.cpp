@@ -0,0 +1,262 @@
+#include <QtTest/QtTest>
+
+#include "MoPubAdEnvelope.hpp"
+
+typedef QList<QNetworkReply::RawHeaderPair> RawHeaders;
+
+// Byte strings with embedded zeros, hex escapes are split so they don't run into the next character.
+#define BYTES(literal) QByteArray(literal, sizeof(literal) - 1)
+
+namespace {
+    QNetworkReply::RawHeaderPair header(const char* name, const QByteArray& value) {
+        return qMakePair(QByteArray(name), value);
+    }
+
+    // A banner response the way the ad server sends it.
+    RawHeaders bannerHeaders() {
+        RawHeaders headers;
+        headers << header("Content-Type", "text/html; charset=UTF-8")
+                << header("X-Adtype", "html")
+                << header("X-Networktype", "mopub")
+                << header("X-Clickthrough", "http://ads.mopub.com/m/aclk?appid=&cid=4652bd83d89a11e2&city=Waterloo"
+                        "&ckv=2&country_code=CA&cppck=8D2CC&dev=BlackBerry&id=agltb3B1Yi1pbmNyDAsSBFNpdGUY8fgRDA"
+                        "&is_mraid=0&os=BlackBerry+10&req=0d8f0c3f3c2a4a9c&reqt=1381425600.0&rev=0&udid=sha%3A")
+                << header("X-Failurl", "http://ads.mopub.com/m/ad?v=8&id=agltb3B1Yi1pbmNyDAsSBFNpdGUY8fgRDA"
+                        "&nv=1.17.0.0&udid=sha%3A&exclude=4652bd83d89a11e2&request_id=0d8f0c3f3c2a4a9c")
+                << header("X-Imptracker", "http://ads.mopub.com/m/imp?appid=&cid=4652bd83d89a11e2&city=Waterloo"
+                        "&ckv=2&country_code=CA&dev=BlackBerry&id=agltb3B1Yi1pbmNyDAsSBFNpdGUY8fgRDA&req=0d8f0c3f")
+                << header("X-Width", "320")
+                << header("X-Height", "50")
+                << header("X-Refreshtime", "30")
+                << header("X-Scrollable", "0")
+                << header("X-Interceptlinks", "1")
+                << header("X-Backfill", "clear");
+        return headers;
+    }
+
+    QByteArray bannerBody() {
+        QByteArray body = "<html><head><meta name=\"viewport\" content=\"width=320\"></head><body style=\"margin:0\">";
+        body += "<a href=\"http://ads.mopub.com/m/aclk?r=http%3A%2F%2Fexample.com%2Flanding\">";
+        body += "<img src=\"http://cdn.example.com/creatives/320x50.png\" width=\"320\" height=\"50\"></a>";
+        body += "</body></html>";
+        return body;
+    }
+
+    RawHeaders xHeaders(const RawHeaders& headers) {
+        RawHeaders out;
+        foreach (const QNetworkReply::RawHeaderPair& pair, headers) {
+            if (pair.first.startsWith("X-")) out.append(pair);
+        }
+        return out;
+    }
+
+    // Copies, decode() hands out views.
+    RawHeaders deepCopy(const RawHeaders& headers) {
+        RawHeaders out;
+        foreach (const QNetworkReply::RawHeaderPair& pair, headers) {
+            out.append(qMakePair(QByteArray(pair.first.constData(), pair.first.size()),
+                    QByteArray(pair.second.constData(), pair.second.size())));
+        }
+        return out;
+    }
+
+    // What the same response costs as HTTP headers: "Name: value\r\n" each, then the body.
+    QByteArray headerFormat(const RawHeaders& headers, const QByteArray& body) {
+        QByteArray out;
+        foreach (const QNetworkReply::RawHeaderPair& pair, headers) {
+            out += pair.first + ": " + pair.second + "\r\n";
+        }
+        out += "\r\n";
+        out += body;
+        return out;
+    }
+
+    // The work the HTTP stack does to hand the same metadata over as header pairs.
+    RawHeaders parseHeaderFormat(const QByteArray& data, QByteArray* body) {
+        RawHeaders headers;
+        int pos = 0;
+        for (;;) {
+            const int end = data.indexOf("\r\n", pos);
+            if (end < 0 || end == pos) {
+                pos = end < 0 ? data.size() : end + 2;
+                break;
+            }
+            const int colon = data.indexOf(':', pos);
+            headers.append(qMakePair(data.mid(pos, colon - pos), data.mid(colon + 1, end - colon - 1).trimmed()));
+            pos = end + 2;
+        }
+        *body = data.mid(pos);
+        return headers;
+    }
+}
+
+/*!
+ * @brief MoPubAdEnvelope round trips, limits and malformed input, and its size and decode time
+ * against the same response sent as HTTP headers.
+ */
+class tst_MoPubAdEnvelope: public QObject {
+    Q_OBJECT
+
+private Q_SLOTS:
+    void roundTrip();
+    void tagsIgnoreCase();
+    void emptyEnvelope();
+    void oversizedHeaderIsDropped();
+    void fieldCountIsCapped();
+    void decodedViewsOutliveTheInput();
+    void isEnvelope_data();
+    void isEnvelope();
+    void malformed_data();
+    void malformed();
+    void bytes();
+    void benchmarkDecode();
+    void benchmarkHeaderFormat();
+};
+
+void tst_MoPubAdEnvelope::roundTrip(){
+    const RawHeaders headers = bannerHeaders();
+    const QByteArray body = bannerBody();
+    MoPubAdEnvelope envelope;
+    QVERIFY(envelope.decode(MoPubAdEnvelope::encode(headers, body)));
+    // Only the X- headers, in their order, untagged ones with their own names.
+    QCOMPARE(deepCopy(envelope.headers), xHeaders(headers));
+    QCOMPARE(envelope.body, body);
+}
+
+void tst_MoPubAdEnvelope::tagsIgnoreCase(){
+    RawHeaders headers;
+    headers << header("x-adtype", "html") << header("x-custom", "value");
+    MoPubAdEnvelope envelope;
+    QVERIFY(envelope.decode(MoPubAdEnvelope::encode(headers, QByteArray())));
+    QCOMPARE(envelope.headers.size(), 2);
+    // Tagged headers come back with the name the SDK looks for, others as they were sent.
+    QCOMPARE(envelope.headers.at(0).first, QByteArray("X-Adtype"));
+    QCOMPARE(envelope.headers.at(0).second, QByteArray("html"));
+    QCOMPARE(envelope.headers.at(1).first, QByteArray("x-custom"));
+}
+
+void tst_MoPubAdEnvelope::emptyEnvelope(){
+    MoPubAdEnvelope envelope;
+    const QByteArray data = MoPubAdEnvelope::encode(RawHeaders(), QByteArray());
+    QCOMPARE(data, BYTES("MPE\x01\x00" "\x00\x00\x00\x00"));
+    QVERIFY(envelope.decode(data));
+    QVERIFY(envelope.headers.isEmpty());
+    QVERIFY(envelope.body.isEmpty());
+}
+
+void tst_MoPubAdEnvelope::oversizedHeaderIsDropped(){
+    RawHeaders headers;
+    headers << header("X-Adtype", "html")
+            << header("X-Nativeparams", QByteArray(0x10000, 'a'))
+            << header("X-Customselector", QByteArray(0xffff, 'b'))
+            << header("X-Width", "320");
+    MoPubAdEnvelope envelope;
+    QVERIFY(envelope.decode(MoPubAdEnvelope::encode(headers, "body")));
+    // A u16 length can't carry it, the fields around it are intact.
+    QCOMPARE(envelope.headers.size(), 3);
+    QCOMPARE(envelope.headers.at(0).first, QByteArray("X-Adtype"));
+    QCOMPARE(envelope.headers.at(1).first, QByteArray("X-Customselector"));
+    QCOMPARE(envelope.headers.at(1).second.size(), 0xffff);
+    QCOMPARE(envelope.headers.at(2).first, QByteArray("X-Width"));
+    QCOMPARE(envelope.headers.at(2).second, QByteArray("320"));
+    QCOMPARE(envelope.body, QByteArray("body"));
+}
+
+void tst_MoPubAdEnvelope::fieldCountIsCapped(){
+    RawHeaders headers;
+    for (int i = 0; i < 300; ++i) headers << qMakePair("X-Field-" + QByteArray::number(i), QByteArray::number(i));
+    MoPubAdEnvelope envelope;
+    QVERIFY(envelope.decode(MoPubAdEnvelope::encode(headers, "body")));
+    QCOMPARE(envelope.headers.size(), 255);
+    QCOMPARE(deepCopy(envelope.headers), headers.mid(0, 255));
+    QCOMPARE(envelope.body, QByteArray("body"));
+}
+
+void tst_MoPubAdEnvelope::decodedViewsOutliveTheInput(){
+    MoPubAdEnvelope envelope;
+    {
+        QByteArray data = MoPubAdEnvelope::encode(bannerHeaders(), bannerBody());
+        QVERIFY(envelope.decode(data));
+        data.fill('x');
+    }
+    QCOMPARE(deepCopy(envelope.headers), xHeaders(bannerHeaders()));
+    QCOMPARE(envelope.body, bannerBody());
+}
+
+void tst_MoPubAdEnvelope::isEnvelope_data(){
+    QTest::addColumn<QByteArray>("name");
+    QTest::addColumn<QByteArray>("value");
+    QTest::addColumn<bool>("envelope");
+
+    QTest::newRow("envelope") << QByteArray("Content-Type") << QByteArray(MoPubAdEnvelope::CONTENT_TYPE) << true;
+    QTest::newRow("parameters and case") << QByteArray("content-type")
+            << QByteArray(" Application/X-MoPub-Envelope; version=1") << true;
+    QTest::newRow("html") << QByteArray("Content-Type") << QByteArray("text/html") << false;
+    QTest::newRow("no content type") << QByteArray("X-Adtype") << QByteArray(MoPubAdEnvelope::CONTENT_TYPE) << false;
+}
+
+void tst_MoPubAdEnvelope::isEnvelope(){
+    QFETCH(QByteArray, name);
+    QFETCH(QByteArray, value);
+    QFETCH(bool, envelope);
+    RawHeaders headers;
+    headers << qMakePair(name, value);
+    QCOMPARE(MoPubAdEnvelope::isEnvelope(headers), envelope);
+}
+
+void tst_MoPubAdEnvelope::malformed_data(){
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("html") << bannerBody();
+    QTest::newRow("bad magic") << BYTES("MPX\x01\x00" "\x00\x00\x00\x00");
+    QTest::newRow("bad version") << BYTES("MPE\x02\x00" "\x00\x00\x00\x00");
+    QTest::newRow("no body length") << BYTES("MPE\x01\x00" "\x00\x00");
+    QTest::newRow("field past the end") << BYTES("MPE\x01\x01" "\x01" "\x00\x05" "html");
+    QTest::newRow("name past the end") << BYTES("MPE\x01\x01" "\x00" "\x08" "X-A");
+    QTest::newRow("unknown tag") << BYTES("MPE\x01\x01" "\xc8" "\x00\x00" "\x00\x00\x00\x00");
+    QTest::newRow("missing fields") << BYTES("MPE\x01\x03" "\x01" "\x00\x04" "html" "\x00\x00\x00\x00");
+    QTest::newRow("body past the end") << BYTES("MPE\x01\x00" "\x00\x00\x00\x10" "body");
+    QTest::newRow("trailing bytes") << BYTES("MPE\x01\x00" "\x00\x00\x00\x04" "body" "x");
+}
+
+void tst_MoPubAdEnvelope::malformed(){
+    QFETCH(QByteArray, data);
+    MoPubAdEnvelope envelope;
+    QVERIFY(!envelope.decode(data));
+}
+
+void tst_MoPubAdEnvelope::bytes(){
+    // Counted the way the replay counts what it serves: every header as "Name: value\r\n" plus the body.
+    const RawHeaders headers = bannerHeaders();
+    const QByteArray body = bannerBody();
+    const int headerFormatBytes = headerFormat(headers, body).size();
+    RawHeaders httpHeaders;
+    httpHeaders << header("Content-Type", MoPubAdEnvelope::CONTENT_TYPE);
+    const QByteArray envelope = MoPubAdEnvelope::encode(headers, body);
+    httpHeaders << header("Content-Length", QByteArray::number(envelope.size()));
+    const int envelopeBytes = headerFormat(httpHeaders, envelope).size();
+    qDebug("Banner response: %d bytes as headers, %d as an envelope", headerFormatBytes, envelopeBytes);
+    QVERIFY(envelopeBytes < headerFormatBytes);
+}
+
+void tst_MoPubAdEnvelope::benchmarkDecode(){
+    const QByteArray data = MoPubAdEnvelope::encode(bannerHeaders(), bannerBody());
+    QBENCHMARK {
+        MoPubAdEnvelope envelope;
+        QVERIFY(envelope.decode(data));
+    }
+}
+
+void tst_MoPubAdEnvelope::benchmarkHeaderFormat(){
+    const RawHeaders headers = bannerHeaders();
+    const QByteArray data = headerFormat(headers, bannerBody());
+    QByteArray body;
+    QBENCHMARK {
+        QCOMPARE(parseHeaderFormat(data, &body).size(), headers.size());
+    }
+    QCOMPARE(body, bannerBody());
+}
+
+QTEST_MAIN(tst_MoPubAdEnvelope)
+#include "tst_mopubadenvelope.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_mopubadenvelope
+TEMPLATE = app
+
+SOURCES += tst_mopubadenvelope.cpp
+
+include(../tests.pri)
@@ -0,0 +1,419 @@
+#include <QtTest/QtTest>
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+
+#include "MoPubAdManager.hpp"
+#include "MoPubAdPlacementManager.hpp"
+#include "MoPubNetworkCapture.hpp"
+#include "MoPubNetworkThread.hpp"
+#include "testhome.hpp"
+
+namespace {
+    const int WAIT_MILLISECONDS = 5000;
+
+    const QByteArray SCRIPT_CREATIVE = "<html><body><script>document.title = 'ad';</script></body></html>";
+    const QByteArray STATIC_CREATIVE = "<html><body><img src=\"http://example.com/ad.png\"></body></html>";
+    const QByteArray NETWORK_ERROR_FAILOVER_URL = "http://ads.mopub.com/m/ad?v=8&id=tst-network-error&exclude=tst";
+
+    class StubEnvironment: public MoPubAdEnvironment {
+    public:
+        QString userAgent() const { return QString("MoPubTest/1.0"); }
+        QString udid() const { return QString("tst-udid"); }
+        QString installId() const { return QString("tst-install"); }
+    };
+
+    bool waitForState(const MoPubAdManager& manager, MoPubAdManager::FetchState state) {
+        QElapsedTimer timer;
+        timer.start();
+        while (manager.fetchState() != state && timer.elapsed() < WAIT_MILLISECONDS) QTest::qWait(10);
+        return manager.fetchState() == state;
+    }
+
+    bool waitForCount(const QSignalSpy& spy, int count) {
+        QElapsedTimer timer;
+        timer.start();
+        while (spy.count() < count && timer.elapsed() < WAIT_MILLISECONDS) QTest::qWait(10);
+        return spy.count() >= count;
+    }
+}
+
+/*!
+ * @brief Drives MoPubAdManager through its fetch states against a replayed ad server.
+ */
+class tst_MoPubAdManager: public QObject {
+    Q_OBJECT
+public:
+    tst_MoPubAdManager() : mHome("tst_mopubadmanager") {}
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void scriptCreativeRendersUntilFinishload();
+    void staticCreativeCompletesRightAway();
+    void storedAdIsShownWithoutALoad();
+    void failuresBackOff_data();
+    void failuresBackOff();
+    void failloadFailsTheLoad();
+    void networkErrorFailsOverOnce();
+    void refreshRetriesAfterBackoff();
+    void suspendedRefreshWaitsForResume();
+    void duplicateLoadIsSuppressed();
+    void renderTimeoutCompletesTheLoad();
+    void fetchTimeoutReleasesTheSlot();
+    void cancelDropsTheReplyAndRefreshes();
+    void unitChangeRestartsTheLoad();
+
+private:
+    MoPubCapturedExchange exchange(const QString& adUnitId, int statusCode, const QByteArray& adType,
+            const QByteArray& body, qint64 durationMilliseconds);
+
+    StubEnvironment mEnvironment;
+    TestHome mHome;
+};
+
+MoPubCapturedExchange tst_MoPubAdManager::exchange(const QString& adUnitId, int statusCode,
+        const QByteArray& adType, const QByteArray& body, qint64 durationMilliseconds){
+    MoPubCapturedExchange exchange;
+    exchange.url = MoPubAdManager::adRequestUrl(adUnitId, &mEnvironment).toEncoded();
+    exchange.duration = durationMilliseconds;
+    exchange.statusCode = statusCode;
+    exchange.reasonPhrase = statusCode == 200 ? "OK" : "Internal Server Error";
+    if (!adType.isEmpty()) exchange.responseHeaders.append(qMakePair(QByteArray("X-Adtype"), adType));
+    exchange.responseHeaders.append(qMakePair(QByteArray("Content-Type"), QByteArray("text/html")));
+    exchange.body = body;
+    return exchange;
+}
+
+void tst_MoPubAdManager::initTestCase(){
+    QVERIFY(mHome.isValid());
+
+    const QString replayPath = mHome.path() + "/replay.mpnc";
+    QFile file(replayPath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_8);
+    out << quint32(0x4d504e43) << quint16(1);
+    out << exchange("tst-script", 200, "html", SCRIPT_CREATIVE, 0);
+    out << exchange("tst-static", 200, "html", STATIC_CREATIVE, 0);
+    out << exchange("tst-clear", 200, "clear", QByteArray(), 0);
+    out << exchange("tst-server-error", 500, QByteArray(), QByteArray(), 0);
+    out << exchange("tst-failload", 200, "html", SCRIPT_CREATIVE, 0);
+    // A no fill naming a failover that never gets an answer.
+    MoPubCapturedExchange noFill = exchange("tst-network-error", 200, "clear", QByteArray(), 0);
+    noFill.responseHeaders.append(qMakePair(QByteArray("X-Failurl"), NETWORK_ERROR_FAILOVER_URL));
+    out << noFill;
+    MoPubCapturedExchange unreachable;
+    unreachable.url = NETWORK_ERROR_FAILOVER_URL;
+    unreachable.networkError = QNetworkReply::ConnectionRefusedError;
+    out << unreachable;
+    out << exchange("tst-backoff", 500, QByteArray(), QByteArray(), 0);
+    out << exchange("tst-suspend", 200, "html", STATIC_CREATIVE, 0);
+    out << exchange("tst-suspend", 200, "html", SCRIPT_CREATIVE, 0);
+    out << exchange("tst-duplicate", 200, "html", SCRIPT_CREATIVE, 200);
+    out << exchange("tst-render-timeout", 200, "html", SCRIPT_CREATIVE, 0);
+    out << exchange("tst-stalled", 200, "html", SCRIPT_CREATIVE, 60000);
+    out << exchange("tst-queued", 200, "html", STATIC_CREATIVE, 0);
+    out << exchange("tst-cancel", 200, "html", SCRIPT_CREATIVE, 300);
+    out << exchange("tst-unit-a", 200, "html", SCRIPT_CREATIVE, 300);
+    out << exchange("tst-unit-b", 200, "html", STATIC_CREATIVE, 0);
+    file.close();
+    MoPubNetworkThread::setReplayFile(replayPath);
+}
+
+void tst_MoPubAdManager::scriptCreativeRendersUntilFinishload(){
+    MoPubAdManager manager(&mEnvironment);
+    manager.setAutoRefreshEnabled(false);
+    QSignalSpy willLoad(&manager, SIGNAL(adWillLoad(QUrl)));
+    QSignalSpy didLoad(&manager, SIGNAL(adDidLoad()));
+    QSignalSpy htmlReady(&manager, SIGNAL(htmlReady(QString, QUrl)));
+
+    manager.setAdUnitId("tst-script");
+    QCOMPARE(manager.fetchState(), MoPubAdManager::Idle);
+    manager.loadAd();
+    QCOMPARE(manager.fetchState(), MoPubAdManager::Requesting);
+    QVERIFY(manager.isLoading());
+    QCOMPARE(willLoad.count(), 1);
+
+    QVERIFY(waitForState(manager, MoPubAdManager::Rendering));
+    QCOMPARE(htmlReady.count(), 1);
+    QCOMPARE(manager.creativeKind(), MoPubCreativeClassifier::Dynamic);
+    QVERIFY(manager.isLoading());
+    QCOMPARE(didLoad.count(), 0);
+
+    QCOMPARE(manager.navigate(QUrl("mopub://finishload")), MoPubUrlRouter::FinishLoad);
+    QCOMPARE(manager.fetchState(), MoPubAdManager::Idle);
+    QVERIFY(!manager.isLoading());
+    QCOMPARE(didLoad.count(), 1);
+}
+
+void tst_MoPubAdManager::staticCreativeCompletesRightAway(){
+    MoPubAdManager manager(&mEnvironment);
+    manager.setAutoRefreshEnabled(false);
+    QSignalSpy didLoad(&manager, SIGNAL(adDidLoad()));
+    QSignalSpy htmlReady(&manager, SIGNAL(htmlReady(QString, QUrl)));
+
+    manager.setAdUnitId("tst-static");
+    manager.loadAd();
+    // Rendered without scripts, it never reports finishload.
+    QVERIFY(waitForCount(didLoad, 1));
+    QCOMPARE(manager.fetchState(), MoPubAdManager::Idle);
+    QCOMPARE(htmlReady.count(), 1);
+    QVERIFY(manager.creativeKind() != MoPubCreativeClassifier::Dynamic);
+}
+
+void tst_MoPubAdManager::storedAdIsShownWithoutALoad(){
+    {
+        MoPubAdManager manager(&mEnvironment);
+        manager.setAutoRefreshEnabled(false);
+        QSignalSpy didLoad(&manager, SIGNAL(adDidLoad()));
+        manager.setAdUnitId("tst-static");
+        manager.loadAd();
+        QVERIFY(waitForCount(didLoad, 1));
+    }
+
+    MoPubAdManager manager(&mEnvironment);
+    manager.setAutoRefreshEnabled(false);
+    QSignalSpy willLoad(&manager, SIGNAL(adWillLoad(QUrl)));
+    QSignalSpy htmlReady(&manager, SIGNAL(htmlReady(QString, QUrl)));
+    manager.setAdUnitId("tst-static");
+    // Read on the network thread, after the save queued there before it.
+    QCOMPARE(htmlReady.count(), 0);
+    QVERIFY(waitForCount(htmlReady, 1));
+    QCOMPARE(htmlReady.first().first().toString(), QString::fromUtf8(STATIC_CREATIVE));
+    QCOMPARE(willLoad.count(), 0);
+    QCOMPARE(manager.fetchState(), MoPubAdManager::Idle);
+}
+
+void tst_MoPubAdManager::failuresBackOff_data(){
+    QTest::addColumn<QString>("adUnitId");
+    QTest::newRow("no fill") << "tst-clear";
+    QTest::newRow("server error") << "tst-server-error";
+}
+
+void tst_MoPubAdManager::failuresBackOff(){
+    QFETCH(QString, adUnitId);
+    MoPubAdManager manager(&mEnvironment);
+    manager.setAutoRefreshEnabled(false);
+    QSignalSpy failed(&manager, SIGNAL(adFailed()));
+    QSignalSpy didLoad(&manager, SIGNAL(adDidLoad()));
+
+    manager.setAdUnitId(adUnitId);
+    manager.loadAd();
+    QVERIFY(waitForCount(failed, 1));
+    QCOMPARE(manager.fetchState(), MoPubAdManager::Backoff);
+    QVERIFY(!manager.isLoading());
+    QCOMPARE(didLoad.count(), 0);
+}
+
+void tst_MoPubAdManager::failloadFailsTheLoad(){
+    MoPubAdManager manager(&mEnvironment);
+    manager.setAutoRefreshEnabled(false);
+    QSignalSpy failed(&manager, SIGNAL(adFailed()));
+    QSignalSpy didLoad(&manager, SIGNAL(adDidLoad()));
+
+    manager.setAdUnitId("tst-failload");
+    manager.loadAd();
+    QVERIFY(waitForState(manager, MoPubAdManager::Rendering));
+    // No X-Failurl, nothing to fail over to.
+    QCOMPARE(manager.navigate(QUrl("mopub://failload")), MoPubUrlRouter::FailLoad);
+    QCOMPARE(manager.fetchState(), MoPubAdManager::Backoff);
+    QCOMPARE(failed.count(), 1);
+    QCOMPARE(didLoad.count(), 0);
+}
+
+void tst_MoPubAdManager::networkErrorFailsOverOnce(){
+    MoPubAdManager manager(&mEnvironment);
+    manager.setAutoRefreshEnabled(false);
+    QSignalSpy willLoad(&manager, SIGNAL(adWillLoad(QUrl)));
+    QSignalSpy failed(&manager, SIGNAL(adFailed()));
+
+    manager.setAdUnitId("tst-network-error");
+    manager.loadAd();
+    QVERIFY(waitForCount(failed, 1));
+    // The no fill fails over once, the network error of the failover ends the load.
+    QCOMPARE(willLoad.count(), 2);
+    QCOMPARE(willLoad.last().first().toUrl(), QUrl::fromEncoded(NETWORK_ERROR_FAILOVER_URL));
+    QCOMPARE(manager.fetchState(), MoPubAdManager::Backoff);
+    // Reported through error() and finished(), it must still count once.
+    QTest::qWait(200);
+    QCOMPARE(failed.count(), 1);
+    QCOMPARE(willLoad.count(), 2);
+    QCOMPARE(manager.discardedReplyCount(), 0);
+}
+
+void tst_MoPubAdManager::refreshRetriesAfterBackoff(){
+    MoPubAdManager manager(&mEnvironment);
+    QSignalSpy willLoad(&manager, SIGNAL(adWillLoad(QUrl)));
+    QSignalSpy failed(&manager, SIGNAL(adFailed()));
+
+    manager.setAdUnitId("tst-backoff");
+    manager.setRefreshTimeMilliseconds(200);
+    manager.loadAd();
+    QVERIFY(waitForCount(failed, 1));
+    QCOMPARE(manager.fetchState(), MoPubAdManager::Backoff);
+    QCOMPARE(willLoad.count(), 1);
+    QCOMPARE(manager.refreshTimeMilliseconds(), 300);
+
+    // The refresh timer starts the next load, nothing else would.
+    QVERIFY(waitForCount(willLoad, 2));
+    QVERIFY(manager.fetchState() == MoPubAdManager::Requesting || failed.count() == 2);
+    manager.setAutoRefreshEnabled(false);
+    QVERIFY(waitForCount(failed, 2));
+    QCOMPARE(manager.fetchState(), MoPubAdManager::Backoff);
+}
+
+void tst_MoPubAdManager::suspendedRefreshWaitsForResume(){
+    MoPubAdManager manager(&mEnvironment);
+    QSignalSpy willLoad(&manager, SIGNAL(adWillLoad(QUrl)));
+    QSignalSpy didLoad(&manager, SIGNAL(adDidLoad()));
+    QSignalSpy htmlReady(&manager, SIGNAL(htmlReady(QString, QUrl)));
+
+    manager.setAdUnitId("tst-suspend");
+    manager.setRefreshTimeMilliseconds(200);
+    manager.loadAd();
+    QVERIFY(waitForCount(didLoad, 1));
+    // What MoPubView does once it evicted its WebView.
+    manager.setRefreshSuspended(true);
+    QTest::qWait(600);
+    QCOMPARE(willLoad.count(), 1);
+    QCOMPARE(htmlReady.count(), 1);
+    // Toggling auto refresh must not bring it back either.
+    manager.setAutoRefreshEnabled(false);
+    manager.setAutoRefreshEnabled(true);
+    QTest::qWait(300);
+    QCOMPARE(willLoad.count(), 1);
+
+    manager.setRefreshSuspended(false);
+    QVERIFY(waitForCount(willLoad, 2));
+    QVERIFY(waitForCount(htmlReady, 2));
+    manager.setAutoRefreshEnabled(false);
+}
+
+void tst_MoPubAdManager::duplicateLoadIsSuppressed(){
+    MoPubAdManager manager(&mEnvironment);
+    manager.setAutoRefreshEnabled(false);
+    QSignalSpy willLoad(&manager, SIGNAL(adWillLoad(QUrl)));
+    QSignalSpy htmlReady(&manager, SIGNAL(htmlReady(QString, QUrl)));
+
+    manager.setAdUnitId("tst-duplicate");
+    manager.loadAd();
+    manager.loadAd();
+    QCOMPARE(manager.suppressedLoadCount(), 1);
+    QCOMPARE(willLoad.count(), 1);
+    QVERIFY(waitForState(manager, MoPubAdManager::Rendering));
+    // Still rendering, the creative hasn't reported back.
+    manager.loadAd();
+    QCOMPARE(manager.suppressedLoadCount(), 2);
+    manager.navigate(QUrl("mopub://finishload"));
+    QTest::qWait(100);
+    QCOMPARE(htmlReady.count(), 1);
+    QCOMPARE(willLoad.count(), 1);
+}
+
+void tst_MoPubAdManager::renderTimeoutCompletesTheLoad(){
+    MoPubAdManager manager(&mEnvironment);
+    manager.setAutoRefreshEnabled(false);
+    manager.setRenderTimeoutMilliseconds(100);
+    QCOMPARE(manager.renderTimeoutMilliseconds(), 100);
+    QSignalSpy didLoad(&manager, SIGNAL(adDidLoad()));
+    QSignalSpy failed(&manager, SIGNAL(adFailed()));
+
+    manager.setAdUnitId("tst-render-timeout");
+    manager.loadAd();
+    QVERIFY(waitForState(manager, MoPubAdManager::Rendering));
+    QCOMPARE(didLoad.count(), 0);
+    // The creative never reports finishload.
+    QVERIFY(waitForCount(didLoad, 1));
+    QCOMPARE(manager.fetchState(), MoPubAdManager::Idle);
+    QVERIFY(!manager.isLoading());
+    QCOMPARE(failed.count(), 0);
+}
+
+void tst_MoPubAdManager::fetchTimeoutReleasesTheSlot(){
+    MoPubAdPlacementManager* placements = MoPubAdPlacementManager::instance();
+    const int maximumConcurrentFetches = placements->maximumConcurrentFetches();
+    placements->setMaximumConcurrentFetches(1);
+
+    MoPubAdManager stalled(&mEnvironment);
+    stalled.setAutoRefreshEnabled(false);
+    stalled.setFetchTimeoutMilliseconds(300);
+    QSignalSpy stalledFailed(&stalled, SIGNAL(adFailed()));
+    MoPubAdManager queued(&mEnvironment);
+    queued.setAutoRefreshEnabled(false);
+    QSignalSpy queuedDidLoad(&queued, SIGNAL(adDidLoad()));
+
+    stalled.setAdUnitId("tst-stalled");
+    stalled.loadAd();
+    queued.setAdUnitId("tst-queued");
+    queued.loadAd();
+    // The only slot is held by a reply that takes a minute.
+    QTest::qWait(150);
+    QCOMPARE(queuedDidLoad.count(), 0);
+    QCOMPARE(queued.fetchState(), MoPubAdManager::Requesting);
+
+    QVERIFY(waitForCount(stalledFailed, 1));
+    QCOMPARE(stalled.fetchState(), MoPubAdManager::Backoff);
+    // Aborted at the deadline, the slot goes to the waiting placement.
+    QVERIFY(waitForCount(queuedDidLoad, 1));
+    QCOMPARE(stalledFailed.count(), 1);
+    placements->setMaximumConcurrentFetches(maximumConcurrentFetches);
+}
+
+void tst_MoPubAdManager::cancelDropsTheReplyAndRefreshes(){
+    MoPubAdManager manager(&mEnvironment);
+    manager.setRefreshTimeMilliseconds(200);
+    QSignalSpy willLoad(&manager, SIGNAL(adWillLoad(QUrl)));
+    QSignalSpy htmlReady(&manager, SIGNAL(htmlReady(QString, QUrl)));
+
+    manager.setAdUnitId("tst-cancel");
+    manager.loadAd();
+    // Granted and on its way, the reply takes 300 ms.
+    QTest::qWait(100);
+    QVERIFY(manager.isLoading());
+    manager.cancel();
+    QCOMPARE(manager.fetchState(), MoPubAdManager::Cancelled);
+    QVERIFY(!manager.isLoading());
+
+    // The refresh timer starts the next load, nothing else would.
+    QVERIFY(waitForCount(willLoad, 2));
+    QElapsedTimer timer;
+    timer.start();
+    while (manager.discardedReplyCount() == 0 && timer.elapsed() < WAIT_MILLISECONDS) QTest::qWait(10);
+    QCOMPARE(manager.discardedReplyCount(), 1);
+    manager.setAutoRefreshEnabled(false);
+    // Only the second load may render what the first one asked for.
+    QVERIFY(htmlReady.count() <= 1);
+}
+
+void tst_MoPubAdManager::unitChangeRestartsTheLoad(){
+    MoPubAdManager manager(&mEnvironment);
+    manager.setAutoRefreshEnabled(false);
+    QSignalSpy willLoad(&manager, SIGNAL(adWillLoad(QUrl)));
+    QSignalSpy didLoad(&manager, SIGNAL(adDidLoad()));
+    QSignalSpy htmlReady(&manager, SIGNAL(htmlReady(QString, QUrl)));
+
+    manager.setAdUnitId("tst-unit-a");
+    manager.loadAd();
+    QTest::qWait(100);
+    QVERIFY(manager.isLoading());
+
+    manager.setAdUnitId("tst-unit-b");
+    QVERIFY(manager.isLoading());
+    QCOMPARE(willLoad.count(), 2);
+    QCOMPARE(willLoad.last().first().toUrl().queryItemValue("id"), QString("tst-unit-b"));
+
+    QVERIFY(waitForCount(didLoad, 1));
+    QCOMPARE(manager.fetchState(), MoPubAdManager::Idle);
+    // The creative of the previous unit is dropped when it arrives.
+    QElapsedTimer timer;
+    timer.start();
+    while (manager.discardedReplyCount() == 0 && timer.elapsed() < WAIT_MILLISECONDS) QTest::qWait(10);
+    QCOMPARE(manager.discardedReplyCount(), 1);
+    QCOMPARE(htmlReady.count(), 1);
+    QCOMPARE(didLoad.count(), 1);
+}
+
+QTEST_MAIN(tst_MoPubAdManager)
+#include "tst_mopubadmanager.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_mopubadmanager
+TEMPLATE = app
+
+SOURCES += tst_mopubadmanager.cpp
+
+include(../tests.pri)
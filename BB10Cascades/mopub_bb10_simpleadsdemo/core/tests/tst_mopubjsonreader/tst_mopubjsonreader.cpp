@@ -0,0 +1,257 @@
+#include <QtTest/QtTest>
+
+#include "MoPubJsonReader.hpp"
+
+#if defined(Q_OS_BLACKBERRY)
+#include <bb/data/JsonDataAccess>
+#elif QT_VERSION >= 0x050000
+#include <QJsonDocument>
+#endif
+
+namespace {
+    // X-Nativeparams the way loadNativeSDK() gets it.
+    const QByteArray NATIVE_PARAMS =
+            "{\"adUnitID\": \"a425ff78-e8d3-4a8f-9f3d-5e8b6c1d2f00\", \"adWidth\": \"320\", \"adHeight\": 50,"
+            " \"title\": \"Caf\\u00e9 \\\"Deluxe\\\"\", \"clk\": \"http://ads.mopub.com/m/aclk?r=http%3A%2F%2Fexample.com\","
+            " \"imptracker\": [\"http://example.com/imp?a=1\", \"http://example.com/imp?a=2\"],"
+            " \"extras\": {\"rating\": 4.5, \"tags\": [1, 2, {\"deep\": [true, false, null]}], \"empty\": {}}}";
+
+    QByteArray largeDocument() {
+        QByteArray json = "[";
+        for (int i = 0; i < 200; ++i) {
+            if (i > 0) json += ",\n";
+            json += NATIVE_PARAMS;
+        }
+        json += "]";
+        return json;
+    }
+
+    // Every token up to End or Invalid, strings decoded the way a caller would.
+    MoPubJsonReader::Token readAll(MoPubJsonReader& reader, int* strings = 0) {
+        while (reader.next() != MoPubJsonReader::End && reader.token() != MoPubJsonReader::Invalid) {
+            if (strings && reader.token() == MoPubJsonReader::String && !reader.toString().isNull()) ++*strings;
+        }
+        return reader.token();
+    }
+}
+
+/*!
+ * @brief Grammar, escapes and error handling of MoPubJsonReader, and its parse time against a DOM parser.
+ */
+class tst_MoPubJsonReader: public QObject {
+    Q_OBJECT
+
+private Q_SLOTS:
+    void tokens();
+    void strings();
+    void numbersAndLiterals();
+    void skipValue();
+    void nativeParams();
+    void malformed_data();
+    void malformed();
+    void benchmarkReader_data();
+    void benchmarkReader();
+    void benchmarkBaseline_data();
+    void benchmarkBaseline();
+};
+
+void tst_MoPubJsonReader::tokens(){
+    MoPubJsonReader reader("{\"a\": [1, \"b\"], \"c\": {}}");
+    QCOMPARE(reader.next(), MoPubJsonReader::BeginObject);
+    QCOMPARE(reader.next(), MoPubJsonReader::Name);
+    QCOMPARE(reader.view(), QByteArray("a"));
+    QCOMPARE(reader.next(), MoPubJsonReader::BeginArray);
+    QCOMPARE(reader.next(), MoPubJsonReader::Number);
+    QCOMPARE(reader.next(), MoPubJsonReader::String);
+    QCOMPARE(reader.view(), QByteArray("b"));
+    QCOMPARE(reader.next(), MoPubJsonReader::EndArray);
+    QCOMPARE(reader.next(), MoPubJsonReader::Name);
+    QCOMPARE(reader.next(), MoPubJsonReader::BeginObject);
+    QCOMPARE(reader.next(), MoPubJsonReader::EndObject);
+    QCOMPARE(reader.next(), MoPubJsonReader::EndObject);
+    QCOMPARE(reader.next(), MoPubJsonReader::End);
+    // Stays at the end.
+    QCOMPARE(reader.next(), MoPubJsonReader::End);
+    QCOMPARE(reader.errorOffset(), -1);
+}
+
+void tst_MoPubJsonReader::strings(){
+    MoPubJsonReader reader("[\"plain\", \"a\\nb\\t\\\"q\\\" \\\\ \\/\", \"\\u00e9\\u20AC\", \"\\ud83d\\ude00\", \"\xc3\xa9\"]");
+    QCOMPARE(reader.next(), MoPubJsonReader::BeginArray);
+
+    QCOMPARE(reader.next(), MoPubJsonReader::String);
+    QCOMPARE(reader.toString(), QString("plain"));
+
+    // Views keep the escapes, toString() decodes them.
+    QCOMPARE(reader.next(), MoPubJsonReader::String);
+    QCOMPARE(reader.view(), QByteArray("a\\nb\\t\\\"q\\\" \\\\ \\/"));
+    QCOMPARE(reader.toString(), QString("a\nb\t\"q\" \\ /"));
+
+    QCOMPARE(reader.next(), MoPubJsonReader::String);
+    QCOMPARE(reader.toString(), QString::fromUtf8("\xc3\xa9\xe2\x82\xac"));
+
+    QCOMPARE(reader.next(), MoPubJsonReader::String);
+    QCOMPARE(reader.toString(), QString::fromUtf8("\xf0\x9f\x98\x80"));
+
+    QCOMPARE(reader.next(), MoPubJsonReader::String);
+    QCOMPARE(reader.toString(), QString::fromUtf8("\xc3\xa9"));
+
+    QCOMPARE(reader.next(), MoPubJsonReader::EndArray);
+    QCOMPARE(reader.next(), MoPubJsonReader::End);
+}
+
+void tst_MoPubJsonReader::numbersAndLiterals(){
+    MoPubJsonReader reader("[-12, 3.25, 1e3, \"42\", true, false, null]");
+    bool ok = false;
+    QCOMPARE(reader.next(), MoPubJsonReader::BeginArray);
+    QCOMPARE(reader.next(), MoPubJsonReader::Number);
+    QCOMPARE(reader.toInt(&ok), -12);
+    QVERIFY(ok);
+    QCOMPARE(reader.next(), MoPubJsonReader::Number);
+    QCOMPARE(reader.toDouble(&ok), 3.25);
+    QVERIFY(ok);
+    QCOMPARE(reader.next(), MoPubJsonReader::Number);
+    QCOMPARE(reader.toInt(&ok), 1000);
+    QVERIFY(ok);
+    // Numbers sent as strings.
+    QCOMPARE(reader.next(), MoPubJsonReader::String);
+    QCOMPARE(reader.toInt(&ok), 42);
+    QVERIFY(ok);
+    QCOMPARE(reader.next(), MoPubJsonReader::Bool);
+    QVERIFY(reader.toBool());
+    QCOMPARE(reader.next(), MoPubJsonReader::Bool);
+    QVERIFY(!reader.toBool());
+    QCOMPARE(reader.next(), MoPubJsonReader::Null);
+    QCOMPARE(reader.toInt(&ok), 0);
+    QVERIFY(!ok);
+    QCOMPARE(reader.next(), MoPubJsonReader::EndArray);
+    QCOMPARE(reader.next(), MoPubJsonReader::End);
+}
+
+void tst_MoPubJsonReader::skipValue(){
+    MoPubJsonReader reader("{\"skip\": {\"a\": [1, {\"b\": [2, 3]}], \"c\": \"}\"}, \"keep\": 7}");
+    QCOMPARE(reader.next(), MoPubJsonReader::BeginObject);
+    QCOMPARE(reader.next(), MoPubJsonReader::Name);
+    QCOMPARE(reader.next(), MoPubJsonReader::BeginObject);
+    QVERIFY(reader.skipValue());
+    QCOMPARE(reader.token(), MoPubJsonReader::EndObject);
+    QCOMPARE(reader.next(), MoPubJsonReader::Name);
+    QCOMPARE(reader.view(), QByteArray("keep"));
+    QCOMPARE(reader.next(), MoPubJsonReader::Number);
+    // Leaves scalars where they are.
+    QVERIFY(reader.skipValue());
+    QCOMPARE(reader.toInt(), 7);
+    QCOMPARE(reader.next(), MoPubJsonReader::EndObject);
+    QCOMPARE(reader.next(), MoPubJsonReader::End);
+}
+
+void tst_MoPubJsonReader::nativeParams(){
+    // The walk loadNativeSDK() does.
+    MoPubJsonReader json(NATIVE_PARAMS);
+    QString networkAdUnitId;
+    QString title;
+    int width = 0;
+    int height = 0;
+    int impressionTrackers = 0;
+    QCOMPARE(json.next(), MoPubJsonReader::BeginObject);
+    while (json.next() == MoPubJsonReader::Name) {
+        const QByteArray name = json.view();
+        json.next();
+        if (name == "adUnitID") networkAdUnitId = json.toString();
+        else if (name == "adWidth") width = json.toInt();
+        else if (name == "adHeight") height = json.toInt();
+        else if (name == "title") title = json.toString();
+        else if (name == "imptracker" && json.token() == MoPubJsonReader::BeginArray) {
+            while (json.next() != MoPubJsonReader::EndArray && json.token() != MoPubJsonReader::Invalid) {
+                if (json.token() == MoPubJsonReader::String) ++impressionTrackers;
+                json.skipValue();
+            }
+        }
+        else json.skipValue();
+    }
+    QCOMPARE(json.token(), MoPubJsonReader::EndObject);
+    QCOMPARE(networkAdUnitId, QString("a425ff78-e8d3-4a8f-9f3d-5e8b6c1d2f00"));
+    QCOMPARE(width, 320);
+    QCOMPARE(height, 50);
+    QCOMPARE(title, QString::fromUtf8("Caf\xc3\xa9 \"Deluxe\""));
+    QCOMPARE(impressionTrackers, 2);
+}
+
+void tst_MoPubJsonReader::malformed_data(){
+    QTest::addColumn<QByteArray>("json");
+    QTest::addColumn<QString>("error");
+
+    QTest::newRow("empty") << QByteArray() << "Unexpected end of input";
+    QTest::newRow("unterminated object") << QByteArray("{\"a\": 1") << "Unterminated container";
+    QTest::newRow("unterminated string") << QByteArray("[\"abc") << "Unterminated string";
+    QTest::newRow("escape at the end") << QByteArray("[\"abc\\") << "Unterminated string";
+    QTest::newRow("control character") << QByteArray("[\"a\nb\"]") << "Control character in string";
+    QTest::newRow("missing colon") << QByteArray("{\"a\" 1}") << "Expected ':'";
+    QTest::newRow("unquoted name") << QByteArray("{a: 1}") << "Expected a name";
+    QTest::newRow("missing comma") << QByteArray("[1 2]") << "Expected ',' or the end of the container";
+    QTest::newRow("mismatched close") << QByteArray("[1}") << "Expected ',' or the end of the container";
+    QTest::newRow("trailing characters") << QByteArray("{} x") << "Trailing characters";
+    QTest::newRow("unknown literal") << QByteArray("[nul]") << "Unknown literal";
+    QTest::newRow("bare word") << QByteArray("[x]") << "Unexpected character";
+    QTest::newRow("non-hex \\u digit") << QByteArray("[\"\\u12G4\"]") << "Bad \\u escape";
+    QTest::newRow("quote inside \\u") << QByteArray("[\"\\u12\"]") << "Bad \\u escape";
+    QTest::newRow("\\u past the end") << QByteArray("[\"\\u12") << "Unterminated string";
+    QTest::newRow("\\u up to the end") << QByteArray("[\"\\u1234") << "Unterminated string";
+}
+
+void tst_MoPubJsonReader::malformed(){
+    QFETCH(QByteArray, json);
+    QFETCH(QString, error);
+    MoPubJsonReader reader(json);
+    QCOMPARE(readAll(reader), MoPubJsonReader::Invalid);
+    QCOMPARE(reader.errorString(), error);
+    QVERIFY(reader.errorOffset() >= 0);
+    QVERIFY(reader.errorOffset() <= json.size());
+    // Stays invalid.
+    QCOMPARE(reader.next(), MoPubJsonReader::Invalid);
+    QVERIFY(!reader.skipValue());
+}
+
+void tst_MoPubJsonReader::benchmarkReader_data(){
+    QTest::addColumn<QByteArray>("json");
+    QTest::newRow("native params") << NATIVE_PARAMS;
+    QTest::newRow("200 native params") << largeDocument();
+}
+
+void tst_MoPubJsonReader::benchmarkReader(){
+    QFETCH(QByteArray, json);
+    int strings = 0;
+    QBENCHMARK {
+        MoPubJsonReader reader(json);
+        QCOMPARE(readAll(reader, &strings), MoPubJsonReader::End);
+    }
+    QVERIFY(strings > 0);
+}
+
+void tst_MoPubJsonReader::benchmarkBaseline_data(){
+    benchmarkReader_data();
+}
+
+void tst_MoPubJsonReader::benchmarkBaseline(){
+    QFETCH(QByteArray, json);
+#if defined(Q_OS_BLACKBERRY)
+    // What the native params were read with before, a whole QVariant tree.
+    bb::data::JsonDataAccess jsonDataAccess;
+    QBENCHMARK {
+        const QVariant value = jsonDataAccess.loadFromBuffer(json);
+        QVERIFY(!jsonDataAccess.hasError());
+        QVERIFY(value.isValid());
+    }
+#elif QT_VERSION >= 0x050000
+    QBENCHMARK {
+        const QVariant value = QJsonDocument::fromJson(json).toVariant();
+        QVERIFY(value.isValid());
+    }
+#else
+    Q_UNUSED(json);
+    QSKIP("Neither bb::data::JsonDataAccess nor QJsonDocument to compare with", SkipAll);
+#endif
+}
+
+QTEST_MAIN(tst_MoPubJsonReader)
+#include "tst_mopubjsonreader.moc"
@@ -0,0 +1,11 @@
+TARGET = tst_mopubjsonreader
+TEMPLATE = app
+
+SOURCES += tst_mopubjsonreader.cpp
+
+# The benchmark baseline on the device.
+blackberry {
+    LIBS += -lbbdata
+}
+
+include(../tests.pri)
@@ -0,0 +1,146 @@
+#include <QtTest/QtTest>
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QThread>
+#include <QUrl>
+
+#include "MoPubLogging.hpp"
+
+namespace {
+    const int WAIT_MILLISECONDS = 2000;
+
+    QtMsgHandler sPreviousHandler = 0;
+    QAtomicInt sMoPubMessages;
+    QMutex sLastMessageMutex;
+    QByteArray sLastMessage;
+    QThread* sLastMessageThread = 0;
+
+    // The drain thread writes through qDebug(), keep the benchmarks from flooding the test log.
+    void messageHandler(QtMsgType type, const char* message) {
+        if (qstrncmp(message, "MOPUB: ", 7) != 0) {
+            if (sPreviousHandler) sPreviousHandler(type, message);
+            return;
+        }
+        QMutexLocker locker(&sLastMessageMutex);
+        sLastMessage = message;
+        sLastMessageThread = QThread::currentThread();
+        sMoPubMessages.fetchAndAddRelaxed(1);
+    }
+
+    int sEvaluated = 0;
+    int expensiveArgument() {
+        return ++sEvaluated;
+    }
+}
+
+/*!
+ * @brief MoPubLog delivery and the cost of a log call on the calling thread.
+ */
+class tst_MoPubLogging: public QObject {
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+
+    void formatsOffTheCallingThread();
+    void disabledLevelSkipsTheArguments();
+    void dropsWhenTheRingIsFull();
+
+    void benchmarkEnabled();
+    void benchmarkDisabled();
+    void benchmarkFormatInline();
+    void benchmarkQDebug();
+
+private:
+    MoPubLogLevel mLevel;
+};
+
+void tst_MoPubLogging::initTestCase(){
+    mLevel = MoPubLog::level();
+    sPreviousHandler = qInstallMsgHandler(messageHandler);
+}
+
+void tst_MoPubLogging::cleanupTestCase(){
+    qInstallMsgHandler(sPreviousHandler);
+    MoPubLog::setLevel(mLevel);
+}
+
+void tst_MoPubLogging::init(){
+    MoPubLog::setLevel(MoPubLogLevelInfo);
+}
+
+void tst_MoPubLogging::formatsOffTheCallingThread(){
+    // Let whatever earlier tests logged drain first.
+    QTest::qWait(300);
+    const int before = sMoPubMessages;
+    MPLogWarn("Fetch %1 of %2 took %3 ms", QUrl("http://ads.mopub.com/m/ad?id=tst"), QString("tst"), 42);
+
+    QElapsedTimer timer;
+    timer.start();
+    while (sMoPubMessages == before && timer.elapsed() < WAIT_MILLISECONDS) QTest::qWait(10);
+    QCOMPARE(int(sMoPubMessages), before + 1);
+    QMutexLocker locker(&sLastMessageMutex);
+    QVERIFY(sLastMessage.contains(" WARN Fetch http://ads.mopub.com/m/ad?id=tst of tst took 42 ms"));
+    QVERIFY(sLastMessageThread != QThread::currentThread());
+}
+
+void tst_MoPubLogging::disabledLevelSkipsTheArguments(){
+    MoPubLog::setLevel(MoPubLogLevelError);
+    sEvaluated = 0;
+    MPLogWarn("Not logged %1", expensiveArgument());
+    QCOMPARE(sEvaluated, 0);
+    MoPubLog::setLevel(MoPubLogLevelWarn);
+    MPLogWarn("Logged %1", expensiveArgument());
+    QCOMPARE(sEvaluated, 1);
+}
+
+void tst_MoPubLogging::dropsWhenTheRingIsFull(){
+    const int dropped = MoPubLog::droppedCount();
+    // Far more than the ring holds between two drains.
+    for (int i = 0; i < 4096; ++i) MPLogInfo("Burst %1", i);
+    QVERIFY(MoPubLog::droppedCount() > dropped);
+}
+
+void tst_MoPubLogging::benchmarkEnabled(){
+    // What a call costs the UI thread. Once the ring is full calls are dropped, which still
+    // builds the record, so this is the cost of a loaded logger rather than an idle one.
+    const QUrl url("http://ads.mopub.com/m/ad?v=8&id=tst&nv=1.17.0.0&udid=sha%3Atst");
+    const QString adUnitId("tst");
+    QBENCHMARK {
+        MPLogInfo("Fetch %1 for %2 took %3 ms", url, adUnitId, 42);
+    }
+}
+
+void tst_MoPubLogging::benchmarkDisabled(){
+    MoPubLog::setLevel(MoPubLogLevelWarn);
+    const QUrl url("http://ads.mopub.com/m/ad?v=8&id=tst&nv=1.17.0.0&udid=sha%3Atst");
+    const QString adUnitId("tst");
+    QBENCHMARK {
+        MPLogInfo("Fetch %1 for %2 took %3 ms", url, adUnitId, 42);
+    }
+}
+
+void tst_MoPubLogging::benchmarkFormatInline(){
+    // The formatting the drain thread takes off the calling thread.
+    const QUrl url("http://ads.mopub.com/m/ad?v=8&id=tst&nv=1.17.0.0&udid=sha%3Atst");
+    const QString adUnitId("tst");
+    QBENCHMARK {
+        const QString message = QString("Fetch %1 for %2 took %3 ms").arg(url.toString(), adUnitId, QString::number(42));
+        Q_UNUSED(message);
+    }
+}
+
+void tst_MoPubLogging::benchmarkQDebug(){
+    // Logging the way the SDK did before, formatted and written on the calling thread.
+    const QUrl url("http://ads.mopub.com/m/ad?v=8&id=tst&nv=1.17.0.0&udid=sha%3Atst");
+    const QString adUnitId("tst");
+    QBENCHMARK {
+        qDebug() << "MOPUB: Fetch" << url.toString() + " for " + adUnitId << "took" << 42 << "ms";
+    }
+}
+
+QTEST_MAIN(tst_MoPubLogging)
+#include "tst_mopublogging.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_mopublogging
+TEMPLATE = app
+
+SOURCES += tst_mopublogging.cpp
+
+include(../tests.pri)
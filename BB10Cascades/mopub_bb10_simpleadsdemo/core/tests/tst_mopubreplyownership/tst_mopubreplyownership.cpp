@@ -0,0 +1,247 @@
+#include <QtTest/QtTest>
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include "MoPubAdFetcher.hpp"
+#include "MoPubAdManager.hpp"
+#include "MoPubLogging.hpp"
+#include "MoPubNetworkCapture.hpp"
+#include "MoPubNetworkThread.hpp"
+#include "MoPubReplyOwnership.hpp"
+#include "testhome.hpp"
+
+namespace {
+    const int WAIT_MILLISECONDS = 5000;
+    const int REQUESTS_PER_ROUND = 20;
+    const int WARM_UP_ROUNDS = 20;
+    const int SOAK_ROUNDS = 200;
+    const int WARM_UP_REFRESHES = 20;
+    const int SOAK_REFRESHES = 100;
+    const int REFRESH_MILLISECONDS = 10;
+    // For refreshes falling due before the soak turns refreshing off.
+    const int SPARE_REFRESHES = 10;
+    const int REFRESH_WAIT_MILLISECONDS = 60000;
+    // Allocator slack, a leak of one reply per round is well above it.
+    const qint64 RSS_TOLERANCE_BYTES = 1024 * 1024;
+    const char* const REFRESH_AD_UNIT_ID = "tst-soak-refresh";
+
+    class StubEnvironment: public MoPubAdEnvironment {
+    public:
+        QString userAgent() const { return QString("MoPubTest/1.0"); }
+        QString udid() const { return QString("tst-udid"); }
+        QString installId() const { return QString("tst-install"); }
+    };
+
+    // Even requests of a round are served a creative, odd ones find nothing captured and get a 404.
+    QUrl fetchUrl(int round, int request) {
+        return QUrl(QString("http://ads.mopub.com/m/ad?v=8&id=%1&n=%2-%3")
+                .arg(request % 2 == 0 ? "tst-soak-served" : "tst-soak").arg(round).arg(request));
+    }
+
+    MoPubCapturedExchange servedExchange(const QByteArray& url, int n) {
+        MoPubCapturedExchange exchange;
+        exchange.url = url;
+        exchange.statusCode = 200;
+        exchange.reasonPhrase = "OK";
+        exchange.responseHeaders.append(qMakePair(QByteArray("X-Adtype"), QByteArray("html")));
+        exchange.responseHeaders.append(qMakePair(QByteArray("Content-Type"), QByteArray("text/html")));
+        // Two creatives taking turns, so every refresh renders and stores a new one.
+        exchange.body = QString("<html><body><img src=\"http://example.com/ad-%1.png\"></body></html>").arg(n % 2).toUtf8();
+        return exchange;
+    }
+
+    bool waitForCount(const QSignalSpy& spy, int count, int milliseconds) {
+        QElapsedTimer timer;
+        timer.start();
+        while (spy.count() < count && timer.elapsed() < milliseconds) QTest::qWait(10);
+        return spy.count() >= count;
+    }
+
+    // -1 where /proc/self/statm doesn't exist.
+    qint64 residentBytes() {
+#ifdef Q_OS_UNIX
+        QFile statm("/proc/self/statm");
+        if (!statm.open(QIODevice::ReadOnly)) return -1;
+        const QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() < 2) return -1;
+        return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+        return -1;
+#endif
+    }
+}
+
+/*!
+ * @brief Counts what a fetcher delivers back on the test thread.
+ */
+class ReplyCounter: public QObject {
+    Q_OBJECT
+public:
+    ReplyCounter() : QObject(0), mCount(0), mServedCount(0) {}
+    int count() const { return mCount; }
+    // Responses that parsed into a creative.
+    int servedCount() const { return mServedCount; }
+
+public Q_SLOTS:
+    void onReply() { ++mCount; }
+    void onResponse(const MoPubAdResponse& response) {
+        ++mCount;
+        if (response.status == MoPubAdResponse::Success && response.adType == MoPubAdResponse::HtmlAd
+                && !response.html.isEmpty()) ++mServedCount;
+    }
+
+private:
+    int mCount;
+    int mServedCount;
+};
+
+/*!
+ * @brief Soaks MoPubAdFetcher with fetches, beacons and click resolutions, answered and
+ * abandoned, then MoPubAdManager with refreshes, and checks that no reply outlives its
+ * round and that the memory stays flat.
+ */
+class tst_MoPubReplyOwnership: public QObject {
+    Q_OBJECT
+public:
+    tst_MoPubReplyOwnership() : mHome("tst_mopubreplyownership") {}
+
+private Q_SLOTS:
+    void initTestCase();
+    void answeredRound();
+    void abandonedRound();
+    void soak();
+    void refreshSoak();
+
+private:
+    bool round(int index, bool abandon);
+
+    StubEnvironment mEnvironment;
+    TestHome mHome;
+};
+
+void tst_MoPubReplyOwnership::initTestCase(){
+    QVERIFY(mHome.isValid());
+
+    const QString replayPath = mHome.path() + "/replay.mpnc";
+    QFile file(replayPath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_8);
+    out << quint32(0x4d504e43) << quint16(1);
+    // Every round may be an answered one, beacons and click resolutions are left to the 404s.
+    for (int n = 0; n < 2 + WARM_UP_ROUNDS + SOAK_ROUNDS; ++n) {
+        for (int i = 0; i < REQUESTS_PER_ROUND; i += 2) out << servedExchange(fetchUrl(n, i).toEncoded(), i);
+    }
+    const QByteArray refreshUrl = MoPubAdManager::adRequestUrl(REFRESH_AD_UNIT_ID, &mEnvironment).toEncoded();
+    for (int n = 0; n < WARM_UP_REFRESHES + SOAK_REFRESHES + SPARE_REFRESHES; ++n) out << servedExchange(refreshUrl, n);
+    file.close();
+    MoPubNetworkThread::setReplayFile(replayPath);
+    // Each 404 is logged as a warning.
+    MoPubLog::setLevel(MoPubLogLevelError);
+}
+
+bool tst_MoPubReplyOwnership::round(int index, bool abandon){
+    ReplyCounter counter;
+    MoPubAdFetcher* fetcher = new MoPubAdFetcher();
+    bool res = connect(fetcher, SIGNAL(adResponse(MoPubAdResponse)), &counter, SLOT(onResponse(MoPubAdResponse)));
+    Q_ASSERT(res);
+    res = connect(fetcher, SIGNAL(fetchFailed(int, int)), &counter, SLOT(onReply()));
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+
+    const QByteArray userAgent("MoPubTest/1.0");
+    for (int i = 0; i < REQUESTS_PER_ROUND; ++i) {
+        // Distinct URLs, every request of the soak gets a reply of its own.
+        const QString suffix = QString("%1-%2").arg(index).arg(i);
+        QMetaObject::invokeMethod(fetcher, "fetch", Qt::QueuedConnection, Q_ARG(int, i + 1),
+                Q_ARG(QUrl, fetchUrl(index, i)), Q_ARG(QByteArray, userAgent),
+                Q_ARG(int, QNetworkRequest::NormalPriority), Q_ARG(bool, false));
+        QMetaObject::invokeMethod(fetcher, "track", Qt::QueuedConnection,
+                Q_ARG(QUrl, QUrl("http://ads.mopub.com/m/imp?id=tst-soak&n=" + suffix)), Q_ARG(QByteArray, userAgent));
+        const QUrl landingUrl("http://example.com/landing?n=" + suffix);
+        QMetaObject::invokeMethod(fetcher, "resolve", Qt::QueuedConnection,
+                Q_ARG(QUrl, QUrl::fromEncoded("http://ads.mopub.com/m/aclk?r=" + QUrl::toPercentEncoding(landingUrl.toString()))),
+                Q_ARG(QUrl, landingUrl), Q_ARG(QByteArray, userAgent));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!abandon) {
+        // Every reply is handled and handed back before the fetcher goes, each fetch reports once.
+        while ((counter.count() < REQUESTS_PER_ROUND || MoPubReplyOwnership::liveCount() > 0)
+                && timer.elapsed() < WAIT_MILLISECONDS) QTest::qWait(1);
+        if (counter.count() != REQUESTS_PER_ROUND || counter.servedCount() != REQUESTS_PER_ROUND / 2) return false;
+    }
+    // Replies still pending in an abandoned round go away with the fetcher.
+    fetcher->deleteLater();
+    while (MoPubReplyOwnership::liveCount() > 0 && timer.elapsed() < WAIT_MILLISECONDS) QTest::qWait(1);
+    return MoPubReplyOwnership::liveCount() == 0;
+}
+
+void tst_MoPubReplyOwnership::answeredRound(){
+    const int total = MoPubReplyOwnership::totalCount();
+    QVERIFY(round(0, false));
+    QCOMPARE(MoPubReplyOwnership::totalCount() - total, 3 * REQUESTS_PER_ROUND);
+    QCOMPARE(MoPubReplyOwnership::liveCount(), 0);
+}
+
+void tst_MoPubReplyOwnership::abandonedRound(){
+    QVERIFY(round(1, true));
+    QCOMPARE(MoPubReplyOwnership::liveCount(), 0);
+}
+
+void tst_MoPubReplyOwnership::soak(){
+    int n = 2;
+    for (int i = 0; i < WARM_UP_ROUNDS; ++i, ++n) QVERIFY(round(n, i % 2 == 1));
+    const qint64 warm = residentBytes();
+    const int total = MoPubReplyOwnership::totalCount();
+
+    for (int i = 0; i < SOAK_ROUNDS; ++i, ++n) {
+        QVERIFY2(round(n, i % 2 == 1), qPrintable(QString("%1 replies still alive after round %2")
+                .arg(MoPubReplyOwnership::liveCount()).arg(n)));
+    }
+    QVERIFY(MoPubReplyOwnership::totalCount() - total >= SOAK_ROUNDS / 2 * 3 * REQUESTS_PER_ROUND);
+    QCOMPARE(MoPubReplyOwnership::liveCount(), 0);
+
+    if (warm < 0) QSKIP("No /proc/self/statm to read the resident set size from", SkipSingle);
+    const qint64 soaked = residentBytes();
+    qDebug("Resident set: %lld KB after warm-up, %lld KB after %d rounds", warm / 1024, soaked / 1024, SOAK_ROUNDS);
+    QVERIFY2(soaked - warm < RSS_TOLERANCE_BYTES, qPrintable(QString("Resident set grew by %1 KB").arg((soaked - warm) / 1024)));
+}
+
+void tst_MoPubReplyOwnership::refreshSoak(){
+    MoPubAdManager manager(&mEnvironment);
+    QSignalSpy didLoad(&manager, SIGNAL(adDidLoad()));
+    QSignalSpy failed(&manager, SIGNAL(adFailed()));
+    manager.setRefreshTimeMilliseconds(REFRESH_MILLISECONDS);
+    manager.setAdUnitId(REFRESH_AD_UNIT_ID);
+    // Each load is parsed from a 200, rendered, stored and arms the refresh that starts the next.
+    manager.loadAd();
+    QVERIFY(waitForCount(didLoad, WARM_UP_REFRESHES, REFRESH_WAIT_MILLISECONDS));
+    const qint64 warm = residentBytes();
+    const int total = MoPubReplyOwnership::totalCount();
+
+    QVERIFY2(waitForCount(didLoad, WARM_UP_REFRESHES + SOAK_REFRESHES, REFRESH_WAIT_MILLISECONDS),
+            qPrintable(QString("%1 refreshes loaded").arg(didLoad.count())));
+    manager.setAutoRefreshEnabled(false);
+    QElapsedTimer timer;
+    timer.start();
+    while ((manager.isLoading() || MoPubReplyOwnership::liveCount() > 0) && timer.elapsed() < WAIT_MILLISECONDS) QTest::qWait(1);
+    QCOMPARE(failed.count(), 0);
+    QVERIFY(MoPubReplyOwnership::totalCount() - total >= SOAK_REFRESHES);
+    QCOMPARE(MoPubReplyOwnership::liveCount(), 0);
+
+    if (warm < 0) QSKIP("No /proc/self/statm to read the resident set size from", SkipSingle);
+    const qint64 soaked = residentBytes();
+    qDebug("Resident set: %lld KB after warm-up, %lld KB after %d refreshes", warm / 1024, soaked / 1024, SOAK_REFRESHES);
+    QVERIFY2(soaked - warm < RSS_TOLERANCE_BYTES, qPrintable(QString("Resident set grew by %1 KB").arg((soaked - warm) / 1024)));
+}
+
+QTEST_MAIN(tst_MoPubReplyOwnership)
+#include "tst_mopubreplyownership.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_mopubreplyownership
+TEMPLATE = app
+
+SOURCES += tst_mopubreplyownership.cpp
+
+include(../tests.pri)
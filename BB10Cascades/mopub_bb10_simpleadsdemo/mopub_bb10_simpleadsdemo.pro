@@ -3,4 +3,5 @@ APP_NAME = mopub_bb10_simpleadsdemo
 CONFIG += qt warn_on cascades10
 LIBS += -lbbsystem -lQtLocationSubset -lbbdevice -lbb
 
+include(core/mopubcore.pri)
 include(config.pri)
@@ -0,0 +1,48 @@
+#include "MoPubDeviceEnvironment.hpp"
+
+#include <QCryptographicHash>
+
+#include <bb/device/HardwareInfo>
+#include <bb/device/DeviceInfo>
+#include <bb/PackageInfo>
+
+using namespace bb;
+using namespace bb::device;
+
+MoPubDeviceEnvironment::MoPubDeviceEnvironment(QObject* parent)
+: QObject(parent)
+, mHardwareInfo(new HardwareInfo(this))
+, mDeviceInfo(new DeviceInfo(this))
+, mPackageInfo(new PackageInfo(this))
+{
+}
+
+QString MoPubDeviceEnvironment::userAgent() const {
+   //A fake user agent string is used when the WebView has none. Added version value from Cascades Gold Release sdk.
+   //This string matches the format added to webkit http://trac.webkit.org/changeset/125779/trunk/Source/WebCore/inspector/front-end/SettingsScreen.js
+   return QString("[\"BlackBerry \u2014 BB10\", \"Mozilla/5.0 (BB10; Touch) AppleWebKit/537.1+ (KHTML, like Gecko) Version/10.0.9.1673 Mobile Safari/537.1+\", \"768x1280x1\"]");
+}
+
+QString MoPubDeviceEnvironment::udid() const {
+    // The IMEI never changes, hash it once instead of on every request.
+    static QString udid;
+    if (udid.isEmpty()) {
+        QByteArray hash = QCryptographicHash::hash(mHardwareInfo->imei().toUtf8(),QCryptographicHash::Sha1);
+        udid = "sha1imei:bb10" + hash.toHex();
+    }
+    return udid;
+}
+
+QString MoPubDeviceEnvironment::installId() const {
+    return mPackageInfo->installId();
+}
+
+QString MoPubDeviceEnvironment::orientation() const {
+    switch (mDeviceInfo->orientation()) {
+    case DeviceOrientation::LeftUp:
+    case DeviceOrientation::RightUp:
+        return QString("l");
+    default:
+        return QString("p");
+    }
+}
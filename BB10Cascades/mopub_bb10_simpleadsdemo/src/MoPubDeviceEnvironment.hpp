@@ -0,0 +1,40 @@
+#ifndef MOPUBDEVICEENVIRONMENT_HPP_
+#define MOPUBDEVICEENVIRONMENT_HPP_
+
+#include <QObject>
+#include <QString>
+
+#include "MoPubAdManager.hpp"
+
+namespace bb {
+    namespace device {
+        class HardwareInfo;
+        class DeviceInfo;
+    }
+    class PackageInfo;
+}
+
+/*!
+ * @brief What the device tells about itself, without a view around it.
+ *
+ * Backs the device part of MoPubView and the early fetches of MoPubEarlyStart, made
+ * before any view exists. Has no location and uses the default user agent.
+ */
+class MoPubDeviceEnvironment: public QObject, public MoPubAdEnvironment {
+    Q_OBJECT
+public:
+    explicit MoPubDeviceEnvironment(QObject* parent = 0);
+
+    // MoPubAdEnvironment
+    QString userAgent() const;
+    QString udid() const;
+    QString installId() const;
+    QString orientation() const;
+
+private:
+    bb::device::HardwareInfo* mHardwareInfo;
+    bb::device::DeviceInfo* mDeviceInfo;
+    bb::PackageInfo* mPackageInfo;
+};
+
+#endif /* MOPUBDEVICEENVIRONMENT_HPP_ */
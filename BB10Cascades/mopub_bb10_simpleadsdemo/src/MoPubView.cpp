@@ -1,247 +1,372 @@
 #include "MoPubView.hpp"
 
-#include <QUuid>
 #include <QtLocationSubset/QGeoPositionInfo>
 
-#include <math.h>
-
 #include <bb/Application>
 #include <bb/cascades/Container>
 #include <bb/cascades/ScrollView>
 #include <bb/cascades/WebView>
 #include <bb/cascades/WebNavigationRequest>
+#include <bb/cascades/WebLoadRequest>
 #include <bb/cascades/WebSettings>
 #include <bb/cascades/DockLayout>
 #include <bb/system/InvokeManager>
 #include <bb/system/InvokeRequest>
-#include <bb/device/HardwareInfo>
-#include <bb/device/DeviceInfo>
-#include <bb/PackageInfo>
 #include <bb/location/PositionErrorCode>
 
+#include "MoPubAdInspector.hpp"
+#include "MoPubCircuitBreaker.hpp"
+#include "MoPubDataUsage.hpp"
+#include "MoPubDeviceEnvironment.hpp"
+#include "MoPubLogging.hpp"
+#include "MoPubStallWatchdog.hpp"
+#include "MoPubViewabilityTracker.hpp"
+#include "MoPubWebViewReclaimer.hpp"
 
 using namespace QtMobilitySubset;
 using namespace bb;
 using namespace bb::cascades;
 using namespace bb::system;
-using namespace bb::device;
-
-const QString MoPubView::SDK_VERSION = QString("1.9.0.8");
-const QString MoPubView::API_VERSION = QString("8");
-#ifdef TESTING
-const QString MoPubView::MOPUB_URL = QString("http://testing.ads.mopub.com");
-#else
-const QString MoPubView::MOPUB_URL = QString("http://ads.mopub.com");
-#endif
-const QString MoPubView::AD_HANDLER = QString("/m/ad");
-const QString MoPubView::IMPRESSION_HANDLER = QString ("/m/imp");
-const QString MoPubView::CONVERSION_HANDLER = QString("/m/open");
-const int MoPubView::MINIMUM_REFRESH_TIME_MILLISECONDS = 10000;
-const int MoPubView::MAXIMUM_REFRESH_TIME_MILLISECONDS = 60000;
-const double MoPubView::EXPONENTIAL_BACKOFF_FACTOR = 1.5;
 
 MoPubView::MoPubView()
 : mControlContainer(0)
 , mScrollView(0)
 , mAdView(0)
 , mInvokeManager(new InvokeManager(this))
-, mNetworkAccessManager(new QNetworkAccessManager(this))
+, mAdManager(new MoPubAdManager(this, this))
+, mViewabilityTracker(new MoPubViewabilityTracker(this))
 , mPositionSource(QGeoPositionInfoSource::createDefaultSource(this))
-, mHardwareInfo(new HardwareInfo(this))
-, mDeviceInfo(new DeviceInfo(this))
-, mAutoAdRefreshTimer(new QTimer(this))
-, mPackageInfo(new PackageInfo(this))
+, mDevice(new MoPubDeviceEnvironment(this))
+, mScrollable(false)
+, mRestoring(false)
+#ifndef QT_NO_DEBUG
+, mInspector(new MoPubAdInspector(this))
+#endif
+, mWidth(0)
+, mHeight(0)
 {
     mControlContainer = Container::create();
-    mAdView = WebView::create();
     mScrollView = ScrollView::create();
-    mScrollView->setContent(mAdView);
+    createAdView();
     mControlContainer->add(mScrollView);
-
-    bool res = connect(mAdView, SIGNAL(navigationRequested(bb::cascades::WebNavigationRequest*)),
-            this, SLOT(onNavigationRequested(bb::cascades::WebNavigationRequest*)));
-    Q_ASSERT(res);
+    setWebViewScrollingEnabled(mScrollable);
 
     Application* app = Application::instance();
-    res = connect(app, SIGNAL(asleep()),
-            this, SLOT(cancelRefreshTimer()));
+    bool res = connect(app, SIGNAL(asleep()),
+            mAdManager, SLOT(cancelRefreshTimer()));
     Q_ASSERT(res);
     res = connect(app, SIGNAL(awake()),
-            this, SLOT(scheduleRefreshTimerIfEnabled()));
+            mAdManager, SLOT(scheduleRefreshTimerIfEnabled()));
     Q_ASSERT(res);
 
-    mRefreshTimeMilliseconds = 60000;
-    mAutoRefreshEnabled = true;
-    res = connect(mAutoAdRefreshTimer, SIGNAL(timeout()), this, SLOT(loadAd()));
+    res = connect(mAdManager, SIGNAL(htmlReady(QString, QUrl)), this, SLOT(onHtmlReady(QString, QUrl)));
+    Q_ASSERT(res);
+    res = connect(mAdManager, SIGNAL(layoutChanged(int, int, bool)), this, SLOT(onLayoutChanged(int, int, bool)));
+    Q_ASSERT(res);
+    res = connect(mAdManager, SIGNAL(adWillLoad(QUrl)), this, SIGNAL(adWillLoad(QUrl)));
+    Q_ASSERT(res);
+    res = connect(mAdManager, SIGNAL(adDidLoad()), this, SIGNAL(adDidLoad()));
+    Q_ASSERT(res);
+    res = connect(mAdManager, SIGNAL(adFailed()), this, SIGNAL(adFailed()));
+    Q_ASSERT(res);
+
+    // The ancestors are only known once the declaring QML is done.
+    res = connect(this, SIGNAL(creationCompleted()), mViewabilityTracker, SLOT(attach()));
+    Q_ASSERT(res);
+    res = connect(mViewabilityTracker, SIGNAL(viewableChanged(bool)), mAdManager, SLOT(setViewable(bool)));
+    Q_ASSERT(res);
+    res = connect(mViewabilityTracker, SIGNAL(viewableChanged(bool)), this, SIGNAL(viewableChanged(bool)));
+    Q_ASSERT(res);
+    res = connect(mViewabilityTracker, SIGNAL(visiblePercentChanged(int)), this, SIGNAL(visiblePercentChanged(int)));
+    Q_ASSERT(res);
+    res = connect(mViewabilityTracker, SIGNAL(visiblePercentChanged(int)), this, SLOT(onVisiblePercentChanged(int)));
     Q_ASSERT(res);
     Q_UNUSED(res);
     setRoot(mControlContainer);
+
+    // Out of sight until the tracker says otherwise.
+    mHiddenTimer.start();
+    MoPubWebViewReclaimer::instance()->registerView(this);
+}
+
+MoPubView::~MoPubView()
+{
+    MoPubWebViewReclaimer::instance()->unregisterView(this);
+    // The manager calls back into the environment, so it goes first.
+    delete mAdManager;
 }
 
 void MoPubView::setWidth(int value) {
+    if (value == mWidth) return;
     mWidth = value;
-    mAdView->setPreferredWidth(mWidth);
+    if (mAdView) mAdView->setPreferredWidth(mWidth);
 }
 void MoPubView::setHeight(int value) {
+    if (value == mHeight) return;
     mHeight = value;
-    mAdView->setPreferredHeight(mHeight);
+    if (mAdView) mAdView->setPreferredHeight(mHeight);
 }
-QString MoPubView::adHtml() {return mAdView->html();}
 
-void MoPubView::loadAd(){
+void MoPubView::createAdView(){
+    mAdView = WebView::create();
+    if (mWidth > 0) mAdView->setPreferredWidth(mWidth);
+    if (mHeight > 0) mAdView->setPreferredHeight(mHeight);
+    bool res = connect(mAdView, SIGNAL(navigationRequested(bb::cascades::WebNavigationRequest*)),
+            this, SLOT(onNavigationRequested(bb::cascades::WebNavigationRequest*)));
+    Q_ASSERT(res);
+    res = connect(mAdView, SIGNAL(loadingChanged(bb::cascades::WebLoadRequest*)),
+            this, SLOT(onLoadingChanged(bb::cascades::WebLoadRequest*)));
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+    mScrollView->setContent(mAdView);
+}
 
-    if (mIsLoading) {
-        qDebug() << "Already loading an ad for " + mAdUnitId + ", wait to finish.";
+qint64 MoPubView::hiddenMilliseconds() const {
+    return mHiddenTimer.isValid() ? mHiddenTimer.elapsed() : 0;
+}
+
+bool MoPubView::evict(){
+    // Without a known size the slot would collapse and never be seen again.
+    if (!mAdView || mHtml.isEmpty() || mWidth <= 0 || mHeight <= 0) return false;
+    // A creative still rendering would lose its finishload and the fetch under way its view.
+    if (mAdManager->isLoading()) return false;
+    mControlContainer->setPreferredSize(mWidth, mHeight);
+    // The scroll view keeps owning its old content.
+    mScrollView->setContent(0);
+    mAdView->deleteLater();
+    mAdView = 0;
+    mDisplayTimer.invalidate();
+    mRestoreTimer.invalidate();
+    mRestoring = false;
+    mEvictedHtml = qCompress(mHtml.toUtf8());
+    mHtml.clear();
+    // A refresh would only build a new WebView for a view nobody sees.
+    mAdManager->setRefreshSuspended(true);
+    return true;
+}
+
+void MoPubView::restore(){
+    MoPubStallScope stallScope("restore", adUnitId());
+    mRestoreTimer.start();
+    mRestoring = true;
+    mHtml = QString::fromUtf8(qUncompress(mEvictedHtml));
+    mEvictedHtml.clear();
+    createAdView();
+    mControlContainer->resetPreferredWidth();
+    mControlContainer->resetPreferredHeight();
+    mAdView->settings()->setJavaScriptEnabled(MoPubCreativeClassifier::needsScript(mAdManager->creativeKind()));
+    mAdView->setHtml(mHtml, mBaseUrl);
+    mAdManager->setRefreshSuspended(false);
+}
+
+void MoPubView::onVisiblePercentChanged(int percent){
+    if (percent == 0) {
+        if (!mHiddenTimer.isValid()) mHiddenTimer.start();
         return;
     }
+    mHiddenTimer.invalidate();
+    if (isEvicted()) restore();
+}
 
-    if (mAdUnitId.isEmpty()){
-        qDebug() << "Can't load an ad in this ad view because the ad unit ID is null. " << "Did you forget to call setAdUnitId()?";
-        return;
-    }
+#ifndef QT_NO_DEBUG
+QObject* MoPubView::inspector() const {return mInspector;}
+#endif
 
-    if (!(mNetworkAccessManager->networkAccessible())){
-        qDebug() << "Can't load an ad because there is no network connectivity.";
-        scheduleRefreshTimerIfEnabled();
-        return;
-    }
+QVariantMap MoPubView::dataUsage() const {
+    return MoPubDataUsage::instance()->report();
+}
 
-    mFailUrl = QUrl();
-    mIsLoading = true;
+void MoPubView::setDataSaverMode(DataSaverMode value){
+    if (value == dataSaverMode()) return;
+    MoPubDataUsage::instance()->setDataSaverMode(MoPubDataUsage::DataSaverMode(value));
+    emit dataSaverModeChanged();
+}
 
-    mUrl = generateAdUrl();
-    qDebug() <<  "Fetch Ad for " << mUrl;
-    emit adWillLoad(mUrl);
-    fetchAd();
+void MoPubView::setDailyBudgetBytes(qint64 value){
+    if (value == dailyBudgetBytes()) return;
+    MoPubDataUsage::instance()->setDailyBudgetBytes(qMax(qint64(0), value));
+    emit dailyBudgetBytesChanged();
 }
 
-QString MoPubView::createMoPubAPIUrl(QString handlerPart){
-    QString urlString;
-    urlString.append(MOPUB_URL + handlerPart);
-    urlString.append("?v=" + API_VERSION);
-    urlString.append("&id=" + mAdUnitId );
-    return urlString;
+QVariantMap MoPubView::circuitBreakers() const {
+    return MoPubCircuitBreaker::instance()->report();
 }
 
-QString MoPubView::getUdid(){
-    QByteArray hash = QCryptographicHash::hash(mHardwareInfo->imei().toUtf8(),QCryptographicHash::Sha1);
-    return "&udid=sha1imei:bb10" + hash.toHex();
+QVariantMap MoPubView::webViewReclaim() const {
+    return MoPubWebViewReclaimer::instance()->report();
 }
 
-QUrl MoPubView::generateAdUrl(){
-    QString urlString = createMoPubAPIUrl(AD_HANDLER);
-    urlString.append("&nv=" + SDK_VERSION);
-    urlString.append(getUdid());
+bool MoPubView::viewable() const {
+    return mViewabilityTracker->isViewable();
+}
 
-    QGeoPositionInfo loc = mPositionSource->lastKnownPosition();
-    if (loc.isValid()) {
-        urlString.append("&ll=" + QString().setNum(loc.coordinate().latitude()) + "," + QString().setNum(loc.coordinate().longitude()));
+int MoPubView::visiblePercent() const {
+    return mViewabilityTracker->visiblePercent();
+}
+
+void MoPubView::loadAd(){
+    // Views created from C++ never see creationCompleted, and views can be moved around.
+    mViewabilityTracker->attach();
+    mAdManager->loadAd();
+}
+
+void MoPubView::loadFailUrl(){
+    mAdManager->loadFailUrl();
+}
+
+void MoPubView::conversionTracking(){
+    mAdManager->conversionTracking();
+}
+
+void MoPubView::impressionTracking(){
+    mAdManager->impressionTracking();
+}
+
+void MoPubView::onHtmlReady(const QString& html, const QUrl& baseUrl){
+    MoPubStallScope stallScope("setHtml", adUnitId());
+    // A new creative replaces the evicted one, nothing left to restore.
+    if (!mAdView) {
+        mEvictedHtml.clear();
+        createAdView();
+        mControlContainer->resetPreferredWidth();
+        mControlContainer->resetPreferredHeight();
+        // Loaded on the app's request, refreshing goes on from here.
+        mAdManager->setRefreshSuspended(false);
     }
+    mHtml = html;
+    mBaseUrl = baseUrl;
+    mRestoreTimer.invalidate();
+    mRestoring = false;
+    // Plain markup and image banners load without starting the JavaScript engine.
+    mAdView->settings()->setJavaScriptEnabled(MoPubCreativeClassifier::needsScript(mAdManager->creativeKind()));
+    mDisplayTimer.start();
+    mAdView->setHtml(html, baseUrl);
+#ifndef QT_NO_DEBUG
+    mInspector->setHtml(html);
+#endif
+    // A new creative has to earn its own viewable second.
+    mViewabilityTracker->restart();
+    emit htmlChanged();
+}
 
-    QString timeZone = getTimeZone();
-    if (!timeZone.isEmpty()){
-        urlString.append("&z=" + timeZone);
+void MoPubView::onLoadingChanged(bb::cascades::WebLoadRequest* request){
+    if (request->status() != WebLoadStatus::Succeeded) return;
+    if (mRestoreTimer.isValid()) {
+        MoPubWebViewReclaimer::instance()->recordRestore(adUnitId(), mRestoreTimer.elapsed());
+        mRestoreTimer.invalidate();
     }
+    if (!mDisplayTimer.isValid()) return;
+    MoPubCreativeClassifier::recordDisplayTime(mAdManager->creativeKind(), mDisplayTimer.elapsed());
+    mDisplayTimer.invalidate();
+    MPLogDebug("Creatives: %1", MoPubCreativeClassifier::summary());
+}
 
-    urlString.append("&o=" + getOrientation());
+void MoPubView::onLayoutChanged(int width, int height, bool scrollable){
+    // Only touch the layout when something changed, the same values would still relayout.
+    if (scrollable != mScrollable) {
+        mScrollable = scrollable;
+        setWebViewScrollingEnabled(mScrollable);
+    }
+    if (width > 0 && height > 0) {
+        setWidth(width);
+        setHeight(height);
+    }
+}
 
-    bool mraid = false;
-    if (mraid) urlString.append("&mr=1");
-    return urlString;
+QString MoPubView::udid() const {
+    return mDevice->udid();
 }
 
-QString MoPubView::getOrientation(){
-    switch (mDeviceInfo->orientation()) {
-    case DeviceOrientation::LeftUp:
-    case DeviceOrientation::RightUp:
-        return QString("l");
-    default:
-        return QString("p");
-    }
+QString MoPubView::installId() const {
+    return mDevice->installId();
 }
 
-QString MoPubView::getTimeZone(){
-    return QString().setNum(QDateTime::currentDateTime().utcOffset());
+QString MoPubView::location() const {
+    QGeoPositionInfo loc = mPositionSource->lastKnownPosition();
+    if (!loc.isValid()) return QString();
+    return QString().setNum(loc.coordinate().latitude()) + "," + QString().setNum(loc.coordinate().longitude());
+}
+
+QString MoPubView::orientation() const {
+    return mDevice->orientation();
+}
+
+bool MoPubView::isOnScreen() const {
+    return isVisible();
+}
+
+QString MoPubView::userAgent() const {
+   QString agent = mAdView ? mAdView->settings()->userAgent() : QString();
+   if (agent.isEmpty())
+   {
+       agent = mDevice->userAgent();
+   }
+   return agent;
 }
 
 void MoPubView::onNavigationRequested(bb::cascades::WebNavigationRequest* request){
     Q_CHECK_PTR(request);
 
-    qDebug() << "onNavigationRequested url: " << request->url();
-    QString scheme = request->url().scheme();
-    QUrl url = request->url();
+    const QUrl url = request->url();
+    MPLogTrace("onNavigationRequested url: %1", url);
 
-    // If the URL being loaded shares the redirectUrl prefix, open it in the browser.
-    if (!mRedirectUrl.isEmpty()  && url.toString().startsWith(mRedirectUrl.toString())) {
-        addClickTrackingRedirect(url);
-        mIsLoading = false;
-        if (!mInterceptslinks) {
-            showBrowserForUrl(url);
+    if (mRestoring) {
+        const MoPubUrlRouter::Route route = mAdManager->route(url);
+        if (route == MoPubUrlRouter::FinishLoad || route == MoPubUrlRouter::FailLoad) {
+            mRestoring = false;
             request->ignore();
+            // The app already got adDidLoad when the creative first loaded, a failure is still one.
+            if (route == MoPubUrlRouter::FailLoad) mAdManager->navigate(url);
+            return;
         }
-        return;
     }
 
-    // Handle the special mopub:// scheme calls.
-    if (scheme == "mopub") {
-        QString host = request->url().host().toLower();
-        if (host == "finishload"){      qDebug() << "emit finishload";      emitAdDidLoad(); }
-        else if (host == "close"){      qDebug() << "emit close";           emit adDidClose(); }
-        else if (host == "failload"){   qDebug() << "failload loadFailUrl"; loadFailUrl(); }
-        else if (host == "custom"){     qDebug() << "mopub custom";         invokeUrl(url); }
-        request->ignore();
-    }
+    switch (mAdManager->navigate(url)) {
+    // If the URL being loaded shares the redirectUrl prefix, open it in the browser.
+    case MoPubUrlRouter::LaunchPage:
+        if (!interceptslinks()) {
+            showBrowserForUrl(url);
+            request->ignore();
+        }
+        break;
+    // Handle the special mopub:// scheme calls, the manager took care of finishload and failload.
+    case MoPubUrlRouter::FinishLoad:    request->ignore(); break;
+    case MoPubUrlRouter::Close:         MPLogTrace("emit close");           emit adDidClose();  request->ignore(); break;
+    case MoPubUrlRouter::FailLoad:      request->ignore(); break;
+    case MoPubUrlRouter::Custom:        MPLogTrace("mopub custom");         invokeUrl(url);     request->ignore(); break;
+    case MoPubUrlRouter::MoPubUnknown:  request->ignore(); break;
+    // The creative already links through the click tracker, don't register the click twice.
+    case MoPubUrlRouter::ClickThrough:
+        MPLogInfo("Ad clicked. Click URL: %1", url);
+        emit adClicked();
+        if (!interceptslinks()) {
+            openLandingPage(url, true);
+            request->ignore();
+        }
+        break;
     // Ad was clicked open in browser
-    else if ((mUrl != url) && (scheme == "http" || scheme == "https"))
-    {
-        addClickTrackingRedirect(url);
-        qDebug() << "Ad clicked. Click URL: " << url;
+    case MoPubUrlRouter::Browser:
+        MPLogInfo("Ad clicked. Click URL: %1", url);
         emit adClicked();
-        if (!mInterceptslinks) {
+        if (!interceptslinks()) {
             showBrowserForUrl(url);
             request->ignore();
         }
-    }
+        break;
     // Invoke all other url schemes.
-    else if (mUrl != url)
-    {
+    case MoPubUrlRouter::External:
         invokeUrl(url);
         request->ignore();
-    }
-    emit htmlChanged();
-}
-
-void MoPubView::registerClick(){
-    if (!mClickThroughUrl.isEmpty()) {
-        QNetworkRequest request = QNetworkRequest();
-        request.setUrl(mClickThroughUrl);
-        //Latin1 encoding chosen with suggestion from RFC 5987 might not be the perfect choice.
-        request.setRawHeader("User-Agent", mAdView->settings()->userAgent().toLatin1());
-        QNetworkReply* reply = mNetworkAccessManager->get(request);
-        bool res = connect(reply, SIGNAL(finished()), this, SLOT(onRegisterClickReply()));
-        Q_ASSERT(res);
-        Q_UNUSED(res);
-    }
-}
-
-void MoPubView::onRegisterClickReply(){
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-    Q_CHECK_PTR(reply);
-    if ( QNetworkReply::NoError != reply->error()){
-        qDebug() << "RegisterClick error: " << reply->errorString();
-    }
-    reply->deleteLater();
-}
-
-void MoPubView::addClickTrackingRedirect(QUrl url){
-    if (!mClickThroughUrl.isEmpty()) {
-       url.setUrl(mClickThroughUrl.toString() + "&r=" + url.toString());
+        break;
+    case MoPubUrlRouter::Passthrough:
+        break;
     }
 }
 
 void MoPubView::invokeUrl(QUrl url)
 {
-    registerClick();
+    MoPubStallScope stallScope("invoke", adUnitId());
+    mAdManager->registerClick();
     InvokeRequest request = InvokeRequest();
     request.setUri(url);
     mInvokeManager->invoke(request);
@@ -249,191 +374,30 @@ void MoPubView::invokeUrl(QUrl url)
 
 void MoPubView::showBrowserForUrl(QUrl url)
 {
-    registerClick();
-    InvokeRequest request = InvokeRequest();
-    request.setUri(url);
-    request.setAction("bb.action.OPEN");
-    request.setTarget("sys.browser");
-    mInvokeManager->invoke(request);
+    mAdManager->registerClick();
+    // Only MoPub's click-through is resolved ahead, the creative's own links open as they are
+    // so their trackers see the tap.
+    launchBrowser(url);
 }
 
-void MoPubView::fetchAd(){
-    QNetworkRequest request = QNetworkRequest();
-    request.setUrl(mUrl);
-    request.setRawHeader("User-Agent", getUserAgent().toLatin1());
-
-    QNetworkReply* reply = mNetworkAccessManager->get(request);
-    bool res = connect(reply, SIGNAL(finished()), this, SLOT(onFetchAdReply()));
-    Q_ASSERT(res);
-    res = connect(reply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(onFetchAdError(QNetworkReply::NetworkError)));
-    Q_ASSERT(res);
-    Q_UNUSED(res);
-}
-
-void MoPubView::onFetchAdError(QNetworkReply::NetworkError code){
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-    Q_CHECK_PTR(reply);
-    qDebug() << "Network Error fetching ad code: " + QString().setNum(code);
-    reply->deleteLater();
-    loadFailUrl();
-}
-
-void MoPubView::onFetchAdReply(){
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-    Q_CHECK_PTR(reply);
-    // Client and Server HTTP errors should result in an exponential back off
-    QVariant statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
-    if (!statusCode.isNull() && statusCode.toInt() >= 400){
-        mFetchStatus = INVALID_SERVER_RESPONSE_BACKOFF;
-        qDebug() << "MoPub server returned invalid response." << reply->attribute(QNetworkRequest::HttpReasonPhraseAttribute).toString();
-        exponentialBackoff();
-        return;
-    }else if (!statusCode.isNull() && statusCode.toInt() != 200){
-        mFetchStatus = INVALID_SERVER_RESPONSE_NOBACKOFF;
-        qDebug() << "MoPub server returned invalid response." << reply->attribute(QNetworkRequest::HttpReasonPhraseAttribute).toString();
-        return;
-    }
-
-    configureAdViewUsingHeadersFromHttpResponse(reply);
-
-    if (reply->hasRawHeader("X-Adtype")) {
-        QString adType(reply->rawHeader("X-Adtype"));
-
-        // Ensure that the ad type header is valid and not "clear".
-        if (adType.toLower() == "clear"){
-            qDebug() <<  "MoPub server returned no ad.";
-            mFetchStatus = CLEAR_AD_TYPE;
-            loadFailUrl();
-            exponentialBackoff();
-            return;
-        } else if (adType.toLower() == "custom"){
-            // Handle custom native ad type.
-            if (reply->hasRawHeader("X-Customselector")) {
-                QString value(reply->rawHeader("X-Customselector"));
-                qDebug() << "Trying to call method named " << value;
-                mIsLoading = false;
-                //TODO Handle custom native ad type.
-                qDebug() << "Couldn't call custom method not implemented.";
-                emitAdFailed();
-            }
-            return;
-        } else if (adType.toLower() == "mraid"){
-            // Handle mraid ad type
-            qDebug() << "Loading mraid ad";
-            QHash<QString, QString> paramsHash;
-            paramsHash.insert("X-Adtype",adType);
-            paramsHash.insert("X-Nativeparams",QString(reply->readAll()));
-            mIsLoading = false;
-            loadNativeSDK(paramsHash);
-            emitAdFailed();
-            return;
-        } else if (adType.toLower() != "html"){
-            // Handle native SDK ad type.
-            qDebug() << "Loading native ad";
-            QHash<QString, QString> paramsHash;
-            paramsHash.insert("X-Adtype",adType);
-            QString npHeader(reply->rawHeader("X-Nativeparams"));
-            paramsHash.insert("X-Nativeparams","{}");
-            if (!npHeader.isEmpty()) {
-                paramsHash.insert("X-Nativeparams", npHeader);
-            }
-            QString ftHeader(reply->rawHeader("X-Fulladtype"));
-            if (!ftHeader.isEmpty()) {
-               paramsHash.insert("X-Fulladtype", ftHeader);
-            }
-            mIsLoading = false;
-            loadNativeSDK(paramsHash);
-            emitAdFailed();
-            return;
-        }
-    }
-    // Handle HTML ad.
-    bool res = reply->open(QIODevice::ReadOnly);
-    Q_ASSERT(res);
-    Q_UNUSED(res);
-    QString value(reply->readAll());
-    reply->close();
-
-    //Remove webview's incorrectly handling of meta viewport device-size element.
-    QRegExp viewport("<meta name=\"viewport\".*>");
-    viewport.setMinimal(true);
-    value.remove(viewport);
-
-    mAdView->setHtml(value,mUrl);
-    mIsLoading = false;
-    reply->deleteLater();
-}
+void MoPubView::openLandingPage(const QUrl& clickUrl, bool trackClickUrl)
+{
+    QElapsedTimer tapTimer;
+    tapTimer.start();
 
-//TODO add any native SDK support currently there are none for BB10
-void MoPubView::loadNativeSDK(const QHash<QString, QString>& paramsHash){
-    qDebug() << "Loading native SDK is not implemented.";
+    int hops = 0;
+    launchBrowser(mAdManager->landingUrlForClick(clickUrl, trackClickUrl, &hops));
+    MPLogInfo("Tap to browser for %1 took %2 ms with %3 redirect hops resolved ahead", adUnitId(), tapTimer.elapsed(), hops);
 }
 
-void MoPubView::configureAdViewUsingHeadersFromHttpResponse(QNetworkReply* reply){
-    Q_CHECK_PTR(reply);
-
-    // Print the ad network type to the console.
-    if (reply->hasRawHeader("X-Networktype")) {
-        QString value(reply->rawHeader("X-Networktype"));
-        qDebug() <<  "Fetching ad network type: " << value;
-    }
-
-    // Set the redirect URL prefix: navigating to any matching URLs will send us to the browser.
-    if (reply->hasRawHeader("X-Launchpage")) {
-        mRedirectUrl = QUrl(QString(reply->rawHeader("X-Launchpage")));
-    }else {mRedirectUrl = QUrl();}
-
-    // Set the URL that is prepended to links for click-tracking purposes.
-    if (reply->hasRawHeader("X-Clickthrough")) {
-        mClickThroughUrl = QString(reply->rawHeader("X-Clickthrough"));
-    }else {mClickThroughUrl = QString();}
-
-    // Set the fall-back URL to be used if the current request fails.
-    if (reply->hasRawHeader("X-Failurl")) {
-        mFailUrl = QUrl(QString(reply->rawHeader("X-Failurl")));
-    }else {mFailUrl = QUrl();}
-
-    // Set the URL to be used for impression tracking.
-    if (reply->hasRawHeader("X-Imptracker")) {
-        mImpressionUrl = QUrl(QString(reply->rawHeader("X-Imptracker")));
-    }else {mImpressionUrl = QUrl();}
-
-    // Set the webview's scrollability.
-    bool enabled = false;
-    if (reply->hasRawHeader("X-Scrollable")) {
-        enabled = QString(reply->rawHeader("X-Scrollable")) == "1";
-    }
-    setWebViewScrollingEnabled(enabled);
-
-    // Set the width and height.
-    if (reply->hasRawHeader("X-Width") && reply->hasRawHeader("X-Height")) {
-        mWidth = QString(reply->rawHeader("X-Width")).toInt();
-        mHeight =QString(reply->rawHeader("X-Height")).toInt();
-    } else {
-        mWidth = 0;
-        mHeight = 0;
-    }
-
-    // Set the auto-refresh time. A timer will be scheduled upon ad success or failure.
-    if (reply->hasRawHeader("X-Refreshtime")){
-        mRefreshTimeMilliseconds = QString(reply->rawHeader("X-Refreshtime")).toInt() * 1000;
-        if (mRefreshTimeMilliseconds < MINIMUM_REFRESH_TIME_MILLISECONDS) {
-            mRefreshTimeMilliseconds = MINIMUM_REFRESH_TIME_MILLISECONDS;
-        }
-    } else { mRefreshTimeMilliseconds = 0; }
-
-    // Set the allowed orientations for this ad.
-    if (reply->hasRawHeader("X-Orientation")){
-        mAdOrientation = QString(reply->rawHeader("X-Orientation"));
-    } else { mAdOrientation = QString(); }
-
-
-    if (reply->hasRawHeader("X-Interceptlinks")){
-        if (QString(reply->rawHeader("X-Interceptlinks")) == "1"){
-            mInterceptslinks = true;
-        } else {mInterceptslinks = false;}
-
-    }
+void MoPubView::launchBrowser(QUrl url)
+{
+    MoPubStallScope stallScope("launchBrowser", adUnitId());
+    InvokeRequest request = InvokeRequest();
+    request.setUri(url);
+    request.setAction("bb.action.OPEN");
+    request.setTarget("sys.browser");
+    mInvokeManager->invoke(request);
 }
 
 void MoPubView::setWebViewScrollingEnabled(bool enabled){
@@ -444,104 +408,3 @@ void MoPubView::setWebViewScrollingEnabled(bool enabled){
         scrollViewProp->setScrollMode(ScrollMode::None);
     }
 }
-
-void MoPubView::scheduleRefreshTimerIfEnabled(){
-    if (!mAutoRefreshEnabled || mRefreshTimeMilliseconds <= 0) return;
-    mAutoAdRefreshTimer->setSingleShot(true);
-    mAutoAdRefreshTimer->start(mRefreshTimeMilliseconds);
-    qDebug() << "Auto refreshing AdUnit " << mAdUnitId << "enabled for timeout after " << mRefreshTimeMilliseconds << "ms";
-}
-
-void MoPubView::cancelRefreshTimer(){
-    if (mAutoAdRefreshTimer->isActive())
-    {
-        mAutoAdRefreshTimer->stop();
-        qDebug() << "Auto refreshing AdUnit " << mAdUnitId << "disabled.";
-    }
-}
-
-void MoPubView::loadFailUrl(){
-    mIsLoading = false;
-    if (!mFailUrl.isEmpty()) {
-        qDebug() << "Loading failover url: " << mFailUrl;
-        mUrl = mFailUrl;
-        loadAd();
-    } else {
-        // No other URLs to try, so signal a failure.
-        emitAdFailed();
-    }
-}
-
-void MoPubView::emitAdDidLoad(){
-    qDebug() << "Ad successfully loaded.";
-    mIsLoading = false;
-    scheduleRefreshTimerIfEnabled();
-    emit adDidLoad();
-}
-void MoPubView::emitAdFailed(){
-    qDebug() << "Ad failed to load.";
-    mIsLoading = false;
-    scheduleRefreshTimerIfEnabled();
-    emit adFailed();
-}
-
-void MoPubView::trackImpression() {
-    if (mImpressionUrl.isEmpty()) return;
-    QNetworkRequest request = QNetworkRequest();
-    request.setUrl(mImpressionUrl);
-    request.setRawHeader("User-Agent", mAdView->settings()->userAgent().toLatin1());
-    mNetworkAccessManager->get(request);
-}
-
-void MoPubView::exponentialBackoff(){
-    int refreshMills =  mRefreshTimeMilliseconds * EXPONENTIAL_BACKOFF_FACTOR;
-    if (refreshMills > MAXIMUM_REFRESH_TIME_MILLISECONDS){
-        refreshMills = MAXIMUM_REFRESH_TIME_MILLISECONDS;
-    }
-    mRefreshTimeMilliseconds = refreshMills;
-}
-
-QString MoPubView::getUserAgent(){
-   QString agent = mAdView->settings()->userAgent();
-   //A fake user agent string is added when it is blank. Added version value from Cascades Gold Release sdk.
-   //This string matches the format added to webkit http://trac.webkit.org/changeset/125779/trunk/Source/WebCore/inspector/front-end/SettingsScreen.js
-   if (agent.isEmpty())
-   {
-       agent = QString("[\"BlackBerry \u2014 BB10\", \"Mozilla/5.0 (BB10; Touch) AppleWebKit/537.1+ (KHTML, like Gecko) Version/10.0.9.1673 Mobile Safari/537.1+\", \"768x1280x1\"]");
-   }
-   return agent;
-}
-
-QString MoPubView::createRequestId(){
-    return "&reqid=" + QUuid::createUuid();
-}
-
-QString MoPubView::createRequestTime(){
-    return "&reqt=" + QDateTime::currentMSecsSinceEpoch();
-}
-
-void MoPubView::impressionTracking(){
-    QNetworkRequest request = QNetworkRequest();
-    request.setUrl(QUrl(
-                        createMoPubAPIUrl(IMPRESSION_HANDLER)
-                        + getUdid()
-                        + "&appid=" + mPackageInfo->installId()
-                        + createRequestId()
-                        + createRequestTime()
-                        + "&random=" + rand()
-                        ));
-
-    request.setRawHeader("User-Agent", getUserAgent().toLatin1());
-    mNetworkAccessManager->get(request);
-}
-
-void MoPubView::conversionTracking(){
-    QNetworkRequest request = QNetworkRequest();
-    request.setUrl(QUrl(
-                        MOPUB_URL + CONVERSION_HANDLER
-                        + "?id=" + mPackageInfo->installId()
-                        + getUdid()
-                        ));
-    request.setRawHeader("User-Agent", getUserAgent().toLatin1());
-    mNetworkAccessManager->get(request);
-}
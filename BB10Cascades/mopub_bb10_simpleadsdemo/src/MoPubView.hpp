@@ -1,34 +1,54 @@
 #ifndef MOPUBVIEW_HPP_
 #define MOPUBVIEW_HPP_
-#define TESTING
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QUrl>
 #include <QString>
+#include <QVariantMap>
 #include <QtLocationSubset/QGeoPositionInfoSource>
 
 #include <bb/cascades/CustomControl>
 
+#include "MoPubAdManager.hpp"
+#include "MoPubDataUsage.hpp"
+
 namespace bb {
     namespace cascades {
         class Container;
         class ScrollView;
         class WebView;
         class WebNavigationRequest;
+        class WebLoadRequest;
     }
     namespace system {
         class InvokeManager;
     }
-    namespace device{
-        class HardwareInfo;
-        class DeviceInfo;
-    }
-    class PackageInfo;
 }
-
-class MoPubView: public bb::cascades::CustomControl {
+#ifndef QT_NO_DEBUG
+class MoPubAdInspector;
+#endif
+class MoPubDeviceEnvironment;
+class MoPubViewabilityTracker;
+
+/*!
+ * @brief Cascades adapter of MoPubAdManager: renders the creative in a WebView and opens its clicks.
+ */
+class MoPubView: public bb::cascades::CustomControl, public MoPubAdEnvironment {
 	Q_OBJECT
+	Q_ENUMS(DataSaverMode)
 	Q_PROPERTY(QString adUnitId READ adUnitId WRITE setAdUnitId)
+	Q_PROPERTY(bool interstitial READ interstitial WRITE setInterstitial)
+	Q_PROPERTY(int queueWaitMilliseconds READ queueWaitMilliseconds)
+	Q_PROPERTY(int skippedRenderCount READ skippedRenderCount)
+	Q_PROPERTY(int suppressedLoadCount READ suppressedLoadCount)
+	Q_PROPERTY(int discardedReplyCount READ discardedReplyCount)
+	Q_PROPERTY(int shortCircuitedLoadCount READ shortCircuitedLoadCount)
+	Q_PROPERTY(bool dataSaverActive READ dataSaverActive)
+	Q_PROPERTY(DataSaverMode dataSaverMode READ dataSaverMode WRITE setDataSaverMode NOTIFY dataSaverModeChanged)
+	Q_PROPERTY(qint64 dailyBudgetBytes READ dailyBudgetBytes WRITE setDailyBudgetBytes NOTIFY dailyBudgetBytesChanged)
+	Q_PROPERTY(bool viewable READ viewable NOTIFY viewableChanged)
+	Q_PROPERTY(int visiblePercent READ visiblePercent NOTIFY visiblePercentChanged)
 	Q_PROPERTY(QUrl clickThroughUrl READ clickThroughUrl WRITE setClickThroughUrl)
 	Q_PROPERTY(QString adOrientation READ adOrientation)
 	Q_PROPERTY(int refreshTimeMilliseconds READ refreshTimeMilliseconds WRITE setRefreshTimeMilliseconds )
@@ -37,32 +57,70 @@ class MoPubView: public bb::cascades::CustomControl {
 	Q_PROPERTY(QUrl redirectUrl READ redirectUrl)
 	Q_PROPERTY(bool autoRefreshEnabled READ autoRefreshEnabled WRITE setAutoRefreshEnabled )
 	Q_PROPERTY(bool interceptslinks READ interceptslinks)
-	Q_PROPERTY(QString adHtml READ adHtml NOTIFY htmlChanged )
+#ifndef QT_NO_DEBUG
+	Q_PROPERTY(QObject* inspector READ inspector CONSTANT)
+#endif
 
 public:
-	static const QString SDK_VERSION;
-	static const QString API_VERSION;
-	static const QString MOPUB_URL;
-	static const QString AD_HANDLER;
-	static const QString IMPRESSION_HANDLER;
-	static const QString CONVERSION_HANDLER;
-	static const int MINIMUM_REFRESH_TIME_MILLISECONDS;
-	static const int MAXIMUM_REFRESH_TIME_MILLISECONDS;
-	static const double EXPONENTIAL_BACKOFF_FACTOR;
+	enum DataSaverMode {
+		DataSaverOff = MoPubDataUsage::DataSaverOff,
+		DataSaverAuto = MoPubDataUsage::DataSaverAuto,
+		DataSaverOn = MoPubDataUsage::DataSaverOn
+	};
 
 	MoPubView();
+	virtual ~MoPubView();
 
 	//Q_PROPERTIES getter setters
-	QString adUnitId() const { return mAdUnitId; }
-	void setAdUnitId(const QString value) { mAdUnitId = value; }
-
-	QUrl clickThroughUrl() const { return mClickThroughUrl; }
-	void setClickThroughUrl(const QUrl value) { mClickThroughUrl = value; }
-
-	QString adOrientation() const { return mAdOrientation; }
-
-	int refreshTimeMilliseconds() const { return mRefreshTimeMilliseconds; }
-	void setRefreshTimeMilliseconds(int value) { mRefreshTimeMilliseconds = value; }
+	QString adUnitId() const { return mAdManager->adUnitId(); }
+	void setAdUnitId(const QString value) { mAdManager->setAdUnitId(value); }
+
+	bool interstitial() const { return mAdManager->interstitial(); }
+	void setInterstitial(bool value) { mAdManager->setInterstitial(value); }
+
+	int queueWaitMilliseconds() const { return mAdManager->queueWaitMilliseconds(); }
+
+	// Refreshes that returned the creative already on screen and so were not reloaded.
+	int skippedRenderCount() const { return mAdManager->skippedRenderCount(); }
+
+	// Duplicate loads that were never started and late replies that were dropped.
+	int suppressedLoadCount() const { return mAdManager->suppressedLoadCount(); }
+	int discardedReplyCount() const { return mAdManager->discardedReplyCount(); }
+	int shortCircuitedLoadCount() const { return mAdManager->shortCircuitedLoadCount(); }
+	// State of the circuit breaker of every ad unit, see MoPubCircuitBreaker::report().
+	Q_INVOKABLE QVariantMap circuitBreakers() const;
+	// WebViews torn down and restored by the app, see MoPubWebViewReclaimer::report().
+	Q_INVOKABLE QVariantMap webViewReclaim() const;
+
+	// How long the view has been out of sight, 0 while any of it is visible.
+	qint64 hiddenMilliseconds() const;
+	// Tears down the WebView and keeps the creative compressed until the view is back in view.
+	// False while an ad is loading.
+	bool evict();
+	bool isEvicted() const { return !mEvictedHtml.isEmpty(); }
+	int evictedBytes() const { return mEvictedHtml.size(); }
+
+	bool dataSaverActive() const { return mAdManager->dataSaverActive(); }
+	// App-wide and kept across launches, every view shows and changes the same ones.
+	DataSaverMode dataSaverMode() const { return DataSaverMode(MoPubDataUsage::instance()->dataSaverMode()); }
+	void setDataSaverMode(DataSaverMode value);
+	// 0 for no budget, only counts in DataSaverAuto.
+	qint64 dailyBudgetBytes() const { return MoPubDataUsage::instance()->dailyBudgetBytes(); }
+	void setDailyBudgetBytes(qint64 value);
+	// Bytes spent on ad traffic by the whole app, see MoPubDataUsage::report().
+	Q_INVOKABLE QVariantMap dataUsage() const;
+
+	// At least half of the ad has been on screen for a continuous second.
+	bool viewable() const;
+	int visiblePercent() const;
+
+	QUrl clickThroughUrl() const { return mAdManager->clickThroughUrl(); }
+	void setClickThroughUrl(const QUrl value) { mAdManager->setClickThroughUrl(value); }
+
+	QString adOrientation() const { return mAdManager->adOrientation(); }
+
+	int refreshTimeMilliseconds() const { return mAdManager->refreshTimeMilliseconds(); }
+	void setRefreshTimeMilliseconds(int value) { mAdManager->setRefreshTimeMilliseconds(value); }
 
     int width() const { return mWidth; }
     void setWidth(int value);
@@ -70,17 +128,23 @@ public:
     int height() const { return mHeight; }
     void setHeight(int value);
 
-    QUrl redirectUrl() const { return mRedirectUrl; }
+    QUrl redirectUrl() const { return mAdManager->redirectUrl(); }
 
-    bool autoRefreshEnabled() const { return mAutoRefreshEnabled; }
-    void setAutoRefreshEnabled(bool value) {
-        mAutoRefreshEnabled = value;
-        if (!mAutoRefreshEnabled) cancelRefreshTimer();
-        else scheduleRefreshTimerIfEnabled();
-    }
+    bool autoRefreshEnabled() const { return mAdManager->autoRefreshEnabled(); }
+    void setAutoRefreshEnabled(bool value) { mAdManager->setAutoRefreshEnabled(value); }
 
-    bool interceptslinks() const { return mInterceptslinks; }
-    QString adHtml();
+    bool interceptslinks() const { return mAdManager->interceptslinks(); }
+#ifndef QT_NO_DEBUG
+    QObject* inspector() const;
+#endif
+
+    // MoPubAdEnvironment
+    QString userAgent() const;
+    QString udid() const;
+    QString installId() const;
+    QString location() const;
+    QString orientation() const;
+    bool isOnScreen() const;
 
 public Q_SLOTS:
     Q_INVOKABLE void loadAd();
@@ -94,78 +158,57 @@ Q_SIGNALS:
 	void adWillLoad(QUrl adUrl);
 	void adFailed();
 	void htmlChanged();
+	void viewableChanged(bool viewable);
+	void visiblePercentChanged(int percent);
+	void dataSaverModeChanged();
+	void dailyBudgetBytesChanged();
 
 protected:
-	void trackImpression();
     void impressionTracking();
 
 private Q_SLOTS:
 	void onNavigationRequested(bb::cascades::WebNavigationRequest *request);
-    void onRegisterClickReply();
-    void onFetchAdReply();
-    void onFetchAdError(QNetworkReply::NetworkError);
-    void scheduleRefreshTimerIfEnabled();
-    void cancelRefreshTimer();
+    void onHtmlReady(const QString& html, const QUrl& baseUrl);
+    void onLayoutChanged(int width, int height, bool scrollable);
+    void onLoadingChanged(bb::cascades::WebLoadRequest* request);
+    void onVisiblePercentChanged(int percent);
 
 private:
-    void addClickTrackingRedirect(QUrl url);
+    void createAdView();
+    void restore();
     void invokeUrl(QUrl url);
     void showBrowserForUrl(QUrl url);
-    void registerClick();
-    QUrl generateAdUrl();
-    QString createMoPubAPIUrl(QString handlerPart);
-
-    void fetchAd();
-    void configureAdViewUsingHeadersFromHttpResponse(QNetworkReply* reply);
+    void launchBrowser(QUrl url);
+    void openLandingPage(const QUrl& clickUrl, bool trackClickUrl);
     void setWebViewScrollingEnabled(bool enabled);
-    void loadNativeSDK(const QHash<QString, QString>& paramsHash);
-    void exponentialBackoff();
-
-    void emitAdDidLoad();
-    void emitAdFailed();
-    QString getTimeZone();
-    QString getUserAgent();
-    QString getUdid();
-    QString createRequestId();
-    QString createRequestTime();
-    QString getOrientation();
 
 private:
     bb::cascades::Container* mControlContainer;
 	bb::cascades::ScrollView* mScrollView;
 	bb::cascades::WebView* mAdView;
 	bb::system::InvokeManager* mInvokeManager;
-	QNetworkAccessManager* mNetworkAccessManager;
+	MoPubAdManager* mAdManager;
+	MoPubViewabilityTracker* mViewabilityTracker;
 	QtMobilitySubset::QGeoPositionInfoSource* mPositionSource;
-	bb::device::HardwareInfo* mHardwareInfo;
-	bb::device::DeviceInfo* mDeviceInfo;
-	QTimer *mAutoAdRefreshTimer;
-	bb::PackageInfo* mPackageInfo;
-	QUrl mUrl;
-    QUrl mImpressionUrl;
-    QUrl mFailUrl;
-    bool mIsLoading;
-
-
-    enum FetchStatus {
-        NOT_SET,
-        FETCH_CANCELLED,
-        INVALID_SERVER_RESPONSE_BACKOFF,
-        INVALID_SERVER_RESPONSE_NOBACKOFF,
-        CLEAR_AD_TYPE
-    };
-    FetchStatus mFetchStatus;
+	MoPubDeviceEnvironment* mDevice;
+    bool mScrollable;
+    QElapsedTimer mDisplayTimer;
+    // The creative on screen, shared with the manager's copy.
+    QString mHtml;
+    QUrl mBaseUrl;
+    // qCompress()ed UTF-8 of the creative while evicted.
+    QByteArray mEvictedHtml;
+    QElapsedTimer mHiddenTimer;
+    QElapsedTimer mRestoreTimer;
+    // The restored creative runs again until it reports finishload or failload.
+    bool mRestoring;
+#ifndef QT_NO_DEBUG
+    MoPubAdInspector* mInspector;
+#endif
 
 	//Q_PROPERTIES
-	QString mAdUnitId;
-	QUrl mClickThroughUrl;
-	QString mAdOrientation;
-	int mRefreshTimeMilliseconds;
 	int mWidth;
 	int mHeight;
-	QUrl mRedirectUrl;
-    bool mAutoRefreshEnabled;
-    bool mInterceptslinks;
 };
 
 #endif /* MOPUBVIEW_HPP_ */
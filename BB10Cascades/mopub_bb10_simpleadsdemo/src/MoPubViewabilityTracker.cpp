@@ -0,0 +1,242 @@
+#include "MoPubViewabilityTracker.hpp"
+
+#include <QTimer>
+
+#include <bb/Application>
+#include <bb/cascades/Control>
+#include <bb/cascades/LayoutUpdateHandler>
+#include <bb/cascades/ScrollView>
+#include <bb/cascades/Sheet>
+#include <bb/device/DisplayInfo>
+
+#include "MoPubLogging.hpp"
+
+using namespace bb::cascades;
+
+// The MRC display standard: half of the ad for one continuous second.
+const int MoPubViewabilityTracker::VIEWABLE_PERCENT = 50;
+const int MoPubViewabilityTracker::VIEWABLE_MILLISECONDS = 1000;
+
+MoPubViewabilityTracker::MoPubViewabilityTracker(Control* target)
+: QObject(target)
+, mTarget(target)
+, mAppVisible(true)
+, mVisiblePercent(0)
+, mViewable(false)
+, mViewableTimer(new QTimer(this))
+{
+    bb::device::DisplayInfo display;
+    mScreenSize = QSizeF(display.pixelSize());
+
+    mViewableTimer->setSingleShot(true);
+    bool res = connect(mViewableTimer, SIGNAL(timeout()), this, SLOT(onViewableTimeout()));
+    Q_ASSERT(res);
+
+    bb::Application* app = bb::Application::instance();
+    res = connect(app, SIGNAL(fullscreen()), this, SLOT(onAppVisible()));
+    Q_ASSERT(res);
+    res = connect(app, SIGNAL(thumbnail()), this, SLOT(onAppHidden()));
+    Q_ASSERT(res);
+    res = connect(app, SIGNAL(invisible()), this, SLOT(onAppHidden()));
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+}
+
+MoPubViewabilityTracker::~MoPubViewabilityTracker()
+{
+    // The layout handlers are children of the controls they watch, not of the tracker.
+    foreach (const Node& node, mNodes) {
+        if (node.handler) delete node.handler;
+    }
+}
+
+QList<QObject*> MoPubViewabilityTracker::ancestors() const {
+    QList<QObject*> chain;
+    for (QObject* object = mTarget; object; object = object->parent()) {
+        chain.append(object);
+    }
+    return chain;
+}
+
+void MoPubViewabilityTracker::attach(){
+    const QList<QObject*> chain = ancestors();
+    if (chain == mChain) return;
+    detach();
+    mChain = chain;
+
+    // Controls up to the enclosing page carry the geometry, past it only a sheet matters.
+    bool inPage = true;
+    foreach (QObject* object, chain) {
+        Control* control = qobject_cast<Control*>(object);
+        if (inPage && control) {
+            Node node;
+            node.control = control;
+            node.scrollView = qobject_cast<ScrollView*>(control);
+            node.handler = new LayoutUpdateHandler(control);
+            bool res = connect(node.handler, SIGNAL(layoutFrameChanged(QRectF)),
+                    this, SLOT(onLayoutFrameChanged(QRectF)));
+            Q_ASSERT(res);
+            if (node.scrollView) {
+                res = connect(node.scrollView, SIGNAL(viewableAreaChanged(QRectF, float)),
+                        this, SLOT(onViewableAreaChanged(QRectF, float)));
+                Q_ASSERT(res);
+            }
+            res = connect(control, SIGNAL(visibleChanged(bool)), this, SLOT(update()));
+            Q_ASSERT(res);
+            Q_UNUSED(res);
+            mNodes.append(node);
+            watch(control);
+            continue;
+        }
+        inPage = false;
+        Sheet* sheet = qobject_cast<Sheet*>(object);
+        if (sheet && !mSheet) mSheet = sheet;
+        watch(object);
+    }
+
+    // Outside a sheet, any sheet of the scene covers the control while open.
+    if (!mSheet && !chain.isEmpty()) {
+        foreach (Sheet* sheet, chain.last()->findChildren<Sheet*>()) {
+            mCoveringSheets.append(sheet);
+            watch(sheet);
+        }
+    }
+    MPLogDebug("Viewability attached to %1 controls, %2 covering sheets", mNodes.size(), mCoveringSheets.size());
+    update();
+}
+
+void MoPubViewabilityTracker::watch(QObject* object){
+    mWatched.append(object);
+    bool res = true;
+    if (qobject_cast<Sheet*>(object)) {
+        res = connect(object, SIGNAL(opened()), this, SLOT(update()));
+        Q_ASSERT(res);
+        res = connect(object, SIGNAL(closed()), this, SLOT(update()));
+        Q_ASSERT(res);
+    }
+    // The target owns the tracker, only its ancestors can go away underneath it.
+    if (object != mTarget) {
+        res = connect(object, SIGNAL(destroyed()), this, SLOT(detach()));
+        Q_ASSERT(res);
+    }
+    Q_UNUSED(res);
+}
+
+void MoPubViewabilityTracker::detach(){
+    foreach (const QPointer<QObject>& object, mWatched) {
+        if (object) disconnect(object, 0, this, 0);
+    }
+    foreach (const Node& node, mNodes) {
+        if (node.handler) delete node.handler;
+    }
+    mWatched.clear();
+    mNodes.clear();
+    mChain.clear();
+    mSheet = 0;
+    mCoveringSheets.clear();
+    update();
+}
+
+void MoPubViewabilityTracker::onLayoutFrameChanged(const QRectF& frame){
+    for (int i = 0; i < mNodes.size(); ++i) {
+        if (mNodes.at(i).handler == sender()) {
+            mNodes[i].frame = frame;
+            break;
+        }
+    }
+    update();
+}
+
+void MoPubViewabilityTracker::onViewableAreaChanged(const QRectF& viewableArea, float contentScale){
+    for (int i = 0; i < mNodes.size(); ++i) {
+        if (mNodes.at(i).scrollView == sender()) {
+            mNodes[i].viewableArea = viewableArea;
+            mNodes[i].contentScale = contentScale;
+            break;
+        }
+    }
+    update();
+}
+
+void MoPubViewabilityTracker::onAppVisible(){
+    mAppVisible = true;
+    update();
+}
+
+void MoPubViewabilityTracker::onAppHidden(){
+    mAppVisible = false;
+    update();
+}
+
+int MoPubViewabilityTracker::computeVisiblePercent() const {
+    if (!mAppVisible || mNodes.isEmpty()) return 0;
+    if (mSheet && !mSheet->isOpened()) return 0;
+    foreach (const QPointer<Sheet>& sheet, mCoveringSheets) {
+        if (sheet && sheet->isOpened()) return 0;
+    }
+
+    const QSizeF size = mNodes.first().frame.size();
+    qreal fullArea = size.width() * size.height();
+    if (fullArea <= 0) return 0;
+
+    // Walk the control's rectangle up into each parent's coordinates, clipping as we go.
+    QRectF rect(QPointF(0, 0), size);
+    for (int i = 0; i < mNodes.size(); ++i) {
+        const Node& node = mNodes.at(i);
+        if (!node.control->isVisible()) return 0;
+        rect.translate(node.frame.topLeft());
+        if (i + 1 < mNodes.size()) {
+            const Node& parent = mNodes.at(i + 1);
+            if (parent.scrollView && parent.viewableArea.isValid()) {
+                const qreal scale = parent.contentScale;
+                rect = QRectF((rect.topLeft() - parent.viewableArea.topLeft()) * scale, rect.size() * scale);
+                fullArea *= scale * scale;
+            }
+            rect &= QRectF(QPointF(0, 0), parent.frame.size());
+        } else {
+            rect &= QRectF(QPointF(0, 0), mScreenSize);
+        }
+        if (rect.isEmpty()) return 0;
+    }
+    return qMin(100, qRound(100 * rect.width() * rect.height() / fullArea));
+}
+
+void MoPubViewabilityTracker::update(){
+    const int percent = computeVisiblePercent();
+    if (percent != mVisiblePercent) {
+        mVisiblePercent = percent;
+        emit visiblePercentChanged(percent);
+    }
+
+    const bool inView = percent >= VIEWABLE_PERCENT;
+    if (inView && !mInViewTimer.isValid()) {
+        mInViewTimer.start();
+        if (!mViewable) mViewableTimer->start(VIEWABLE_MILLISECONDS);
+    } else if (!inView && mInViewTimer.isValid()) {
+        MPLogDebug("In view for %1 ms", mInViewTimer.elapsed());
+        mInViewTimer.invalidate();
+        mViewableTimer->stop();
+        setViewable(false);
+    }
+}
+
+void MoPubViewabilityTracker::onViewableTimeout(){
+    if (mInViewTimer.isValid()) setViewable(true);
+}
+
+void MoPubViewabilityTracker::restart(){
+    mViewableTimer->stop();
+    mInViewTimer.invalidate();
+    setViewable(false);
+    update();
+}
+
+qint64 MoPubViewabilityTracker::continuousVisibleMilliseconds() const {
+    return mInViewTimer.isValid() ? mInViewTimer.elapsed() : 0;
+}
+
+void MoPubViewabilityTracker::setViewable(bool viewable){
+    if (viewable == mViewable) return;
+    mViewable = viewable;
+    emit viewableChanged(viewable);
+}
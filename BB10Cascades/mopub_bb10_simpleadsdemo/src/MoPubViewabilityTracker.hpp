@@ -0,0 +1,97 @@
+#ifndef MOPUBVIEWABILITYTRACKER_HPP_
+#define MOPUBVIEWABILITYTRACKER_HPP_
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QRectF>
+#include <QSizeF>
+
+class QTimer;
+
+namespace bb {
+    namespace cascades {
+        class Control;
+        class LayoutUpdateHandler;
+        class ScrollView;
+        class Sheet;
+    }
+}
+
+/*!
+ * @brief Event driven viewability measurement for a control.
+ *
+ * Listens to layout frame changes of the control and all of its ancestors, to scrolling
+ * of enclosing ScrollViews, to sheets opening and closing and to the application going
+ * to a thumbnail or the background. The visible area is recomputed only when one of
+ * those changes. The control turns viewable once at least VIEWABLE_PERCENT of it has
+ * been on screen for VIEWABLE_MILLISECONDS without interruption; that deadline is a
+ * single shot timer, nothing is polled.
+ */
+class MoPubViewabilityTracker: public QObject {
+    Q_OBJECT
+public:
+    static const int VIEWABLE_PERCENT;
+    static const int VIEWABLE_MILLISECONDS;
+
+    explicit MoPubViewabilityTracker(bb::cascades::Control* target);
+    virtual ~MoPubViewabilityTracker();
+
+    bool isViewable() const { return mViewable; }
+    int visiblePercent() const { return mVisiblePercent; }
+    // How long the control has been in view without interruption, 0 when it is not.
+    qint64 continuousVisibleMilliseconds() const;
+
+    // Measures continuous visible time from scratch, for a newly rendered creative.
+    void restart();
+
+public Q_SLOTS:
+    // Hooks into the ancestors of the control. Cheap when the control tree above it did not change.
+    void attach();
+
+Q_SIGNALS:
+    void viewableChanged(bool viewable);
+    void visiblePercentChanged(int percent);
+
+private Q_SLOTS:
+    void onLayoutFrameChanged(const QRectF& frame);
+    void onViewableAreaChanged(const QRectF& viewableArea, float contentScale);
+    void onAppVisible();
+    void onAppHidden();
+    void onViewableTimeout();
+    void update();
+    void detach();
+
+private:
+    struct Node {
+        Node() : control(0), scrollView(0), contentScale(1.0f) {}
+        bb::cascades::Control* control;
+        bb::cascades::ScrollView* scrollView;
+        QPointer<bb::cascades::LayoutUpdateHandler> handler;
+        QRectF frame;
+        QRectF viewableArea;
+        float contentScale;
+    };
+
+    QList<QObject*> ancestors() const;
+    void watch(QObject* object);
+    int computeVisiblePercent() const;
+    void setViewable(bool viewable);
+
+    bb::cascades::Control* mTarget;
+    QList<QObject*> mChain;
+    QList<Node> mNodes;
+    QList<QPointer<QObject> > mWatched;
+    // The sheet holding the control, or the sheets that can cover it.
+    QPointer<bb::cascades::Sheet> mSheet;
+    QList<QPointer<bb::cascades::Sheet> > mCoveringSheets;
+    QSizeF mScreenSize;
+    bool mAppVisible;
+    int mVisiblePercent;
+    bool mViewable;
+    QElapsedTimer mInViewTimer;
+    QTimer* mViewableTimer;
+};
+
+#endif /* MOPUBVIEWABILITYTRACKER_HPP_ */
@@ -0,0 +1,114 @@
+#include "MoPubWebViewReclaimer.hpp"
+
+#include <QTimer>
+
+#include <bb/MemoryInfo>
+
+#include "MoPubLogging.hpp"
+#include "MoPubView.hpp"
+
+const int MoPubWebViewReclaimer::HIDDEN_EVICT_MILLISECONDS = 5 * 60 * 1000;
+const int MoPubWebViewReclaimer::LOW_MEMORY_HIDDEN_MILLISECONDS = 30 * 1000;
+const int MoPubWebViewReclaimer::SWEEP_INTERVAL_MILLISECONDS = 60 * 1000;
+// Long enough for the deferred deletes to have run.
+const int MoPubWebViewReclaimer::RECLAIM_SAMPLE_DELAY_MILLISECONDS = 2000;
+
+MoPubWebViewReclaimer* MoPubWebViewReclaimer::instance(){
+    static MoPubWebViewReclaimer reclaimer;
+    return &reclaimer;
+}
+
+MoPubWebViewReclaimer::MoPubWebViewReclaimer()
+: QObject(0)
+, mMemoryInfo(new bb::MemoryInfo(this))
+, mSweepTimer(new QTimer(this))
+, mMemoryBeforeEviction(-1)
+, mPendingEvictionCount(0)
+, mEvictionCount(0)
+, mRestoreCount(0)
+, mReclaimedBytes(0)
+, mLastRestoreMilliseconds(0)
+, mTotalRestoreMilliseconds(0)
+{
+    bool res = connect(mMemoryInfo, SIGNAL(lowMemory(bb::LowMemoryWarningLevel::Type)),
+            this, SLOT(onLowMemory(bb::LowMemoryWarningLevel::Type)));
+    Q_ASSERT(res);
+    res = connect(mSweepTimer, SIGNAL(timeout()), this, SLOT(sweep()));
+    Q_ASSERT(res);
+    Q_UNUSED(res);
+    mSweepTimer->setInterval(SWEEP_INTERVAL_MILLISECONDS);
+}
+
+void MoPubWebViewReclaimer::registerView(MoPubView* view){
+    mViews.append(view);
+    if (!mSweepTimer->isActive()) mSweepTimer->start();
+}
+
+void MoPubWebViewReclaimer::unregisterView(MoPubView* view){
+    mViews.removeAll(view);
+    if (mViews.isEmpty()) mSweepTimer->stop();
+}
+
+void MoPubWebViewReclaimer::sweep(){
+    evictHidden(HIDDEN_EVICT_MILLISECONDS, "hidden");
+}
+
+void MoPubWebViewReclaimer::onLowMemory(bb::LowMemoryWarningLevel::Type level){
+    if (level == bb::LowMemoryWarningLevel::HighPriority) evictHidden(1, "low memory, high priority");
+    else evictHidden(LOW_MEMORY_HIDDEN_MILLISECONDS, "low memory");
+}
+
+void MoPubWebViewReclaimer::evictHidden(qint64 minimumHiddenMilliseconds, const char* reason){
+    int evicted = 0;
+    const qint64 memoryBefore = mMemoryInfo->memoryUsedByCurrentProcess();
+    foreach (MoPubView* view, mViews) {
+        if (view->hiddenMilliseconds() < minimumHiddenMilliseconds || !view->evict()) continue;
+        ++evicted;
+        MPLogDebug("Evicted the WebView of %1 (%2), creative kept in %3 bytes", view->adUnitId(), reason, view->evictedBytes());
+    }
+    if (evicted == 0) return;
+    mEvictionCount += evicted;
+    mPendingEvictionCount += evicted;
+    // The first sample of a burst of evictions is the one to compare with.
+    if (mMemoryBeforeEviction < 0) {
+        mMemoryBeforeEviction = memoryBefore;
+        QTimer::singleShot(RECLAIM_SAMPLE_DELAY_MILLISECONDS, this, SLOT(onReclaimSample()));
+    }
+}
+
+void MoPubWebViewReclaimer::onReclaimSample(){
+    const qint64 memoryAfter = mMemoryInfo->memoryUsedByCurrentProcess();
+    // -1 when the process could not be measured, and anything else running may have allocated meanwhile.
+    const qint64 reclaimed = mMemoryBeforeEviction >= 0 && memoryAfter >= 0 ? mMemoryBeforeEviction - memoryAfter : 0;
+    if (reclaimed > 0) mReclaimedBytes += reclaimed;
+    MPLogInfo("Evicted %1 WebViews, %2 KB reclaimed (%3 KB in total)", mPendingEvictionCount,
+            qMax(reclaimed, qint64(0)) / 1024, mReclaimedBytes / 1024);
+    mMemoryBeforeEviction = -1;
+    mPendingEvictionCount = 0;
+}
+
+void MoPubWebViewReclaimer::recordRestore(const QString& adUnitId, qint64 milliseconds){
+    ++mRestoreCount;
+    mLastRestoreMilliseconds = milliseconds;
+    mTotalRestoreMilliseconds += milliseconds;
+    MPLogInfo("Restored the creative of %1 in %2 ms", adUnitId, milliseconds);
+}
+
+QVariantMap MoPubWebViewReclaimer::report() const {
+    qint64 storedBytes = 0;
+    int evictedViews = 0;
+    foreach (MoPubView* view, mViews) {
+        if (!view->isEvicted()) continue;
+        ++evictedViews;
+        storedBytes += view->evictedBytes();
+    }
+    QVariantMap report;
+    report.insert("evictions", mEvictionCount);
+    report.insert("restores", mRestoreCount);
+    report.insert("evictedViews", evictedViews);
+    report.insert("storedBytes", storedBytes);
+    report.insert("reclaimedBytes", mReclaimedBytes);
+    report.insert("lastRestoreMilliseconds", mLastRestoreMilliseconds);
+    report.insert("averageRestoreMilliseconds", mRestoreCount > 0 ? mTotalRestoreMilliseconds / mRestoreCount : 0);
+    return report;
+}
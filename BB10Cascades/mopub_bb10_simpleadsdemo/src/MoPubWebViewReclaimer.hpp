@@ -0,0 +1,71 @@
+#ifndef MOPUBWEBVIEWRECLAIMER_HPP_
+#define MOPUBWEBVIEWRECLAIMER_HPP_
+
+#include <QList>
+#include <QObject>
+#include <QVariantMap>
+
+#include <bb/LowMemoryWarningLevel>
+
+class MoPubView;
+class QTimer;
+
+namespace bb {
+    class MemoryInfo;
+}
+
+/*!
+ * @brief Tears down the WebViews of ad views nobody is looking at.
+ *
+ * A view hidden for HIDDEN_EVICT_MILLISECONDS gives up its WebView and keeps only its
+ * creative, compressed; it renders it again once it is back in view. Low memory warnings
+ * evict sooner: a low priority one evicts views hidden for LOW_MEMORY_HIDDEN_MILLISECONDS,
+ * a high priority one every hidden view. The process memory given back and the time
+ * restores take are reported.
+ */
+class MoPubWebViewReclaimer: public QObject {
+    Q_OBJECT
+public:
+    static const int HIDDEN_EVICT_MILLISECONDS;
+    static const int LOW_MEMORY_HIDDEN_MILLISECONDS;
+    static const int SWEEP_INTERVAL_MILLISECONDS;
+    static const int RECLAIM_SAMPLE_DELAY_MILLISECONDS;
+
+    static MoPubWebViewReclaimer* instance();
+
+    void registerView(MoPubView* view);
+    void unregisterView(MoPubView* view);
+
+    // From the restore to the creative having loaded again.
+    void recordRestore(const QString& adUnitId, qint64 milliseconds);
+
+    // Evictions, restores, memory reclaimed, bytes kept for evicted creatives and restore latency.
+    QVariantMap report() const;
+
+public Q_SLOTS:
+    void sweep();
+
+private Q_SLOTS:
+    void onLowMemory(bb::LowMemoryWarningLevel::Type level);
+    void onReclaimSample();
+
+private:
+    MoPubWebViewReclaimer();
+    Q_DISABLE_COPY(MoPubWebViewReclaimer)
+
+    void evictHidden(qint64 minimumHiddenMilliseconds, const char* reason);
+
+    bb::MemoryInfo* mMemoryInfo;
+    QTimer* mSweepTimer;
+    QList<MoPubView*> mViews;
+    // Process memory before the last evictions, -1 while no sample is pending.
+    qint64 mMemoryBeforeEviction;
+    int mPendingEvictionCount;
+    int mEvictionCount;
+    int mRestoreCount;
+    qint64 mReclaimedBytes;
+    qint64 mLastRestoreMilliseconds;
+    qint64 mTotalRestoreMilliseconds;
+};
+
+#endif /* MOPUBWEBVIEWRECLAIMER_HPP_ */
@@ -1,5 +1,7 @@
 #include "MopubBb10Simpleadsdemo.hpp"
 
+#include "MoPubDeviceEnvironment.hpp"
+#include "MoPubEarlyStart.hpp"
 #include "MoPubView.hpp"
 
 #include <bb/cascades/Application>
@@ -14,6 +16,12 @@ MopubBb10Simpleadsdemo::MopubBb10Simpleadsdemo(bb::cascades::Application *app)
 	// Register the MoPub custom control
 	qmlRegisterType<MoPubView>("mopubview.lib", 1, 0, "MoPubView");
 
+    // Fetch the ads main.qml loads on creation while the scene is built, its views adopt them.
+    MoPubDeviceEnvironment environment;
+    MoPubEarlyStart::instance()->start(QStringList()
+            << "agltb3B1Yi1pbmNyDAsSBFNpdGUYkaoMDA"
+            << "agltb3B1Yi1pbmNyDAsSBFNpdGUYycEMDA", &environment);
+
     // create scene document from main.qml asset
     // set parent to created document to ensure it exists for the whole application lifetime
     QmlDocument *qml = QmlDocument::create("asset:///main.qml").parent(this);
@@ -6,11 +6,15 @@
 #include <QTranslator>
 #include <Qt/qdeclarativedebug.h>
 #include "MopubBb10Simpleadsdemo.hpp"
+#include "MoPubEarlyStart.hpp"
 
 using namespace bb::cascades;
 
 Q_DECL_EXPORT int main(int argc, char **argv)
 {
+    // Launch to first ad is measured from here.
+    MoPubEarlyStart::markLaunch();
+
     // this is where the server is started etc
     Application app(argc, argv);
 